@@ -0,0 +1,258 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Common.h"
+#include "Atlas.h"
+#include "SoftRender.h"
+
+
+// Images are placed on shelves: rows as tall as the first image put in
+// them, filled left to right. The images of this game come in only a few
+// heights, so little space is lost.
+
+struct Shelf
+{
+    int16_t Y;
+    int16_t Height;
+    int16_t Used;
+};
+
+struct AtlasPage
+{
+    ALLEGRO_BITMAP* Bitmap;
+    int ShelfCount;
+    int Bottom;
+    Shelf Shelves[32];
+};
+
+// An image that doesn't fit on any page keeps a bitmap of its own, with a
+// Page of NoPage, so that it's still only loaded once.
+
+struct AtlasImage
+{
+    char Name[32];
+    ALLEGRO_BITMAP* Bitmap;
+    int8_t Page;
+    int16_t X;
+    int16_t Y;
+    int16_t Width;
+    int16_t Height;
+};
+
+
+const int MaxPageSize = 2048;
+const int MaxPages = 4;
+const int MaxImages = 64;
+const int Padding = 1;
+const int NoPage = -1;
+
+
+static int pageSize;
+static AtlasPage pages[MaxPages];
+static AtlasImage images[MaxImages];
+static int imageCount;
+
+
+bool Atlas::Init()
+{
+    ALLEGRO_DISPLAY* display = al_get_current_display();
+
+    pageSize = MaxPageSize;
+
+    if ( display != nullptr )
+    {
+        int maxSize = al_get_display_option( display, ALLEGRO_MAX_BITMAP_SIZE );
+
+        if ( maxSize > 0 && maxSize < pageSize )
+            pageSize = maxSize;
+    }
+
+    return true;
+}
+
+void Atlas::Uninit()
+{
+    for ( int i = 0; i < MaxPages; i++ )
+    {
+        if ( pages[i].Bitmap != nullptr )
+        {
+            SoftRender::Invalidate( pages[i].Bitmap );
+            al_destroy_bitmap( pages[i].Bitmap );
+        }
+
+        pages[i] = AtlasPage();
+    }
+
+    for ( int i = 0; i < imageCount; i++ )
+    {
+        if ( images[i].Bitmap != nullptr )
+        {
+            SoftRender::Invalidate( images[i].Bitmap );
+            al_destroy_bitmap( images[i].Bitmap );
+        }
+
+        images[i] = AtlasImage();
+    }
+
+    imageCount = 0;
+}
+
+static AtlasImage* FindImage( const char* filename )
+{
+    for ( int i = 0; i < imageCount; i++ )
+    {
+        if ( strcmp( images[i].Name, filename ) == 0 )
+            return &images[i];
+    }
+
+    return nullptr;
+}
+
+static bool PlaceOnShelf( AtlasPage& page, int width, int height, int& x, int& y )
+{
+    Shelf* bestShelf = nullptr;
+
+    for ( int i = 0; i < page.ShelfCount; i++ )
+    {
+        Shelf& shelf = page.Shelves[i];
+
+        if ( shelf.Height >= height && shelf.Used + width <= pageSize )
+        {
+            if ( bestShelf == nullptr || shelf.Height < bestShelf->Height )
+                bestShelf = &shelf;
+        }
+    }
+
+    if ( bestShelf == nullptr )
+    {
+        if ( page.ShelfCount == _countof( page.Shelves ) 
+            || page.Bottom + height > pageSize
+            || width > pageSize )
+            return false;
+
+        bestShelf = &page.Shelves[page.ShelfCount];
+        bestShelf->Y = page.Bottom;
+        bestShelf->Height = height;
+        bestShelf->Used = 0;
+
+        page.ShelfCount++;
+        page.Bottom += height;
+    }
+
+    x = bestShelf->Used;
+    y = bestShelf->Y;
+
+    bestShelf->Used += width;
+    return true;
+}
+
+static bool PackImage( ALLEGRO_BITMAP* source, AtlasImage& image )
+{
+    int width = al_get_bitmap_width( source );
+    int height = al_get_bitmap_height( source );
+    int x = 0;
+    int y = 0;
+    int pageIndex = 0;
+
+    for ( ; pageIndex < MaxPages; pageIndex++ )
+    {
+        AtlasPage& page = pages[pageIndex];
+
+        if ( page.Bitmap == nullptr )
+        {
+            page.Bitmap = al_create_bitmap( pageSize, pageSize );
+            if ( page.Bitmap == nullptr )
+                return false;
+
+            ALLEGRO_BITMAP* origBmp = al_get_target_bitmap();
+
+            al_set_target_bitmap( page.Bitmap );
+            al_clear_to_color( al_map_rgba( 0, 0, 0, 0 ) );
+            al_set_target_bitmap( origBmp );
+        }
+
+        if ( PlaceOnShelf( page, width + Padding, height + Padding, x, y ) )
+            break;
+    }
+
+    if ( pageIndex == MaxPages )
+        return false;
+
+    ALLEGRO_STATE state;
+
+    al_store_state( &state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER );
+
+    // Copy the pixels as they are, alpha included
+    al_set_target_bitmap( pages[pageIndex].Bitmap );
+    al_set_blender( ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO );
+    al_draw_bitmap( source, x, y, 0 );
+
+    al_restore_state( &state );
+
+    image.Bitmap = nullptr;
+    image.Page = pageIndex;
+    image.X = x;
+    image.Y = y;
+    image.Width = width;
+    image.Height = height;
+    return true;
+}
+
+static ALLEGRO_BITMAP* MakeImageBitmap( const AtlasImage& image )
+{
+    ALLEGRO_BITMAP* parent = (image.Page == NoPage) ? image.Bitmap : pages[image.Page].Bitmap;
+
+    return al_create_sub_bitmap( parent, image.X, image.Y, image.Width, image.Height );
+}
+
+ALLEGRO_BITMAP* Atlas::Load( const char* filename )
+{
+    AtlasImage* image = FindImage( filename );
+
+    if ( image != nullptr )
+        return MakeImageBitmap( *image );
+
+    if ( imageCount == MaxImages || strlen( filename ) >= sizeof image->Name )
+        return al_load_bitmap( filename );
+
+    ALLEGRO_STATE state;
+
+    al_store_state( &state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS );
+    al_set_new_bitmap_flags( ALLEGRO_MEMORY_BITMAP );
+
+    ALLEGRO_BITMAP* source = al_load_bitmap( filename );
+
+    al_restore_state( &state );
+
+    if ( source == nullptr )
+        return nullptr;
+
+    image = &images[imageCount];
+
+    if ( !PackImage( source, *image ) )
+    {
+        image->Bitmap = al_clone_bitmap( source );
+        image->Page = NoPage;
+        image->X = 0;
+        image->Y = 0;
+        image->Width = al_get_bitmap_width( source );
+        image->Height = al_get_bitmap_height( source );
+
+        if ( image->Bitmap == nullptr )
+        {
+            al_destroy_bitmap( source );
+            return nullptr;
+        }
+    }
+
+    al_destroy_bitmap( source );
+
+    strcpy_s( image->Name, filename );
+    imageCount++;
+
+    return MakeImageBitmap( *image );
+}
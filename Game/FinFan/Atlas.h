@@ -0,0 +1,29 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+
+// Packs images into a few large bitmaps as they're loaded, and hands out
+// sub-bitmaps of them. Draws from all of them can then go in one batch.
+//
+// An image is packed the first time it's loaded and stays packed until
+// Uninit; loading it again returns a new sub-bitmap of the same region.
+// So scenes that are alive at the same time, like the levels kept on the
+// scene stack, share their graphics. The bitmaps returned are destroyed 
+// with al_destroy_bitmap as usual.
+
+class Atlas
+{
+public:
+    static bool Init();
+    static void Uninit();
+
+    // An image that doesn't fit gets a bitmap of its own, which is shared
+    // the same way
+    static ALLEGRO_BITMAP* Load( const char* filename );
+};
@@ -7,6 +7,7 @@
 
 #include "Common.h"
 #include "Battle.h"
+#include "Atlas.h"
 #include "BattleCalc.h"
 #include "BattleMenus.h"
 #include "BattleMod.h"
@@ -129,12 +130,24 @@ ALLEGRO_COLOR gFullScreenColor;
 int screenShakeX;
 int screenShakeY;
 
+struct ChaosStep
+{
+    uint8_t Tile;
+    uint8_t Line;
+};
+
+const int ChaosTiles = 256;
+const int ChaosSteps = ChaosTiles * 8;
+
+// The overlay is kept as a mask, and the rows that changed are copied to 
+// chaosOverlay once a frame
 ALLEGRO_BITMAP* chaosOverlay;
+uint8_t chaosMask[EnemyZoneHeight][EnemyZoneWidth];
+int chaosDirtyTop;
+int chaosDirtyBottom;
 int chaosPrevTile = 0x82;
-int chaosPixelIndex;
-int chaosTileIndex;
-uint8_t chaosPixelTable[256];
-uint8_t chaosTileTable[256];
+int chaosStepIndex;
+ChaosStep chaosSteps[ChaosSteps];
 
 
 Bounds standFrames[2] = 
@@ -222,7 +235,7 @@ void Init( int formationId, int backdropId )
     screenShakeY = 0;
     chaosOverlay = nullptr;
 
-    backdrops = al_load_bitmap( "backdrops.png" );
+    backdrops = Atlas::Load( "backdrops.png" );
     if ( backdrops == nullptr )
         return;
 
@@ -268,8 +281,8 @@ void Init( int formationId, int backdropId )
 
     enemyImages = al_load_bitmap( filename );
 
-    battleSprites = al_load_bitmap( "battleSprites.png" );
-    playerImages = al_load_bitmap( "playerSprites.png" );
+    battleSprites = Atlas::Load( "battleSprites.png" );
+    playerImages = Atlas::Load( "playerSprites.png" );
 
 
     err = fopen_s( &file, "enemyAttr.dat", "rb" );
@@ -408,39 +421,77 @@ void UpdateChaosOverlay()
     if ( chaosOverlay == nullptr )
         return;
 
-    if ( chaosPixelIndex == 8 )
+    if ( chaosStepIndex == ChaosSteps )
     {
         screenShakeX = 0;
         screenShakeY = 0;
         return;
     }
 
-    unsigned int tile = chaosTileTable[chaosTileIndex];
+    const ChaosStep& step = chaosSteps[chaosStepIndex];
+    unsigned int tile = step.Tile;
     unsigned int col = tile % 0x10;
     unsigned int row = tile / 0x10;
     int x = col * 8;
-    int y = (row * 8) + (chaosPixelTable[chaosTileIndex] % 8);
-    chaosPixelTable[chaosTileIndex]++;
+    int y = (row * 8) + step.Line;
 
     // ORIGINAL: The original game used (X & 3).
     screenShakeX = (chaosPrevTile % 3) * GetScreenScale();
     screenShakeY = (tile % 3) * GetScreenScale();
     chaosPrevTile = tile;
 
-    ALLEGRO_BITMAP* origBmp = al_get_target_bitmap();
-    al_set_target_bitmap( chaosOverlay );
-    al_draw_line( x, y, x + 8, y, Color::Black(), 1 );
-    al_set_target_bitmap( origBmp );
-
-    if ( chaosTileIndex < 255 )
+    // tiles on the right and bottom edges fall outside the enemy zone
+    if ( y < EnemyZoneHeight && x < EnemyZoneWidth )
     {
-        chaosTileIndex++;
+        memset( &chaosMask[y][x], 1, 8 );
+
+        if ( chaosDirtyTop >= chaosDirtyBottom )
+        {
+            chaosDirtyTop = y;
+            chaosDirtyBottom = y + 1;
+        }
+        else if ( y < chaosDirtyTop )
+        {
+            chaosDirtyTop = y;
+        }
+        else if ( y >= chaosDirtyBottom )
+        {
+            chaosDirtyBottom = y + 1;
+        }
     }
-    else
+
+    chaosStepIndex++;
+}
+
+void UploadChaosOverlay()
+{
+    if ( chaosDirtyTop >= chaosDirtyBottom )
+        return;
+
+    // whole rows are written, so the lock doesn't have to read anything back
+    ALLEGRO_LOCKED_REGION* region = al_lock_bitmap_region( 
+        chaosOverlay, 
+        0, 
+        chaosDirtyTop, 
+        EnemyZoneWidth, 
+        chaosDirtyBottom - chaosDirtyTop, 
+        ALLEGRO_PIXEL_FORMAT_ARGB_8888, 
+        ALLEGRO_LOCK_WRITEONLY );
+    if ( region == nullptr )
+        return;
+
+    for ( int y = chaosDirtyTop; y < chaosDirtyBottom; y++ )
     {
-        chaosTileIndex = 0;
-        chaosPixelIndex++;
+        uint32_t* dst = (uint32_t*) ((uint8_t*) region->data + (y - chaosDirtyTop) * region->pitch);
+
+        for ( int x = 0; x < EnemyZoneWidth; x++ )
+            dst[x] = chaosMask[y][x] != 0 ? 0xFF000000 : 0;
     }
+
+    al_unlock_bitmap( chaosOverlay );
+
+    chaosDirtyTop = 0;
+    chaosDirtyBottom = 0;
 }
 
 void Update()
@@ -578,7 +629,10 @@ void DrawMessage()
 void DrawChaosOverlay()
 {
     if ( chaosOverlay != nullptr )
+    {
+        UploadChaosOverlay();
         al_draw_bitmap( chaosOverlay, EnemyLeft, EnemyTop, 0 );
+    }
 }
 
 void Draw()
@@ -916,27 +970,44 @@ void EnableChaosEffect()
 {
     if ( chaosOverlay == nullptr )
     {
+        uint8_t tileTable[ChaosTiles];
+        uint8_t lineTable[ChaosTiles];
+
         chaosOverlay = al_create_bitmap( EnemyZoneWidth, EnemyZoneHeight );
-        chaosPixelIndex = 0;
-        chaosTileIndex = 0;
+        chaosStepIndex = 0;
+
+        memset( chaosMask, 0, sizeof chaosMask );
+        chaosDirtyTop = 0;
+        chaosDirtyBottom = EnemyZoneHeight;
 
-        for ( int i = 0; i < _countof( chaosTileTable ); i++ )
+        for ( int i = 0; i < _countof( tileTable ); i++ )
         {
-            chaosTileTable[i] = i;
+            tileTable[i] = i;
         }
-        ShuffleArray( chaosTileTable, _countof( chaosTileTable ) );
+        ShuffleArray( tileTable, _countof( tileTable ) );
 
-        for ( int i = 0; i < _countof( chaosPixelTable ); i++ )
+        for ( int i = 0; i < _countof( lineTable ); i++ )
         {
-            chaosPixelTable[i] = i;
+            lineTable[i] = i;
+        }
+        ShuffleArray( lineTable, _countof( lineTable ) );
+
+        // Each pass erases one line of every tile in shuffled order. A tile
+        // starts at a shuffled line, and moves down a line each pass.
+        for ( int i = 0; i < ChaosSteps; i++ )
+        {
+            int pass = i / ChaosTiles;
+            int tileIndex = i % ChaosTiles;
+
+            chaosSteps[i].Tile = tileTable[tileIndex];
+            chaosSteps[i].Line = (lineTable[tileIndex] + pass) % 8;
         }
-        ShuffleArray( chaosPixelTable, _countof( chaosPixelTable ) );
     }
 }
 
 bool IsChaosEffectDone()
 {
-    return chaosPixelIndex == 8;
+    return chaosStepIndex == ChaosSteps;
 }
 
 }
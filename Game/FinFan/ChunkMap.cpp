@@ -0,0 +1,321 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Common.h"
+#include "ChunkMap.h"
+
+
+static const char Signature[4] = { 'F', 'F', 'C', 'M' };
+
+
+// Which chunk a position is in, counting chunks before the map's start 
+// as negative
+static int FloorChunk( int pos )
+{
+    if ( pos >= 0 )
+        return pos / ChunkMap::ChunkSize;
+
+    return (pos - ChunkMap::ChunkSize + 1) / ChunkMap::ChunkSize;
+}
+
+
+ChunkMap::ChunkMap()
+    :   file( nullptr ),
+        dataPos( 0 ),
+        cols( 0 ),
+        rows( 0 ),
+        chunkCols( 0 ),
+        chunkRows( 0 ),
+        offsets( nullptr ),
+        chunkSlots( nullptr ),
+        slotCount( 0 ),
+        useClock( 0 )
+{
+}
+
+ChunkMap::~ChunkMap()
+{
+    Close();
+}
+
+bool ChunkMap::Open( const char* filename )
+{
+    Close();
+
+    errno_t err = fopen_s( &file, filename, "rb" );
+    if ( err != 0 )
+    {
+        file = nullptr;
+        return false;
+    }
+
+    ChunkMapHeader header;
+
+    if ( fread( &header, sizeof header, 1, file ) != 1
+        || memcmp( header.Signature, Signature, sizeof Signature ) != 0
+        || header.ChunkSize != ChunkSize
+        || !SetSize( header.Cols, header.Rows ) )
+    {
+        Close();
+        return false;
+    }
+
+    int chunkCount = chunkCols * chunkRows;
+
+    offsets = new uint32_t[chunkCount + 1];
+
+    if ( fread( offsets, sizeof offsets[0], chunkCount + 1, file ) != (size_t) chunkCount + 1 )
+    {
+        Close();
+        return false;
+    }
+
+    for ( int i = 0; i < chunkCount; i++ )
+    {
+        if ( offsets[i + 1] < offsets[i] || offsets[i + 1] - offsets[i] > sizeof readBuf )
+        {
+            Close();
+            return false;
+        }
+    }
+
+    dataPos = ftell( file );
+
+    return true;
+}
+
+bool ChunkMap::Open( int cols, int rows, ReadFunc read )
+{
+    Close();
+
+    if ( !read || !SetSize( cols, rows ) )
+    {
+        Close();
+        return false;
+    }
+
+    this->read = read;
+
+    return true;
+}
+
+bool ChunkMap::SetSize( int cols, int rows )
+{
+    if ( cols <= 0 || cols % ChunkSize != 0
+        || rows <= 0 || rows % ChunkSize != 0
+        || cols / ChunkSize > MaxChunkCols
+        || rows / ChunkSize > MaxChunkRows )
+        return false;
+
+    this->cols = cols;
+    this->rows = rows;
+    chunkCols = cols / ChunkSize;
+    chunkRows = rows / ChunkSize;
+
+    int chunkCount = chunkCols * chunkRows;
+
+    chunkSlots = new uint16_t[chunkCount];
+
+    for ( int i = 0; i < chunkCount; i++ )
+        chunkSlots[i] = NoSlot;
+
+    return true;
+}
+
+void ChunkMap::Close()
+{
+    if ( file != nullptr )
+    {
+        fclose( file );
+        file = nullptr;
+    }
+
+    delete [] offsets;
+    delete [] chunkSlots;
+
+    read = nullptr;
+    offsets = nullptr;
+    chunkSlots = nullptr;
+    cols = 0;
+    rows = 0;
+    chunkCols = 0;
+    chunkRows = 0;
+    slotCount = 0;
+}
+
+bool ChunkMap::IsOpen()
+{
+    return chunkSlots != nullptr;
+}
+
+int ChunkMap::GetCols()
+{
+    return cols;
+}
+
+int ChunkMap::GetRows()
+{
+    return rows;
+}
+
+void ChunkMap::SetLoadHandler( LoadFunc handler )
+{
+    loadHandler = handler;
+}
+
+void ChunkMap::StreamAround( int col, int row, int radiusCols, int radiusRows )
+{
+    if ( !IsOpen() )
+        return;
+
+    int firstChunkCol = FloorChunk( col - radiusCols );
+    int lastChunkCol = FloorChunk( col + radiusCols );
+    int firstChunkRow = FloorChunk( row - radiusRows );
+    int lastChunkRow = FloorChunk( row + radiusRows );
+
+    // Don't let the area ask for more chunks than can stay at once, or it
+    // would keep evicting its own chunks.
+
+    if ( lastChunkCol - firstChunkCol + 1 > chunkCols )
+        lastChunkCol = firstChunkCol + chunkCols - 1;
+    if ( lastChunkRow - firstChunkRow + 1 > chunkRows )
+        lastChunkRow = firstChunkRow + chunkRows - 1;
+
+    if ( (lastChunkCol - firstChunkCol + 1) * (lastChunkRow - firstChunkRow + 1) > MaxResident )
+        return;
+
+    for ( int r = firstChunkRow; r <= lastChunkRow; r++ )
+    {
+        int chunkRow = ((r % chunkRows) + chunkRows) % chunkRows;
+
+        for ( int c = firstChunkCol; c <= lastChunkCol; c++ )
+        {
+            int chunkCol = ((c % chunkCols) + chunkCols) % chunkCols;
+
+            GetChunkSlot( chunkRow * chunkCols + chunkCol );
+        }
+    }
+}
+
+int ChunkMap::GetTileRef( int col, int row )
+{
+    int slot = GetSlot( col, row );
+    if ( slot < 0 )
+        return 0;
+
+    col = ((col % cols) + cols) % cols;
+    row = ((row % rows) + rows) % rows;
+
+    return slots[slot].TileRefs[(row % ChunkSize) * ChunkSize + col % ChunkSize];
+}
+
+int ChunkMap::GetSlot( int col, int row )
+{
+    if ( !IsOpen() )
+        return -1;
+
+    col = ((col % cols) + cols) % cols;
+    row = ((row % rows) + rows) % rows;
+
+    return GetChunkSlot( (row / ChunkSize) * chunkCols + col / ChunkSize );
+}
+
+bool ChunkMap::CopyChunk( int chunkCol, int chunkRow, uint8_t* tileRefs )
+{
+    if ( !IsOpen() || chunkCol < 0 || chunkCol >= chunkCols || chunkRow < 0 || chunkRow >= chunkRows )
+        return false;
+
+    int chunk = chunkRow * chunkCols + chunkCol;
+
+    if ( chunkSlots[chunk] != NoSlot )
+    {
+        memcpy( tileRefs, slots[chunkSlots[chunk]].TileRefs, ChunkCells );
+        return true;
+    }
+
+    return ReadChunk( chunk, tileRefs );
+}
+
+int ChunkMap::GetChunkSlot( int chunk )
+{
+    uint16_t slotIndex = chunkSlots[chunk];
+
+    useClock++;
+
+    if ( slotIndex != NoSlot )
+    {
+        slots[slotIndex].LastUse = useClock;
+        return slotIndex;
+    }
+
+    slotIndex = GetFreeSlot();
+
+    Slot& slot = slots[slotIndex];
+
+    if ( !ReadChunk( chunk, slot.TileRefs ) )
+        return -1;
+
+    slot.Chunk = chunk;
+    slot.LastUse = useClock;
+    chunkSlots[chunk] = slotIndex;
+
+    if ( loadHandler )
+        loadHandler( slotIndex, chunk % chunkCols, chunk / chunkCols, slot.TileRefs );
+
+    return slotIndex;
+}
+
+int ChunkMap::GetFreeSlot()
+{
+    if ( slotCount < MaxResident )
+    {
+        slots[slotCount].Chunk = -1;
+        slots[slotCount].LastUse = 0;
+        return slotCount++;
+    }
+
+    int oldest = 0;
+
+    for ( int i = 1; i < MaxResident; i++ )
+    {
+        if ( slots[i].LastUse < slots[oldest].LastUse )
+            oldest = i;
+    }
+
+    if ( slots[oldest].Chunk >= 0 )
+    {
+        chunkSlots[slots[oldest].Chunk] = NoSlot;
+        slots[oldest].Chunk = -1;
+    }
+
+    return oldest;
+}
+
+bool ChunkMap::ReadChunk( int chunk, uint8_t* tileRefs )
+{
+    if ( read )
+    {
+        if ( !read( chunk % chunkCols, chunk / chunkCols, tileRefs ) )
+            return false;
+    }
+    else
+    {
+        int size = offsets[chunk + 1] - offsets[chunk];
+
+        if ( fseek( file, dataPos + offsets[chunk], SEEK_SET ) != 0
+            || fread( readBuf, 1, size, file ) != (size_t) size )
+            return false;
+
+        // Check the size before expanding, so that a bad chunk can't overrun
+        if ( GetDecompressedMapSize( readBuf, size ) != ChunkCells )
+            return false;
+
+        DecompressMap( readBuf, tileRefs );
+    }
+
+    return true;
+}
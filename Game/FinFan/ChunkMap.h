@@ -0,0 +1,114 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+
+// Reads a tile map that's stored as square chunks, each compressed on its
+// own the same way as map rows (see DecompressMap). Only the index of
+// chunks is kept in memory. Chunks are read from the file when they're
+// needed, and up to MaxResident of them are kept uncompressed; the least
+// recently used one makes room for the next. The size of the map comes
+// from the file.
+//
+// The file starts with a ChunkMapHeader, followed by the offset of each
+// chunk from the end of the index, row by row, and one more offset for the
+// end of the last chunk. Then comes the chunk data.
+//
+// A map in another format can be read a chunk at a time by a function
+// instead.
+//
+// Each chunk that's kept has a slot. The owner can keep its own data about
+// a chunk in arrays indexed by slot, made by a load handler when the chunk
+// is read. It stays valid until the chunk is evicted, and the slot gets
+// loaded again.
+
+class ChunkMap
+{
+public:
+    static const int ChunkSize = 32;
+    static const int ChunkCells = ChunkSize * ChunkSize;
+    static const int MaxResident = 16;
+    static const int MaxChunkCols = 256;
+    static const int MaxChunkRows = 256;
+
+    // Fills the tile refs of a chunk, row by row
+    typedef std::function<bool (int chunkCol, int chunkRow, uint8_t* tileRefs)> ReadFunc;
+
+    typedef std::function<void (int slot, int chunkCol, int chunkRow, const uint8_t* tileRefs)> LoadFunc;
+
+    ChunkMap();
+    ~ChunkMap();
+
+    bool Open( const char* filename );
+    bool Open( int cols, int rows, ReadFunc read );
+    void Close();
+    bool IsOpen();
+
+    int GetCols();
+    int GetRows();
+
+    // Called each time a chunk is read into a slot
+    void SetLoadHandler( LoadFunc handler );
+
+    // Reads the chunks that are within so many tiles of a tile, so that
+    // they're ready before they're asked for.
+    void StreamAround( int col, int row, int radiusCols, int radiusRows );
+
+    // Positions wrap around the edges of the map.
+    int GetTileRef( int col, int row );
+
+    // The slot of the chunk with a tile, reading it if it isn't kept; or 
+    // -1 if it can't be read.
+    int GetSlot( int col, int row );
+
+    // Copies the tile refs of a chunk, without keeping it if it isn't 
+    // kept already. For going over the whole map without pushing out the 
+    // chunks in use.
+    bool CopyChunk( int chunkCol, int chunkRow, uint8_t* tileRefs );
+
+private:
+    static const uint16_t NoSlot = 0xffff;
+
+    struct Slot
+    {
+        int Chunk;
+        uint32_t LastUse;
+        uint8_t TileRefs[ChunkCells];
+    };
+
+    FILE* file;
+    ReadFunc read;
+    LoadFunc loadHandler;
+    long dataPos;
+    int cols;
+    int rows;
+    int chunkCols;
+    int chunkRows;
+    uint32_t* offsets;
+    uint16_t* chunkSlots;
+    int slotCount;
+    uint32_t useClock;
+
+    Slot slots[MaxResident];
+    uint8_t readBuf[ChunkCells * 2 + 1];
+
+    bool SetSize( int cols, int rows );
+    int GetChunkSlot( int chunk );
+    bool ReadChunk( int chunk, uint8_t* tileRefs );
+    int GetFreeSlot();
+};
+
+
+struct ChunkMapHeader
+{
+    char Signature[4];
+    uint16_t Cols;
+    uint16_t Rows;
+    uint16_t ChunkSize;
+    uint16_t Reserved;
+};
@@ -64,3 +64,17 @@ bool Config::GetBool( const char* name, bool& value )
     value = atoi( rawVal ) != 0;
     return true;
 }
+
+bool Config::GetInt( const char* name, int& value )
+{
+    if ( config == nullptr )
+        return false;
+
+    const char* rawVal = al_get_config_value( config, nullptr, name );
+
+    if ( rawVal == nullptr )
+        return false;
+
+    value = atoi( rawVal );
+    return true;
+}
@@ -15,4 +15,5 @@ public:
     static bool LoadConfig();
 
     static bool GetBool( const char* name, bool& value );
+    static bool GetInt( const char* name, int& value );
 };
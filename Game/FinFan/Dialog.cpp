@@ -7,6 +7,7 @@
 
 #include "Common.h"
 #include "Dialog.h"
+#include "DrawList.h"
 #include "Text.h"
 
 
@@ -80,6 +81,8 @@ void Dialog::Draw()
     if ( linesToDraw > TextLines )
         linesToDraw = TextLines;
 
+    DrawList::SetLayer( Layer_Text );
+
     for ( int i = 0; i < linesToDraw; i++ )
     {
         int x = BoxLeft + TextLeftCol * 8;
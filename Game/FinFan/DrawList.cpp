@@ -0,0 +1,349 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Common.h"
+#include "DrawList.h"
+#include "SoftRender.h"
+#include <allegro5\allegro_primitives.h>
+#include <algorithm>
+
+
+// A sort key holds the layer, the bitmap's slot, and the command's index.
+// The index keeps commands in the order they were recorded when the rest 
+// of the key is the same, and leads back to the command.
+
+const int KeyIndexBits = 16;
+const int KeySlotBits = 8;
+const int KeyLayerShift = KeyIndexBits + KeySlotBits;
+const int MaxSlots = 1 << KeySlotBits;
+const int RectSlot = MaxSlots - 1;
+
+
+static DrawCommand commands[DrawList::MaxCommands];
+static uint32_t sortKeys[DrawList::MaxCommands];
+static int commandCount;
+
+// Bitmaps get slots in the order they're first used in a list
+static ALLEGRO_BITMAP* slotBitmaps[MaxSlots - 1];
+static int slotCount;
+
+static bool recording;
+static bool submittedSoft;
+static int submitCount;
+static ALLEGRO_BITMAP* listTarget;
+static DrawLayer curLayer;
+static DrawListStats stats;
+
+
+static_assert( DrawList::MaxCommands <= (1 << KeyIndexBits), "Command index doesn't fit in sort key." );
+static_assert( Layer_Max <= (1 << (32 - KeyLayerShift)), "Layer doesn't fit in sort key." );
+
+
+// Sub-bitmaps of an atlas page are batched with the page
+
+static ALLEGRO_BITMAP* GetTexture( ALLEGRO_BITMAP* bitmap )
+{
+    if ( bitmap == nullptr )
+        return nullptr;
+
+    ALLEGRO_BITMAP* parent = al_get_parent_bitmap( bitmap );
+
+    return parent != nullptr ? parent : bitmap;
+}
+
+static int GetSlot( ALLEGRO_BITMAP* bitmap )
+{
+    if ( bitmap == nullptr )
+        return RectSlot;
+
+    bitmap = GetTexture( bitmap );
+
+    for ( int i = 0; i < slotCount; i++ )
+    {
+        if ( slotBitmaps[i] == bitmap )
+            return i;
+    }
+
+    // The rest share a slot; they're still drawn in order, in more batches
+    if ( slotCount == _countof( slotBitmaps ) )
+        return RectSlot - 1;
+
+    slotBitmaps[slotCount] = bitmap;
+    return slotCount++;
+}
+
+static bool IsWhite( ALLEGRO_COLOR color )
+{
+    return color.r == 1 && color.g == 1 && color.b == 1 && color.a == 1;
+}
+
+static void DrawCommandNow( const DrawCommand& cmd )
+{
+    if ( cmd.Bitmap != nullptr )
+    {
+        al_draw_tinted_bitmap_region( 
+            cmd.Bitmap, 
+            cmd.Color, 
+            cmd.SrcX, 
+            cmd.SrcY, 
+            cmd.Width, 
+            cmd.Height, 
+            cmd.DestX, 
+            cmd.DestY, 
+            cmd.Flags );
+    }
+    else
+    {
+        al_draw_filled_rectangle( 
+            cmd.DestX, 
+            cmd.DestY, 
+            cmd.DestX + cmd.Width, 
+            cmd.DestY + cmd.Height, 
+            cmd.Color );
+    }
+}
+
+static void Submit();
+
+static void AddCommand( const DrawCommand& cmd )
+{
+    // Draws to another bitmap, like a cache being filled, can't wait
+    if ( !recording || al_get_target_bitmap() != listTarget )
+    {
+        DrawCommandNow( cmd );
+        return;
+    }
+
+    if ( commandCount == DrawList::MaxCommands )
+    {
+        // Submit what's recorded so far, and go on in an empty list. The 
+        // rest can only be drawn over it, so a later command on a lower 
+        // layer ends up on top. MaxCommands is meant to be enough for any
+        // screen; this only keeps an overflow from losing anything.
+        stats.Overflows++;
+        Submit();
+    }
+
+    uint32_t slot = GetSlot( cmd.Bitmap );
+
+    commands[commandCount] = cmd;
+    sortKeys[commandCount] = (cmd.Layer << KeyLayerShift) | (slot << KeyIndexBits) | commandCount;
+    commandCount++;
+}
+
+void DrawList::Begin()
+{
+    recording = true;
+    listTarget = al_get_target_bitmap();
+    curLayer = Layer_Map;
+    commandCount = 0;
+    slotCount = 0;
+    submitCount = 0;
+    submittedSoft = false;
+    stats.Lists++;
+}
+
+static void DrawCommandSoft( const DrawCommand& cmd )
+{
+    if ( cmd.Bitmap == nullptr )
+    {
+        SoftRender::DrawFilledRectangle( cmd.DestX, cmd.DestY, cmd.Width, cmd.Height, cmd.Color );
+    }
+    else if ( IsWhite( cmd.Color ) )
+    {
+        SoftRender::DrawBitmapRegion( 
+            cmd.Bitmap, 
+            cmd.SrcX, 
+            cmd.SrcY, 
+            cmd.Width, 
+            cmd.Height, 
+            cmd.DestX, 
+            cmd.DestY, 
+            cmd.Flags );
+    }
+    else
+    {
+        SoftRender::DrawTintedBitmapRegion( 
+            cmd.Bitmap, 
+            cmd.Color, 
+            cmd.SrcX, 
+            cmd.SrcY, 
+            cmd.Width, 
+            cmd.Height, 
+            cmd.DestX, 
+            cmd.DestY, 
+            cmd.Flags );
+    }
+}
+
+static bool CanDrawSoft()
+{
+    if ( !SoftRender::IsActive() )
+        return false;
+
+    for ( int i = 0; i < commandCount; i++ )
+    {
+        if ( commands[i].Bitmap != nullptr && !SoftRender::CanDraw( commands[i].Bitmap ) )
+            return false;
+    }
+
+    return true;
+}
+
+// The first part of a list starts a new frame. The parts after it are
+// composed over it.
+
+static void SubmitSoft( bool newFrame )
+{
+    bool held = al_is_bitmap_drawing_held();
+
+    al_hold_bitmap_drawing( false );
+
+    if ( newFrame )
+        SoftRender::Clear( al_map_rgb( 0, 0, 0 ) );
+
+    for ( int i = 0; i < commandCount; i++ )
+    {
+        DrawCommandSoft( commands[sortKeys[i] & ((1 << KeyIndexBits) - 1)] );
+    }
+
+    SoftRender::Present();
+
+    al_hold_bitmap_drawing( held );
+
+    stats.Batches++;
+}
+
+static void SubmitHard()
+{
+    ALLEGRO_BITMAP* batchTexture = nullptr;
+    bool held = al_is_bitmap_drawing_held();
+
+    for ( int i = 0; i < commandCount; i++ )
+    {
+        const DrawCommand& cmd = commands[sortKeys[i] & ((1 << KeyIndexBits) - 1)];
+
+        ALLEGRO_BITMAP* texture = GetTexture( cmd.Bitmap );
+
+        if ( texture != batchTexture || texture == nullptr )
+        {
+            // Primitives can't be drawn while bitmaps are held
+            al_hold_bitmap_drawing( texture != nullptr );
+            batchTexture = texture;
+            stats.Batches++;
+        }
+
+        DrawCommandNow( cmd );
+    }
+
+    al_hold_bitmap_drawing( held );
+}
+
+// Sorts and draws the commands recorded, and empties the list
+
+static void Submit()
+{
+    std::sort( sortKeys, sortKeys + commandCount );
+
+    // The software renderer presents a whole frame, so it can't go on from
+    // a part of the list that was drawn some other way.
+
+    if ( (submitCount == 0 || submittedSoft) && CanDrawSoft() )
+    {
+        SubmitSoft( submitCount == 0 );
+        submittedSoft = true;
+    }
+    else
+    {
+        SubmitHard();
+        submittedSoft = false;
+    }
+
+    submitCount++;
+    stats.Commands += commandCount;
+    commandCount = 0;
+    slotCount = 0;
+}
+
+void DrawList::End()
+{
+    if ( !recording )
+        return;
+
+    recording = false;
+
+    Submit();
+}
+
+bool DrawList::IsOpen()
+{
+    return recording;
+}
+
+void DrawList::SetLayer( DrawLayer layer )
+{
+    curLayer = layer;
+}
+
+void DrawList::DrawBitmapRegion( 
+    ALLEGRO_BITMAP* bitmap, 
+    int srcX, 
+    int srcY, 
+    int width, 
+    int height, 
+    int destX, 
+    int destY, 
+    int flags )
+{
+    DrawTintedBitmapRegion( bitmap, al_map_rgb_f( 1, 1, 1 ), srcX, srcY, width, height, destX, destY, flags );
+}
+
+void DrawList::DrawTintedBitmapRegion( 
+    ALLEGRO_BITMAP* bitmap, 
+    ALLEGRO_COLOR tint, 
+    int srcX, 
+    int srcY, 
+    int width, 
+    int height, 
+    int destX, 
+    int destY, 
+    int flags )
+{
+    DrawCommand cmd = { 0 };
+
+    cmd.Bitmap = bitmap;
+    cmd.Color = tint;
+    cmd.SrcX = srcX;
+    cmd.SrcY = srcY;
+    cmd.Width = width;
+    cmd.Height = height;
+    cmd.DestX = destX;
+    cmd.DestY = destY;
+    cmd.Layer = curLayer;
+    cmd.Flags = flags;
+
+    AddCommand( cmd );
+}
+
+void DrawList::DrawFilledRectangle( int x, int y, int width, int height, ALLEGRO_COLOR color )
+{
+    DrawCommand cmd = { 0 };
+
+    cmd.Color = color;
+    cmd.Width = width;
+    cmd.Height = height;
+    cmd.DestX = x;
+    cmd.DestY = y;
+    cmd.Layer = curLayer;
+
+    AddCommand( cmd );
+}
+
+void DrawList::GetStats( DrawListStats& stats )
+{
+    stats = ::stats;
+}
@@ -0,0 +1,102 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+
+// Layers are drawn bottom to top. Within a layer, draws are grouped by
+// bitmap, so they must not depend on each other's order, unless they use
+// the same bitmap.
+
+enum DrawLayer
+{
+    Layer_Map,
+    Layer_Sprites,
+    Layer_Player,
+    Layer_Objects,
+    Layer_Above,
+    Layer_Overlay,
+
+    // A window is filled with a rectangle, which is drawn after bitmaps in
+    // the same layer. So, its frame and text go on a layer of their own.
+    Layer_Window,
+    Layer_Text,
+
+    Layer_Max
+};
+
+
+struct DrawCommand
+{
+    ALLEGRO_BITMAP* Bitmap;         // nullptr for a filled rectangle
+    ALLEGRO_COLOR Color;            // tint for a bitmap
+    int16_t SrcX;
+    int16_t SrcY;
+    int16_t Width;
+    int16_t Height;
+    int16_t DestX;
+    int16_t DestY;
+    uint8_t Layer;
+    uint8_t Flags;
+};
+
+
+struct DrawListStats
+{
+    // Counted over all the lists since the game started
+    int Lists;
+    int Commands;
+    int Batches;
+    int Overflows;      // times the list was full, and submitted in part
+};
+
+
+// Records draw commands while a list is open, then sorts them by layer and
+// bitmap, and submits them in as few batches as possible. When no list is
+// open, commands are drawn right away, and so are commands drawn to another
+// target bitmap than the list's. So, code that draws sprites or text can use
+// it no matter who calls it.
+//
+// With the software renderer on, a list is composed by SoftRender instead,
+// as long as it can draw all the bitmaps in it.
+
+class DrawList
+{
+public:
+    static const int MaxCommands = 1024;
+
+    static void Begin();
+    static void End();
+    static bool IsOpen();
+
+    static void SetLayer( DrawLayer layer );
+
+    static void DrawBitmapRegion( 
+        ALLEGRO_BITMAP* bitmap, 
+        int srcX, 
+        int srcY, 
+        int width, 
+        int height, 
+        int destX, 
+        int destY, 
+        int flags );
+
+    static void DrawTintedBitmapRegion( 
+        ALLEGRO_BITMAP* bitmap, 
+        ALLEGRO_COLOR tint, 
+        int srcX, 
+        int srcY, 
+        int width, 
+        int height, 
+        int destX, 
+        int destY, 
+        int flags );
+
+    static void DrawFilledRectangle( int x, int y, int width, int height, ALLEGRO_COLOR color );
+
+    static void GetStats( DrawListStats& stats );
+};
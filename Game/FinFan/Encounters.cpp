@@ -0,0 +1,151 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Common.h"
+#include "Encounters.h"
+#include "Config.h"
+#include <math.h>
+
+
+class PerStepScheduler : public IEncounterScheduler
+{
+public:
+    virtual void Reset()
+    {
+    }
+
+    virtual bool Step( int rate )
+    {
+        return GetNextRandom( Encounters::MaxRate ) < rate;
+    }
+
+    virtual double GetExpectedSteps( int rate )
+    {
+        if ( rate <= 0 )
+            return -1;
+
+        return (double) Encounters::MaxRate / rate;
+    }
+};
+
+
+class DangerScheduler : public IEncounterScheduler
+{
+    // Thresholds are spread evenly around MaxRate, from MinThreshold up,
+    // so that it takes about MaxRate / rate steps on average.
+
+    static const int MinThreshold = Encounters::MaxRate / 4;
+    static const int ThresholdSpan = (Encounters::MaxRate - MinThreshold) * 2;
+
+    int danger;
+    int threshold;
+
+public:
+    DangerScheduler()
+        :   danger( 0 ),
+            threshold( Encounters::MaxRate )
+    {
+    }
+
+    virtual void Reset()
+    {
+        danger = 0;
+        threshold = MinThreshold + 1 + GetNextRandom( ThresholdSpan );
+    }
+
+    virtual bool Step( int rate )
+    {
+        if ( rate <= 0 )
+            return false;
+
+        danger += rate;
+
+        if ( danger < threshold )
+            return false;
+
+        Reset();
+        return true;
+    }
+
+    virtual double GetExpectedSteps( int rate )
+    {
+        if ( rate <= 0 )
+            return -1;
+
+        // The threshold is known, so this is exact
+        return ceil( (threshold - danger) / (double) rate );
+    }
+};
+
+
+static PerStepScheduler perStepScheduler;
+static DangerScheduler dangerScheduler;
+static Encounters::SchedulerType schedulerType;
+static IEncounterScheduler* builtInScheduler = &perStepScheduler;
+static IEncounterScheduler* customScheduler;
+
+
+static IEncounterScheduler* GetScheduler()
+{
+    if ( customScheduler != nullptr )
+        return customScheduler;
+
+    return builtInScheduler;
+}
+
+
+void Encounters::Init()
+{
+    int type = Scheduler_PerStep;
+
+    Config::GetInt( "encounterScheduler", type );
+
+    if ( type == Scheduler_Danger )
+        SetSchedulerType( Scheduler_Danger );
+    else
+        SetSchedulerType( Scheduler_PerStep );
+}
+
+Encounters::SchedulerType Encounters::GetSchedulerType()
+{
+    return schedulerType;
+}
+
+void Encounters::SetSchedulerType( SchedulerType type )
+{
+    schedulerType = type;
+
+    if ( type == Scheduler_Danger )
+        builtInScheduler = &dangerScheduler;
+    else
+        builtInScheduler = &perStepScheduler;
+
+    builtInScheduler->Reset();
+}
+
+void Encounters::SetScheduler( IEncounterScheduler* scheduler )
+{
+    customScheduler = scheduler;
+
+    if ( customScheduler != nullptr )
+        customScheduler->Reset();
+}
+
+void Encounters::Reset()
+{
+    GetScheduler()->Reset();
+}
+
+bool Encounters::Step( int rate )
+{
+    return GetScheduler()->Step( rate );
+}
+
+double Encounters::GetExpectedSteps( int rate )
+{
+    return GetScheduler()->GetExpectedSteps( rate );
+}
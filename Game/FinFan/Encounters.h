@@ -0,0 +1,65 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+
+// Decides which steps start random battles. The rate of a tile is the
+// chance out of 256 that a step on it starts one, like in the original
+// game. A scheduler may spread battles differently, as long as they come
+// at about that rate.
+
+class IEncounterScheduler
+{
+public:
+    virtual ~IEncounterScheduler() {}
+
+    virtual void Reset() = 0;
+
+    // Takes a step on a tile with the given rate. Returns true if a battle
+    // starts.
+    virtual bool Step( int rate ) = 0;
+
+    // The number of steps it's expected to take, counting the next one, to
+    // start a battle if every step had the given rate. Returns -1 if a
+    // battle would never start.
+    virtual double GetExpectedSteps( int rate ) = 0;
+};
+
+
+class Encounters
+{
+public:
+    enum SchedulerType
+    {
+        // Every step rolls for a battle, as in the original game
+        Scheduler_PerStep,
+
+        // Steps add up danger, and a battle starts when it reaches a
+        // threshold that's chosen after each battle. Battles come at the
+        // same rate on average, but the threshold is never less than a 
+        // quarter of the average, so they don't come right after each 
+        // other on tiles with ordinary rates.
+        Scheduler_Danger,
+    };
+
+    static const int MaxRate = 256;
+
+    // The config option encounterScheduler picks the scheduler type
+    static void Init();
+
+    static SchedulerType GetSchedulerType();
+    static void SetSchedulerType( SchedulerType type );
+
+    // Uses another scheduler, owned by the caller, until it's set to
+    // nullptr
+    static void SetScheduler( IEncounterScheduler* scheduler );
+
+    static void Reset();
+    static bool Step( int rate );
+    static double GetExpectedSteps( int rate );
+};
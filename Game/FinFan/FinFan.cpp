@@ -11,11 +11,18 @@
 #include <allegro5\allegro_image.h>
 #include <allegro5\allegro_primitives.h>
 #include "Text.h"
+#include "Atlas.h"
+#include "DrawList.h"
+#include "SoftRender.h"
+#include "Presenter.h"
 #include "Player.h"
 #include "Module.h"
 #include "SceneStack.h"
 #include "Sound.h"
+#include "SoftMixer.h"
 #include "Config.h"
+#include "Encounters.h"
+#include "MainMenu.h"
 
 
 const double FrameTime = 1 / 60.0;
@@ -25,6 +32,8 @@ static ALLEGRO_EVENT_QUEUE* eventQ;
 static ALLEGRO_DISPLAY* display;
 static int frameCounter;
 static int screenScale = 1;
+static int screenOffsetX;
+static int screenOffsetY;
 
 
 void InitPlayer()
@@ -131,8 +140,21 @@ IModule::~IModule()
 {
 }
 
+bool IModule::NeedsDraw()
+{
+    return true;
+}
+
 static void ResizeView( int screenWidth, int screenHeight )
 {
+    if ( Presenter::IsActive() )
+    {
+        // scenes draw at the native size, and the view is scaled at the end
+        screenScale = 1;
+        Presenter::Resize( screenWidth, screenHeight );
+        return;
+    }
+
     float viewAspect = StdViewWidth / (float) StdViewHeight;
     float screenAspect = screenWidth / (float) screenHeight;
     // only allow whole number scaling
@@ -159,6 +181,9 @@ static void ResizeView( int screenWidth, int screenHeight )
     int offsetX = (screenWidth - viewWidth) / 2;
     int offsetY = (screenHeight - viewHeight) / 2;
 
+    screenOffsetX = offsetX;
+    screenOffsetY = offsetY;
+
     al_set_clipping_rectangle( offsetX, offsetY, viewWidth, viewHeight );
 
     ALLEGRO_TRANSFORM t;
@@ -169,6 +194,85 @@ static void ResizeView( int screenWidth, int screenHeight )
     al_use_transform( &t );
 }
 
+static void HandleClick( int screenX, int screenY )
+{
+    int viewX = -1;
+    int viewY = -1;
+
+    if ( Presenter::IsActive() )
+    {
+        Presenter::ScreenToView( screenX, screenY, viewX, viewY );
+    }
+    else if ( screenX >= screenOffsetX && screenY >= screenOffsetY )
+    {
+        viewX = (screenX - screenOffsetX) / screenScale;
+        viewY = (screenY - screenOffsetY) / screenScale;
+    }
+
+    Input::AddClick( viewX, viewY );
+}
+
+// Writes the counters kept while the game ran, if statsLog is set in the
+// config file
+
+static void WriteStats( const char* path )
+{
+    bool statsLog = false;
+    FILE* file = nullptr;
+
+    if ( !Config::GetBool( "statsLog", statsLog ) || !statsLog )
+        return;
+
+    if ( fopen_s( &file, path, "w" ) != 0 )
+        return;
+
+    MenuStats menuStats;
+    PresentStats presentStats;
+    DrawListStats drawStats;
+    SoundStats soundStats;
+
+    MainMenu::GetStats( menuStats );
+    Presenter::GetStats( presentStats );
+    DrawList::GetStats( drawStats );
+    Sound::GetStats( soundStats );
+
+    fprintf( file, "Menu frames:      %d drawn, %d partly drawn, %d skipped\n", 
+        menuStats.FramesDrawn, menuStats.FramesPartlyDrawn, menuStats.FramesSkipped );
+
+    if ( presentStats.Frames > 0 )
+    {
+        fprintf( file, "Upscale:          %dx on the %s, %d frames, %.3f ms average, %.3f ms most\n",
+            presentStats.Scale,
+            presentStats.Cpu ? "CPU" : "GPU",
+            presentStats.Frames,
+            presentStats.TotalTime / presentStats.Frames * 1000,
+            presentStats.MaxTime * 1000 );
+    }
+
+    if ( drawStats.Lists > 0 )
+    {
+        fprintf( file, "Draw lists:       %d lists, %.1f commands and %.1f batches average, %d overflows\n",
+            drawStats.Lists,
+            (double) drawStats.Commands / drawStats.Lists,
+            (double) drawStats.Batches / drawStats.Lists,
+            drawStats.Overflows );
+    }
+
+    fprintf( file, "Sound effects:    %d voices at most, %d stolen, %d coalesced, %d dropped\n",
+        soundStats.MostEffectVoicesInUse,
+        soundStats.EffectSteals,
+        soundStats.EffectsCoalesced,
+        soundStats.EffectsDropped );
+
+    if ( SoftMixer::IsActive() )
+    {
+        fprintf( file, "Software mixer:   %d underruns, %d overruns\n", 
+            soundStats.MixerUnderruns, soundStats.MixerOverruns );
+    }
+
+    fclose( file );
+}
+
 static void Run()
 {
     bool done = false;
@@ -177,6 +281,7 @@ static void Run()
     ALLEGRO_EVENT_SOURCE* displaySource = al_get_display_event_source( display );
     double startTime = al_get_time();
     double waitSpan = 0;
+    bool forceDraw = true;
 
     if ( keyboardSource == nullptr )
         return;
@@ -186,8 +291,16 @@ static void Run()
     al_register_event_source( eventQ, keyboardSource );
     al_register_event_source( eventQ, displaySource );
 
+    // The mouse and touch are optional
+    if ( al_is_mouse_installed() )
+        al_register_event_source( eventQ, al_get_mouse_event_source() );
+    if ( al_is_touch_input_installed() )
+        al_register_event_source( eventQ, al_get_touch_input_event_source() );
+
     Global::Init();
     Player::Init();
+    Encounters::Init();
+    SceneStack::Init();
 
     SceneStack::SwitchScene( SceneId_Intro );
     SceneStack::PerformSceneChange();
@@ -209,6 +322,25 @@ static void Run()
                 al_acknowledge_resize( display );
 
                 ResizeView( event.display.width, event.display.height );
+                forceDraw = true;
+            }
+            else if ( event.any.type == ALLEGRO_EVENT_DISPLAY_SWITCH_IN )
+            {
+                forceDraw = true;
+            }
+            else if ( event.any.type == ALLEGRO_EVENT_AUDIO_STREAM_FINISHED )
+            {
+                Sound::HandleEvent( event );
+            }
+            else if ( event.any.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN 
+                && event.mouse.button == 1 )
+            {
+                HandleClick( event.mouse.x, event.mouse.y );
+            }
+            else if ( event.any.type == ALLEGRO_EVENT_TOUCH_BEGIN 
+                && event.touch.primary )
+            {
+                HandleClick( (int) event.touch.x, (int) event.touch.y );
             }
         }
 
@@ -221,16 +353,18 @@ static void Run()
 
             Input::Update();
             SceneStack::Update();
-            Sound::Update();
 
             startTime += FrameTime;
             updated = true;
         }
 
-        if ( updated )
+        if ( updated && (forceDraw || SceneStack::NeedsDraw()) )
         {
+            Presenter::BeginFrame();
             SceneStack::Draw();
+            Presenter::EndFrame();
             al_flip_display();
+            forceDraw = false;
         }
 
         double timeLeft = startTime + FrameTime - al_get_time();
@@ -239,6 +373,8 @@ static void Run()
         else
             waitSpan = 0;
     }
+
+    WriteStats( "stats.txt" );
 }
 
 void AdjustForDpi( int& width, int& height )
@@ -297,6 +433,7 @@ static bool MakeDisplay()
     if ( display == nullptr )
         return false;
 
+    Presenter::Init( display );
     ResizeView( width, height );
 
     return true;
@@ -314,6 +451,9 @@ static bool InitAllegro()
 
     if ( !al_install_keyboard() )
         return false;
+
+    al_install_mouse();
+    al_install_touch_input();
     if ( !al_install_audio() )
         return false;
     if ( !al_init_image_addon() )
@@ -327,9 +467,13 @@ static bool InitAllegro()
     if ( eventQ == nullptr )
         return false;
 
+    if ( !Atlas::Init() )
+        return false;
     if ( !Text::Init() )
         return false;
-    if ( !Sound::Init() )
+    if ( !SoftRender::Init() )
+        return false;
+    if ( !Sound::Init( eventQ ) )
         return false;
 
     return true;
@@ -338,7 +482,10 @@ static bool InitAllegro()
 static void UninitAllegro()
 {
     Sound::Uninit();
+    SoftRender::Uninit();
+    Presenter::Uninit();
     Text::Uninit();
+    Atlas::Uninit();
 
     if ( eventQ != nullptr )
         al_destroy_event_queue( eventQ );
@@ -346,6 +493,8 @@ static void UninitAllegro()
     al_shutdown_primitives_addon();
     al_shutdown_image_addon();
     al_uninstall_audio();
+    al_uninstall_touch_input();
+    al_uninstall_mouse();
     al_uninstall_keyboard();
     al_destroy_display( display );
     al_uninstall_system();
@@ -355,7 +504,13 @@ int main( int argc, char** argv )
 {
     if ( InitAllegro() )
     {
+#if defined( TEXT_BENCHMARK )
+        Text::RunBenchmark( "textBench.txt" );
+#elif defined( MAP_BENCHMARK )
+        RunMapBenchmark( "mapBench.txt" );
+#else
         Run();
+#endif
     }
 
     UninitAllegro();
@@ -8,6 +8,12 @@
 #include "Common.h"
 #include "Global.h"
 
+#if defined( _M_IX86 ) || defined( _M_X64 )
+#include <emmintrin.h>
+#include <intrin.h>
+#define MAP_SSE2 1
+#endif
+
 
 static uint32_t timeBaseMillis;
 static uint32_t runStartMillis;
@@ -32,7 +38,139 @@ Direction GetOppositeDir( Direction direction )
     }
 }
 
+// Counts the tile refs before the next run or the end marker; that is, 
+// before the next byte with the top bit set.
+
+static int CountLiterals( const uint8_t* compressedCells )
+{
+#if MAP_SSE2
+    // Aligned loads never cross into another page, so looking at the bytes 
+    // past the end marker in the same block is safe.
+
+    uintptr_t addr = (uintptr_t) compressedCells;
+    const __m128i* block = (const __m128i*) (addr & ~(uintptr_t) 15);
+    int skip = (int) (addr & 15);
+    unsigned long index;
+
+    unsigned int mask = (unsigned int) _mm_movemask_epi8( _mm_load_si128( block ) ) >> skip;
+
+    if ( _BitScanForward( &index, mask ) )
+        return (int) index;
+
+    int count = 16 - skip;
+
+    for ( ; ; )
+    {
+        block++;
+        mask = (unsigned int) _mm_movemask_epi8( _mm_load_si128( block ) );
+
+        if ( _BitScanForward( &index, mask ) )
+            return count + (int) index;
+
+        count += 16;
+    }
+#else
+    int count = 0;
+
+    while ( (int8_t) compressedCells[count] >= 0 )
+        count++;
+
+    return count;
+#endif
+}
+
 void DecompressMap( const uint8_t* compressedCells, uint8_t* uncompressedCells )
+{
+    for ( ; ; )
+    {
+        int literals = CountLiterals( compressedCells );
+
+        memcpy( uncompressedCells, compressedCells, literals );
+        compressedCells += literals;
+        uncompressedCells += literals;
+
+        if ( *compressedCells == 0xff )
+            break;
+
+        int tileRef = *compressedCells++ & 0x7f;
+        int count = *compressedCells++;
+
+        if ( count == 0 )
+            count = 256;
+
+        memset( uncompressedCells, tileRef, count );
+        uncompressedCells += count;
+    }
+}
+
+int CompressMap( const uint8_t* uncompressedCells, int count, uint8_t* compressedCells )
+{
+    uint8_t* start = compressedCells;
+
+    for ( int i = 0; i < count; )
+    {
+        uint8_t tileRef = uncompressedCells[i];
+        int runLength = 1;
+
+        while ( i + runLength < count 
+            && runLength < 256 
+            && uncompressedCells[i + runLength] == tileRef )
+        {
+            runLength++;
+        }
+
+        // A run of tile 7F would look like the end marker, so it's written 
+        // out ref by ref.
+
+        if ( runLength == 1 || tileRef == 0x7f )
+        {
+            memset( compressedCells, tileRef, runLength );
+            compressedCells += runLength;
+        }
+        else
+        {
+            *compressedCells++ = tileRef | 0x80;
+            *compressedCells++ = (uint8_t) runLength;
+        }
+
+        i += runLength;
+    }
+
+    *compressedCells++ = 0xff;
+
+    return (int) (compressedCells - start);
+}
+
+int GetDecompressedMapSize( const uint8_t* compressedCells, int maxCompressedSize )
+{
+    int total = 0;
+    int i = 0;
+
+    for ( ; i < maxCompressedSize && compressedCells[i] != 0xff; i++ )
+    {
+        if ( (int8_t) compressedCells[i] < 0 )
+        {
+            i++;
+            if ( i >= maxCompressedSize )
+                return -1;
+
+            int count = compressedCells[i];
+            total += (count == 0) ? 256 : count;
+        }
+        else
+        {
+            total++;
+        }
+    }
+
+    if ( i >= maxCompressedSize )
+        return -1;
+
+    return total;
+}
+
+#if defined( MAP_BENCHMARK )
+static void DecompressMapBytewise( const uint8_t* compressedCells, uint8_t* uncompressedCells )
 {
     for ( ; *compressedCells != 0xff; compressedCells++ )
     {
@@ -56,6 +194,106 @@ void DecompressMap( const uint8_t* compressedCells, uint8_t* uncompressedCells )
     }
 }
 
+template <size_t Length>
+static void BenchMapTable( FILE* out, const char* filename, int entries, int cellCount )
+{
+    const int Rounds = 200;
+    const int MaxCells = 64 * 64;
+
+    static uint8_t cells[MaxCells];
+    static uint8_t refCells[MaxCells];
+    static uint8_t recompressed[MaxCells + 1];
+
+    Table<uint8_t, Length> table;
+
+    if ( !LoadResource( filename, &table ) )
+    {
+        fprintf( out, "%-14s couldn't be loaded\n", filename );
+        return;
+    }
+
+    int identical = 0;
+    int mismatched = 0;
+    int totalBytes = 0;
+
+    for ( int i = 0; i < entries; i++ )
+    {
+        const uint8_t* item = table.GetItem( i );
+
+        DecompressMap( item, cells );
+        DecompressMapBytewise( item, refCells );
+
+        if ( memcmp( cells, refCells, cellCount ) != 0 )
+            mismatched++;
+
+        int size = CompressMap( cells, cellCount, recompressed );
+        totalBytes += size;
+
+        if ( memcmp( recompressed, item, size ) == 0 )
+            identical++;
+    }
+
+    double start = al_get_time();
+
+    for ( int r = 0; r < Rounds; r++ )
+        for ( int i = 0; i < entries; i++ )
+            DecompressMapBytewise( table.GetItem( i ), cells );
+
+    double bytewiseTime = (al_get_time() - start) / Rounds;
+
+    start = al_get_time();
+
+    for ( int r = 0; r < Rounds; r++ )
+        for ( int i = 0; i < entries; i++ )
+            DecompressMap( table.GetItem( i ), cells );
+
+    double decodeTime = (al_get_time() - start) / Rounds;
+
+    start = al_get_time();
+
+    for ( int r = 0; r < Rounds; r++ )
+    {
+        for ( int i = 0; i < entries; i++ )
+        {
+            DecompressMap( table.GetItem( i ), cells );
+            CompressMap( cells, cellCount, recompressed );
+        }
+    }
+
+    double encodeTime = (al_get_time() - start) / Rounds - decodeTime;
+
+    fprintf( out, "%-14s %8d %8d %8d %8d %10.1f %10.1f %10.1f\n", 
+        filename, 
+        entries, 
+        identical, 
+        mismatched, 
+        totalBytes, 
+        bytewiseTime * 1000000, 
+        decodeTime * 1000000, 
+        encodeTime * 1000000 );
+}
+
+void RunMapBenchmark( const char* path )
+{
+    // The level map table has room for 64 maps, but only 61 are in the game
+    const int LevelMaps = 61;
+    FILE* file = nullptr;
+
+    if ( fopen_s( &file, path, "w" ) != 0 )
+        return;
+
+    fprintf( file, "%-14s %8s %8s %8s %8s %10s %10s %10s\n", 
+        "File", "Entries", "Same", "Differ", "Bytes", "us/table", "us/table", "us/table" );
+    fprintf( file, "%-14s %8s %8s %8s %8s %10s %10s %10s\n", 
+        "", "", "encoded", "decoded", "encoded", "bytewise", "decode", "encode" );
+
+    BenchMapTable<64>( file, "levelMaps.tab", LevelMaps, 64 * 64 );
+    BenchMapTable<256>( file, "owMap.tab", 256, 256 );
+
+    fclose( file );
+}
+#endif
+
 bool LoadResource( const char* filename, ResourceLoader* loader )
 {
     FILE* file = nullptr;
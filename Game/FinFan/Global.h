@@ -214,6 +214,7 @@ const int NoItem = 0;
 const int ConfirmKey = ALLEGRO_KEY_F;
 const int CancelKey = ALLEGRO_KEY_D;
 const int MenuKey = ALLEGRO_KEY_ENTER;
+const int MapKey = ALLEGRO_KEY_S;
 
 const int StdViewWidth = 256;
 const int StdViewHeight = 240;
@@ -257,10 +258,12 @@ class Table : public ResourceLoader
 {
     uint16_t    offsets[Length];
     uint8_t*    buffer;
+    int         heapSize;
 
 public:
     Table()
-        :   buffer( nullptr )
+        :   buffer( nullptr ),
+            heapSize( 0 )
     {
     }
 
@@ -274,7 +277,7 @@ public:
         assert( file != nullptr );
         assert( buffer == nullptr );
 
-        int heapSize = fileSize - sizeof offsets;
+        heapSize = fileSize - sizeof offsets;
 
         buffer = new uint8_t[heapSize];
         if ( buffer == nullptr )
@@ -293,6 +296,11 @@ public:
 
         return (T*) (buffer + offsets[index]);
     }
+
+    int GetHeapSize()
+    {
+        return heapSize;
+    }
 };
 
 
@@ -309,6 +317,20 @@ inline bool operator!=( const Point& left, const Point& right )
 
 void DecompressMap( const uint8_t* compressedCells, uint8_t* uncompressedCells );
 
+// Writes tile refs in the format that DecompressMap reads, and returns the 
+// number of bytes written. The buffer needs room for count + 1 bytes.
+int CompressMap( const uint8_t* uncompressedCells, int count, uint8_t* compressedCells );
+
+// Returns the number of tile refs that compressed cells expand to, or -1 if 
+// the end marker isn't found in so many bytes.
+int GetDecompressedMapSize( const uint8_t* compressedCells, int maxCompressedSize );
+
+#if defined( MAP_BENCHMARK )
+// Times decompressing every level map and overworld row, checks that they 
+// compress back to the same bytes, and writes a table to the given file.
+void RunMapBenchmark( const char* path );
+#endif
+
 bool LoadResource( const char* filename, ResourceLoader* loader );
 
 template <typename T>
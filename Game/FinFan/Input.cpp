@@ -20,6 +20,11 @@ static int repeatingKey;
 static int repeatTimer;
 static bool signalRepeat;
 
+static bool clickAdded;
+static Point addedClickPos;
+static bool clicked;
+static Point clickPos;
+
 
 bool Input::IsKeyDown( int keyCode )
 {
@@ -64,6 +69,32 @@ Direction Input::GetInputDirection()
     return Dir_None;
 }
 
+bool Input::GetClick( Point& pos )
+{
+    if ( !clicked )
+        return false;
+
+    pos = clickPos;
+    return true;
+}
+
+void Input::AddClick( int viewX, int viewY )
+{
+    if ( viewX < 0 || viewX >= StdViewWidth || viewY < 0 || viewY >= StdViewHeight )
+        return;
+
+    addedClickPos.X = viewX;
+    addedClickPos.Y = viewY;
+    clickAdded = true;
+}
+
+bool Input::HasChanged()
+{
+    return signalRepeat
+        || clicked
+        || memcmp( &keyboardState, &oldKeyboardState, sizeof keyboardState ) != 0;
+}
+
 void Input::ResetRepeat()
 {
     repeating = false;
@@ -129,4 +160,8 @@ void Input::Update()
 {
     Poll();
     UpdateRepeater();
+
+    clicked = clickAdded;
+    clickPos = addedClickPos;
+    clickAdded = false;
 }
@@ -28,5 +28,15 @@ public:
 
     static void ResetRepeat();
 
+    // Whether any key went down or up, or a held key repeated, this frame
+    static bool HasChanged();
+
+    // Gets the spot in the view that was clicked or touched this frame
+    static bool GetClick( Point& pos );
+
+    // The event loop passes on clicks and touches, already mapped to the 
+    // view. They're seen starting with the next Update.
+    static void AddClick( int viewX, int viewY );
+
     static void Update();
 };
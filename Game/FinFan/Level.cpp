@@ -7,11 +7,15 @@
 
 #include "Common.h"
 #include "Level.h"
+#include "Atlas.h"
+#include "DrawList.h"
+#include "Encounters.h"
 #include "MapSprite.h"
-#include "FlyerSprite.h"
 #include "LTile.h"
 #include "ObjEvents.h"
+#include "PathFinder.h"
 #include "Player.h"
+#include "Presenter.h"
 #include "Ids.h"
 #include "SceneStack.h"
 #include "Sound.h"
@@ -42,6 +46,24 @@ enum
     Tile_OpenChest      = 0x7f,
 };
 
+// Flying objects flap through two frames without turning or flipping. Their 
+// frames run one update later than walking objects'.
+
+const Bounds16 flyerGoUpFrames[2] = 
+{
+    { 1 * 16, 0 * 16, 16, 16 },
+    { 0 * 16, 0 * 16, 16, 16 },
+};
+
+const Bounds16 flyerGoLeftFrames[2] = 
+{
+    { 3 * 16, 0 * 16, 16, 16 },
+    { 2 * 16, 0 * 16, 16, 16 },
+};
+
+const int ObjectFrameTime = 7;
+const int FlyerFirstFrameTime = 8;
+
 
 Level* Level::instance;
 
@@ -59,6 +81,11 @@ Level::Level()
         objectsImage( nullptr ),
         playerImage( nullptr ),
         playerSprite( nullptr ),
+        pathFinder( nullptr ),
+        walkPending( false ),
+        walkGoalCol( 0 ),
+        walkGoalRow( 0 ),
+        objectCount( 0 ),
         nextObjIndex( 0 ),
         curUpdate( &Level::UpdateFootIdle ),
         movingDir( Dir_None ),
@@ -83,13 +110,18 @@ Level::Level()
     tiles[0] = nullptr;
     tiles[1] = nullptr;
 
-    memset( objectSprites, 0, sizeof objectSprites );
-    memset( objects, 0, sizeof objects );
+    memset( &objects, 0, sizeof objects );
+    memset( objectAt, NoObject, sizeof objectAt );
+    memset( objectLeavingAt, NoObject, sizeof objectLeavingAt );
+
+    static_assert( Objects < NoObject, "Object indexes must fit in the occupancy grids." );
+    static_assert( Objects % ObjectTurnFrames == 0, "Objects must get turns at the same rate." );
 }
 
 Level::~Level()
 {
-    instance = nullptr;
+    if ( instance == this )
+        instance = nullptr;
 
     for ( int i = 0; i < _countof( tiles ); i++ )
     {
@@ -100,17 +132,13 @@ Level::~Level()
     al_destroy_bitmap( playerImage );
 
     delete playerSprite;
-
-    for ( int i = 0; i < _countof( objectSprites ); i++ )
-    {
-        delete objectSprites[i];
-    }
+    delete pathFinder;
 }
 
 void Level::Init( int mapId, int startCol, int startRow, int inRoomState )
 {
     const int AllTileAttrCount = TileSets * TileTypes;
-    const int AllObjSpecCount = MapCount * Objects;
+    const int AllObjSpecCount = MapCount * ObjectSpecsPerMap;
 
     Table<uint8_t, MapCount> compressedMaps;
     uint8_t imagesets[MapCount];
@@ -146,20 +174,20 @@ void Level::Init( int mapId, int startCol, int startRow, int inRoomState )
     char filename[MAX_PATH] = "";
 
     sprintf_s( filename, "levelTilesOut%02x.png", imagesets[mapId] );
-    tiles[Out] = al_load_bitmap( filename );
+    tiles[Out] = Atlas::Load( filename );
     if ( tiles[Out] == nullptr )
         return;
 
     sprintf_s( filename, "levelTilesIn%02x.png", imagesets[mapId] );
-    tiles[In] = al_load_bitmap( filename );
+    tiles[In] = Atlas::Load( filename );
     if ( tiles[In] == nullptr )
         return;
 
-    objectsImage = al_load_bitmap( "mapObjects.png" );
+    objectsImage = Atlas::Load( "mapObjects.png" );
     if ( objectsImage == nullptr )
         return;
 
-    playerImage = al_load_bitmap( "mapPlayer.png" );
+    playerImage = Atlas::Load( "mapPlayer.png" );
     if ( playerImage == nullptr )
         return;
 
@@ -193,6 +221,7 @@ void Level::Init( int mapId, int startCol, int startRow, int inRoomState )
 
     DecompressMap( compressedMaps.GetItem( mapId ), (uint8_t*) tileRefs );
     ChangeTiles();
+    MakePassMap();
 
     playerCol = startCol;
     playerRow = startRow;
@@ -209,13 +238,42 @@ void Level::Init( int mapId, int startCol, int startRow, int inRoomState )
     this->mapId = mapId;
     inRoom = (InOut) inRoomState;
 
-    MakeObjects( &allObjectSpecs[mapId * Objects], Objects );
+    MakeObjects( &allObjectSpecs[mapId * ObjectSpecsPerMap], ObjectSpecsPerMap );
+
+    Sound::PlayTrack( song, 0, true );
+
+    SceneStack::BeginFade( 15, Color::Black(), Color::Transparent(), [] {} );
+}
+
+void Level::Suspend()
+{
+    if ( instance == this )
+        instance = nullptr;
+}
+
+void Level::Resume()
+{
+    instance = this;
+
+    // Objects could have been shown or hidden, or the party's class 
+    // changed, in the levels further down
+    RefreshVisibleObjects();
 
     Sound::PlayTrack( song, 0, true );
 
     SceneStack::BeginFade( 15, Color::Black(), Color::Transparent(), [] {} );
 }
 
+int Level::GetMemorySize()
+{
+    int size = sizeof *this + messages.GetHeapSize();
+
+    if ( pathFinder != nullptr )
+        size += pathFinder->GetMemorySize();
+
+    return size;
+}
+
 void Level::ChangeTiles()
 {
     for ( int row = 0; row < RowCount; row++ )
@@ -244,53 +302,76 @@ void Level::MakeObjects( const ObjectSpec* objSpecs, int count )
         if ( spec.Type == 0 )
             break;
 
-        auto& obj = objects[i];
+        objects.OrigType[i] = spec.Type;
+        objects.Flags[i] = spec.Flags;
+        objects.Col[i] = spec.Col;
+        objects.Row[i] = spec.Row;
 
-        obj.OrigType = spec.Type;
-        obj.Flags = spec.Flags;
-        obj.Col = spec.Col;
-        obj.Row = spec.Row;
-        obj.LastCol = spec.Col;
-        obj.LastRow = spec.Row;
+        objectCount = i + 1;
 
         if ( Player::GetObjVisible( spec.Type ) )
-        {
-            obj.Type = spec.Type;
-
-            MakeObjectSprite( i );
-        }
+            ShowObject( i );
     }
 }
 
-void Level::MakeObjectSprite( int index )
+void Level::ShowObject( int index )
 {
-    auto& obj = objects[index];
+    objects.Type[index] = objects.OrigType[index];
+    objects.LastCol[index] = objects.Col[index];
+    objects.LastRow[index] = objects.Row[index];
+    objects.OffsetX[index] = 0;
+    objects.OffsetY[index] = 0;
+    objects.SpeedX[index] = 0;
+    objects.SpeedY[index] = 0;
+    objects.Dir[index] = Dir_Down;
+    objects.Frame[index] = 0;
+    objects.FrameTimer[index] = ((objects.Flags[index] & Obj_Flyer) != 0) ? FlyerFirstFrameTime : 0;
+
+    PlaceObject( index );
+}
 
-    ICustomMapSprite* sprite = nullptr;
-    int frameOffsetRow = obj.Type;
+void Level::PlaceObject( int index )
+{
+    objectAt[objects.Row[index]][objects.Col[index]] = index;
+    objectLeavingAt[objects.LastRow[index]][objects.LastCol[index]] = index;
+}
 
-    if ( (obj.Flags & Obj_Flyer) != 0 )
-        sprite = new FlyerSprite( objectsImage );
-    else
-        sprite = new MapSprite( objectsImage );
+void Level::RemoveObject( int index )
+{
+    int col = objects.Col[index];
+    int row = objects.Row[index];
+    int lastCol = objects.LastCol[index];
+    int lastRow = objects.LastRow[index];
+
+    if ( objectAt[row][col] == index )
+        objectAt[row][col] = NoObject;
+
+    if ( objectLeavingAt[lastRow][lastCol] == index )
+        objectLeavingAt[lastRow][lastCol] = NoObject;
+}
 
-    sprite->SetFrames( frameOffsetRow * TileHeight );
-    sprite->SetX( obj.Col * TileWidth );
-    sprite->SetY( obj.Row * TileHeight );
+void Level::SetObjectDirection( int index, Direction dir )
+{
+    objects.Dir[index] = dir;
 
-    if ( (obj.Flags & Obj_Stand) != 0
-        || (obj.Flags & Obj_Flyer) != 0 )
+    // Like a sprite that gets new frames, a flyer starts its flapping over
+    if ( (objects.Flags[index] & Obj_Flyer) != 0 )
     {
-        sprite->Start();
+        objects.Frame[index] = 0;
+        objects.FrameTimer[index] = FlyerFirstFrameTime;
     }
-
-    objectSprites[index] = sprite;
 }
 
 void Level::Update()
 {
     if ( SceneStack::IsFading() )
+    {
+        walkPending = false;
+        walker.Stop();
         return;
+    }
+
+    UpdateWalk();
 
     (this->*curUpdate)();
 
@@ -298,9 +379,8 @@ void Level::Update()
 
     if ( dialog.IsClosed() )
     {
-        UpdateMoveObjects();
+        UpdateObjects();
         UpdateObject();
-        UpdateObjectSprites();
     }
 }
 
@@ -347,18 +427,31 @@ void Level::ShiftMap( int shiftX, int shiftY )
 
 void Level::Draw()
 {
+    DrawList::Begin();
+
+    DrawList::SetLayer( Layer_Map );
     DrawMap();
+
+    DrawList::SetLayer( Layer_Player );
     DrawPlayer();
+
+    DrawList::SetLayer( Layer_Objects );
     DrawObjects();
 
     if ( !dialog.IsClosed() )
         dialog.Draw();
 
+    DrawList::End();
+
     if ( flashMove )
     {
         int offset = offsetX + offsetY;
         bool flashNow = (offset & 1) == 1;
-        if ( flashNow )
+        if ( flashNow && Presenter::IsActive() )
+        {
+            Presenter::Shade( al_map_rgb( 128, 128, 128 ), 1 );
+        }
+        else if ( flashNow )
         {
             int op, src, dst;
             al_get_blender( &op, &src, &dst );
@@ -374,8 +467,6 @@ void Level::DrawMap()
     int tileSet = (inRoom == Out) ? 0 : 1;
     ALLEGRO_BITMAP* bmp = tiles[tileSet];
 
-    al_hold_bitmap_drawing( true );
-
     for ( int i = 0; i < VisibleRows; i++ )
     {
         for ( int j = 0; j < VisibleCols; j++ )
@@ -388,11 +479,9 @@ void Level::DrawMap()
             int destX = j * TileWidth - offsetX;
             int destY = i * TileHeight - offsetY;
 
-            al_draw_bitmap_region( bmp, srcX, srcY, TileWidth, TileHeight, destX, destY, 0 );
+            DrawList::DrawBitmapRegion( bmp, srcX, srcY, TileWidth, TileHeight, destX, destY, 0 );
         }
     }
-
-    al_hold_bitmap_drawing( false );
 }
 
 void Level::DrawPlayer()
@@ -408,28 +497,56 @@ void Level::DrawObjects()
     int left = leftCol * TileWidth + offsetX;
     int top = topRow * TileHeight + offsetY;
 
-    for ( int i = 0; i < Objects; i++ )
+    for ( int i = 0; i < objectCount; i++ )
     {
-        if ( objectSprites[i] != nullptr && IsVisible( i ) )
-        {
-            IMapSprite* sprite = objectSprites[i];
+        if ( objects.Type[i] == 0 || !IsVisible( i ) )
+            continue;
 
-            // if we need to draw parts of sprites on the left edge of screen,
-            // then we'll have to sign extend screenX and Y based on WorldWidth and Height
+        int x = objects.LastCol[i] * TileWidth + objects.OffsetX[i] / ObjectFixedOne;
+        int y = objects.LastRow[i] * TileHeight + objects.OffsetY[i] / ObjectFixedOne;
 
-            int screenX = (sprite->GetX() - left + WorldWidth) % WorldWidth;
-            int screenY = (sprite->GetY() - top + WorldHeight) % WorldHeight;
+        // if we need to draw parts of sprites on the left edge of screen,
+        // then we'll have to sign extend screenX and Y based on WorldWidth and Height
 
-            sprite->DrawAt( screenX, screenY );
-        }
+        int screenX = (x - left + 2 * WorldWidth) % WorldWidth;
+        int screenY = (y - top + 2 * WorldHeight) % WorldHeight;
+
+        if ( screenX >= VisibleCols * TileWidth || screenY >= VisibleRows * TileHeight )
+            continue;
+
+        DrawObject( i, screenX, screenY );
     }
 }
 
-bool Level::IsVisible( int objIndex )
+void Level::DrawObject( int index, int screenX, int screenY )
 {
-    const auto& obj = objects[objIndex];
+    Direction dir = (Direction) objects.Dir[index];
+    int frame = objects.Frame[index];
+    int frameOffsetY = objects.Type[index] * TileHeight;
+
+    if ( (objects.Flags[index] & Obj_Flyer) != 0 )
+    {
+        const Bounds16* frames = (dir == Dir_Left || dir == Dir_Right) ? flyerGoLeftFrames : flyerGoUpFrames;
+
+        DrawList::DrawBitmapRegion(
+            objectsImage,
+            frames[frame].X,
+            frames[frame].Y + frameOffsetY,
+            frames[frame].Width,
+            frames[frame].Height,
+            screenX,
+            screenY,
+            0 );
+    }
+    else
+    {
+        MapSprite::DrawFrameAt( objectsImage, dir, frame, frameOffsetY, true, screenX, screenY );
+    }
+}
 
-    return ((obj.Flags & Obj_InRoom) != 0) == (inRoom == In);
+bool Level::IsVisible( int objIndex )
+{
+    return ((objects.Flags[objIndex] & Obj_InRoom) != 0) == (inRoom == In);
 }
 
 Point Level::GetPlayerRowCol()
@@ -467,6 +584,54 @@ int Level::GetTileRef( int col, int row )
 void Level::SetTileRef( int col, int row, int tileRef )
 {
     tileRefs[row][col] = tileRef;
+    UpdatePassMap( col, row );
+}
+
+void Level::MakePassMap()
+{
+    for ( int row = 0; row < RowCount; row++ )
+    {
+        for ( int col = 0; col < ColCount; col++ )
+        {
+            UpdatePassMap( col, row );
+        }
+    }
+}
+
+void Level::UpdatePassMap( int col, int row )
+{
+    uint16_t attrs = tileAttr[tileRefs[row][col]];
+    bool special = LTile::GetSpecial( attrs ) != 0;
+    uint32_t modes = 0;
+
+    if ( LTile::CanWalk( attrs ) || special )
+        modes |= 1 << Pass_Walk;
+
+    if ( special )
+        modes |= 1 << Pass_Special;
+
+    if ( LTile::CanWalk( attrs ) && LTile::GetTeleportType( attrs ) == LTile::TT_None )
+        modes |= 1 << Pass_Object;
+
+    switch ( LTile::GetSpecial( attrs ) )
+    {
+    case LTile::S_Locked:
+    case LTile::S_Treasure:
+    case LTile::S_Crown:
+    case LTile::S_Cube:
+    case LTile::S_4Orbs:
+        break;
+
+    default:
+        if ( (modes & (1 << Pass_Walk)) != 0 )
+            modes |= 1 << Pass_Route;
+        break;
+    }
+
+    passMap.SetModes( col, row, modes );
+
+    if ( pathFinder != nullptr )
+        pathFinder->Invalidate( col, row );
 }
 
 void Level::OpenDoor( int col, int row )
@@ -475,7 +640,7 @@ void Level::OpenDoor( int col, int row )
     {
         int tile = tileRefs[row][col];
 
-        tileRefs[row][col] = Tile_OpenDoor;
+        SetTileRef( col, row, Tile_OpenDoor );
 
         if ( tile == Tile_LockedDoor )
             inRoom = InLocked;
@@ -516,7 +681,7 @@ void Level::CloseDoor( int col, int row )
         int tile = (inRoom == InLocked) ? Tile_LockedDoor : Tile_UnlockedDoor;
         int doorRow = (row - 1 + RowCount) % RowCount;
 
-        tileRefs[doorRow][col] = tile;
+        SetTileRef( col, doorRow, tile );
 
         Sound::PlayEffect( SEffect_Door );
 
@@ -530,10 +695,8 @@ void Level::WalkBattle( uint16_t attrs )
 
     if ( LTile::IsRandomBattle( formation ) )
     {
-        int r = GetNextRandom( 256 );
-
         // no fight
-        if ( r >= battleRate )
+        if ( !Encounters::Step( battleRate ) )
             return;
 
         formation = GetBattleFormation();
@@ -631,13 +794,10 @@ bool Level::CanWalkSpecial( int col, int row )
 
 bool Level::CanWalk( int col, int row )
 {
-    uint8_t ref = GetTileRef( col, row );
-    uint16_t attrs = tileAttr[ref];
-
-    if ( !LTile::CanWalk( attrs ) && LTile::GetSpecial( attrs ) == 0 )
+    if ( !passMap.Get( Pass_Walk, col, row ) )
         return false;
 
-    if ( !CanWalkSpecial( col, row ) )
+    if ( passMap.Get( Pass_Special, col, row ) && !CanWalkSpecial( col, row ) )
         return false;
 
     return true;
@@ -645,33 +805,30 @@ bool Level::CanWalk( int col, int row )
 
 bool Level::CanPlayerMove( int col, int row )
 {
-    for ( int i = 0; i < Objects; i++ )
-    {
-        auto& obj = objects[i];
+    int index = objectAt[row][col];
 
-        if ( obj.Type == 0 )
-            continue;
+    if ( index != NoObject )
+    {
+        if ( objects.MoveTimer[index] >= 8 )
+            objects.MoveTimer[index] = 6;
+        return false;
+    }
 
-        if ( col == obj.Col && row == obj.Row )
-        {
-            if ( obj.MoveTimer >= 8 )
-                obj.MoveTimer = 6;
-            return false;
-        }
+    index = objectLeavingAt[row][col];
 
-        if ( col == obj.LastCol && row == obj.LastRow )
-        {
-            // TODO: animate the sprite faster
-            if ( obj.SpeedX < 0 )
-                obj.SpeedX = -0.5f;
-            else if ( obj.SpeedX > 0 )
-                obj.SpeedX = 0.5f;
-            else if ( obj.SpeedY < 0 )
-                obj.SpeedY = -0.5f;
-            else if ( obj.SpeedY > 0 )
-                obj.SpeedY = 0.5f;
-            break;
-        }
+    if ( index != NoObject )
+    {
+        const int FastSpeed = ObjectFixedOne / 2;
+
+        // TODO: animate the sprite faster
+        if ( objects.SpeedX[index] < 0 )
+            objects.SpeedX[index] = -FastSpeed;
+        else if ( objects.SpeedX[index] > 0 )
+            objects.SpeedX[index] = FastSpeed;
+        else if ( objects.SpeedY[index] < 0 )
+            objects.SpeedY[index] = -FastSpeed;
+        else if ( objects.SpeedY[index] > 0 )
+            objects.SpeedY[index] = FastSpeed;
     }
 
     if ( !CanWalk( col, row ) )
@@ -682,35 +839,32 @@ bool Level::CanPlayerMove( int col, int row )
 
 bool Level::CanPlayerTalk( int col, int row, int& objIndex )
 {
-    for ( int i = 0; i < Objects; i++ )
+    // An object is talked to on the tile it's leaving, until it's 
+    // halfway to the next one. If two objects qualify, the first wins.
+
+    int candidates[2] = { objectAt[row][col], objectLeavingAt[row][col] };
+    int found = NoObject;
+
+    for ( int i = 0; i < _countof( candidates ); i++ )
     {
-        auto& obj = objects[i];
+        int index = candidates[i];
 
-        if ( obj.Type == 0 )
+        if ( index == NoObject || index >= found )
             continue;
 
-        int intOffsetX = (int) obj.OffsetX;
-        int intOffsetY = (int) obj.OffsetY;
+        int intOffsetX = objects.OffsetX[index] / ObjectFixedOne;
+        int intOffsetY = objects.OffsetY[index] / ObjectFixedOne;
+        bool pastHalf = abs( intOffsetX ) >= TileWidth / 2 || abs( intOffsetY ) >= TileHeight / 2;
 
-        if ( abs( intOffsetX ) >= TileWidth / 2 || abs( intOffsetY ) >= TileHeight / 2 )
-        {
-            if ( col == obj.Col && row == obj.Row )
-            {
-                objIndex = i;
-                return true;
-            }
-        }
-        else
-        {
-            if ( col == obj.LastCol && row == obj.LastRow )
-            {
-                objIndex = i;
-                return true;
-            }
-        }
+        if ( pastHalf == (i == 0) )
+            found = index;
     }
 
-    return false;
+    if ( found == NoObject )
+        return false;
+
+    objIndex = found;
+    return true;
 }
 
 void Level::CheckObject( int type, CheckResult& result )
@@ -830,24 +984,27 @@ void Level::UpdateFootIdle()
 {
     if ( Input::IsKeyPressing( MenuKey ) )
     {
+        walker.Stop();
         SceneStack::ShowMenu();
         return;
     }
 
     if ( Input::IsKeyPressing( ConfirmKey ) )
     {
+        walker.Stop();
+
         Point facingPos = GetFacingRowCol( facingDir );
         int objIndex = 0;
         CheckResult result = { 0 };
 
         if ( CanPlayerTalk( facingPos.X, facingPos.Y, objIndex ) )
         {
-            CheckObject( objects[objIndex].Type, result );
+            CheckObject( objects.Type[objIndex], result );
 
             talkingObjIndex = objIndex;
-            talkingObjOrigDir = objectSprites[objIndex]->GetDirection();
+            talkingObjOrigDir = (Direction) objects.Dir[objIndex];
             Direction dirToPlayer = GetOppositeDir( facingDir );
-            objectSprites[objIndex]->SetDirection( dirToPlayer );
+            SetObjectDirection( objIndex, dirToPlayer );
         }
         else 
         {
@@ -865,7 +1022,7 @@ void Level::UpdateFootIdle()
         return;
     }
 
-    Direction dir = Input::GetInputDirection();
+    Direction dir = GetStepDirection();
 
     if ( dir != Dir_None )
     {
@@ -874,7 +1031,12 @@ void Level::UpdateFootIdle()
         facingDir = dir;
         playerSprite->SetDirection( dir );
 
-        if ( CanPlayerMove( facingPos.X, facingPos.Y ) )
+        // someone might have stepped in the way of a path
+        if ( !CanPlayerMove( facingPos.X, facingPos.Y ) )
+        {
+            walker.Stop();
+        }
+        else
         {
             movingDir = dir;
             playerCol = facingPos.X;
@@ -925,6 +1087,70 @@ void Level::UpdateMoving()
     }
 }
 
+// A click on the map sets a tile to walk to. The path is found from where 
+// the player stops next, and walked one step each time they're idle. The 
+// arrow keys take over from it.
+
+void Level::UpdateWalk()
+{
+    Point click;
+
+    if ( dialog.IsClosed() && Input::GetClick( click ) )
+    {
+        walkGoalCol = (leftCol + (click.X + offsetX) / TileWidth) % ColCount;
+        walkGoalRow = (topRow + (click.Y + offsetY) / TileHeight) % RowCount;
+        walkPending = true;
+        walker.Stop();
+    }
+
+    walker.Update();
+}
+
+Direction Level::GetStepDirection()
+{
+    Direction dir = Input::GetInputDirection();
+
+    if ( dir != Dir_None )
+    {
+        walkPending = false;
+        walker.Stop();
+        return dir;
+    }
+
+    if ( walkPending )
+    {
+        walkPending = false;
+        walker.Start( GetPathFinder(), playerCol, playerRow, walkGoalCol, walkGoalRow );
+        walker.Update();
+    }
+
+    return walker.GetNextStep();
+}
+
+PathFinder* Level::GetPathFinder()
+{
+    if ( pathFinder == nullptr )
+    {
+        PathFinder* finder = new PathFinder();
+
+        // Levels wrap around, like the overworld
+        auto readRow = [this]( int col, int row )
+        {
+            return (uint16_t) (passMap.GetRow( Pass_Route, row )[col / 32] >> (col % 32));
+        };
+
+        if ( !finder->Init( ColCount, RowCount, true, readRow ) )
+        {
+            delete finder;
+            return nullptr;
+        }
+
+        pathFinder = finder;
+    }
+
+    return pathFinder;
+}
+
 bool Level::CheckPendingAction()
 {
     Point curRowCol = GetPlayerRowCol();
@@ -950,7 +1176,7 @@ bool Level::CheckPendingAction()
 
                 // prepare for player coming out of shop
 
-                tileRefs[curRowCol.Y][curRowCol.X] = origShopDoor;
+                SetTileRef( curRowCol.X, curRowCol.Y, origShopDoor );
                 inRoom = Out;
                 playerSprite->SetDirection( Dir_Down );
             };
@@ -1042,23 +1268,21 @@ void Level::RefreshVisibleObjects()
 
     playerSprite->SetFrames( Player::Party[0]._class * 16 );
 
-    for ( int i = 0; i < Objects; i++ )
+    for ( int i = 0; i < objectCount; i++ )
     {
-        auto& obj = objects[i];
+        int origType = objects.OrigType[i];
 
-        if ( obj.OrigType == 0 )
+        if ( origType == 0 )
             continue;
 
-        if ( obj.Type == 0 && Player::GetObjVisible( obj.OrigType ) )
+        if ( objects.Type[i] == 0 && Player::GetObjVisible( origType ) )
         {
-            obj.Type = obj.OrigType;
-            MakeObjectSprite( i );
+            ShowObject( i );
         }
-        else if ( obj.Type != 0 && !Player::GetObjVisible( obj.OrigType ) )
+        else if ( objects.Type[i] != 0 && !Player::GetObjVisible( origType ) )
         {
-            obj.Type = 0;
-            delete objectSprites[i];
-            objectSprites[i] = nullptr;
+            RemoveObject( i );
+            objects.Type[i] = 0;
         }
     }
 }
@@ -1072,8 +1296,8 @@ void Level::UpdateDialog()
         RefreshVisibleObjects();
 
         if ( talkingObjIndex != NoObject
-            && objectSprites[talkingObjIndex] != nullptr )
-            objectSprites[talkingObjIndex]->SetDirection( talkingObjOrigDir );
+            && objects.Type[talkingObjIndex] != 0 )
+            SetObjectDirection( talkingObjIndex, talkingObjOrigDir );
 
         curUpdate = &Level::UpdateFootIdle;
 
@@ -1082,6 +1306,15 @@ void Level::UpdateDialog()
 }
 
 void Level::UpdateObject()
+{
+    // Every object gets a turn once in so many frames, however many there are
+    for ( int i = 0; i < Objects / ObjectTurnFrames; i++ )
+        UpdateObject( nextObjIndex + i );
+
+    nextObjIndex = (nextObjIndex + Objects / ObjectTurnFrames) % Objects;
+}
+
+void Level::UpdateObject( int index )
 {
     const Direction dirs[] = 
     {
@@ -1091,17 +1324,12 @@ void Level::UpdateObject()
         Dir_Up,
     };
 
-    int index = nextObjIndex;
-    auto& obj = objects[index];
-
-    nextObjIndex = (nextObjIndex + 1) % Objects;
-
-    if ( obj.Type == 0
-        || (obj.Flags & Obj_Stand) != 0
-        || (obj.SpeedX != 0 || obj.SpeedY != 0) )
+    if ( objects.Type[index] == 0
+        || (objects.Flags[index] & Obj_Stand) != 0
+        || (objects.SpeedX[index] != 0 || objects.SpeedY[index] != 0) )
         return;
 
-    if ( obj.MoveTimer == 0 )
+    if ( objects.MoveTimer[index] == 0 )
     {
         int r = GetNextRandom( 4 );
         Direction nextDir = dirs[r];
@@ -1117,99 +1345,113 @@ void Level::UpdateObject()
         case Dir_Up:    shiftRow = -1; break;
         }
 
-        uint8_t nextCol = (obj.Col + shiftCol + ColCount) % ColCount;
-        uint8_t nextRow = (obj.Row + shiftRow + RowCount) % RowCount;
+        int col = objects.Col[index];
+        int row = objects.Row[index];
+        uint8_t nextCol = (col + shiftCol + ColCount) % ColCount;
+        uint8_t nextRow = (row + shiftRow + RowCount) % RowCount;
 
         if ( CanObjectMove( index, nextCol, nextRow ) )
         {
-            obj.SpeedX = shiftCol * 0.25f;
-            obj.SpeedY = shiftRow * 0.25f;
+            const int WalkSpeed = ObjectFixedOne / 4;
+
+            objects.SpeedX[index] = shiftCol * WalkSpeed;
+            objects.SpeedY[index] = shiftRow * WalkSpeed;
+
+            objects.OffsetX[index] = 0;
+            objects.OffsetY[index] = 0;
 
-            obj.OffsetX = 0;
-            obj.OffsetY = 0;
+            if ( objectAt[row][col] == index )
+                objectAt[row][col] = NoObject;
 
-            obj.Col = nextCol;
-            obj.Row = nextRow;
+            objects.Col[index] = nextCol;
+            objects.Row[index] = nextRow;
 
-            objectSprites[index]->SetDirection( nextDir );
-            objectSprites[index]->Start();
+            objectAt[nextRow][nextCol] = index;
 
-            obj.MoveTimer = GetNextRandom( 8 ) * 2;
+            SetObjectDirection( index, nextDir );
+
+            objects.MoveTimer[index] = GetNextRandom( 8 ) * 2;
         }
         // else leave the timer 0 to pick another direction next time
     }
     else
     {
-        obj.MoveTimer--;
+        objects.MoveTimer[index]--;
     }
 }
 
 bool Level::CanObjectMove( int index, int col, int row )
 {
-    int ref = GetTileRef( col, row );
-    uint16_t attrs = tileAttr[ref];
-
-    if ( !LTile::CanWalk( attrs ) 
-        || LTile::GetTeleportType( attrs ) != LTile::TT_None
+    if ( !passMap.Get( Pass_Object, col, row )
         || (col == playerCol && row == playerRow) )
         return false;
 
-    for ( int i = 0; i < Objects; i++ )
-    {
-        if ( i == index || objects[i].Type == 0 )
-            continue;
+    int other = objectAt[row][col];
 
-        if ( col == objects[i].Col && row == objects[i].Row )
-            return false;
-    }
+    if ( other != NoObject && other != index )
+        return false;
 
     return true;
 }
 
-void Level::UpdateMoveObjects()
+void Level::UpdateObjects()
 {
-    for ( int i = 0; i < Objects; i++ )
-    {
-        auto& obj = objects[i];
+    // One pass moves every object and steps its animation. An object 
+    // animates while it walks, or all the time if it stands or flies.
 
-        if ( obj.Type == 0 )
-            continue;
-        if ( (obj.Flags & Obj_Stand) != 0 )
-            continue;
-        if ( obj.SpeedX == 0 && obj.SpeedY == 0 )
+    const int FlapOrStand = Obj_Flyer | Obj_Stand;
+    const int TileFixedWidth = TileWidth * ObjectFixedOne;
+    const int TileFixedHeight = TileHeight * ObjectFixedOne;
+
+    for ( int i = 0; i < objectCount; i++ )
+    {
+        if ( objects.Type[i] == 0 )
             continue;
 
-        obj.OffsetX += obj.SpeedX;
-        obj.OffsetY += obj.SpeedY;
+        int speedX = objects.SpeedX[i];
+        int speedY = objects.SpeedY[i];
 
-        int intOffsetX = (int) obj.OffsetX;
-        int intOffsetY = (int) obj.OffsetY;
+        if ( speedX != 0 || speedY != 0 )
+        {
+            int offsetX = objects.OffsetX[i] + speedX;
+            int offsetY = objects.OffsetY[i] + speedY;
 
-        int nextX = (obj.LastCol * TileWidth + intOffsetX + WorldWidth) % WorldWidth;
-        int nextY = (obj.LastRow * TileHeight + intOffsetY + WorldHeight) % WorldHeight;
+            if ( abs( offsetX ) >= TileFixedWidth || abs( offsetY ) >= TileFixedHeight )
+            {
+                int lastCol = objects.LastCol[i];
+                int lastRow = objects.LastRow[i];
 
-        objectSprites[i]->SetX( nextX );
-        objectSprites[i]->SetY( nextY );
+                if ( objectLeavingAt[lastRow][lastCol] == i )
+                    objectLeavingAt[lastRow][lastCol] = NoObject;
 
-        if ( abs( intOffsetX ) >= TileWidth || abs( intOffsetY ) >= TileHeight )
-        {
-            obj.SpeedX = 0;
-            obj.SpeedY = 0;
-            obj.LastCol = obj.Col;
-            obj.LastRow = obj.Row;
+                objects.LastCol[i] = objects.Col[i];
+                objects.LastRow[i] = objects.Row[i];
+
+                objectLeavingAt[objects.LastRow[i]][objects.LastCol[i]] = i;
 
-            objectSprites[i]->Stop();
+                speedX = 0;
+                speedY = 0;
+                offsetX = 0;
+                offsetY = 0;
+                objects.SpeedX[i] = 0;
+                objects.SpeedY[i] = 0;
+            }
+
+            objects.OffsetX[i] = offsetX;
+            objects.OffsetY[i] = offsetY;
         }
-    }
-}
 
-void Level::UpdateObjectSprites()
-{
-    for ( int i = 0; i < Objects; i++ )
-    {
-        if ( objectSprites[i] != nullptr )
+        if ( speedX != 0 || speedY != 0 || (objects.Flags[i] & FlapOrStand) != 0 )
         {
-            objectSprites[i]->Update();
+            if ( objects.FrameTimer[i] == 0 )
+            {
+                objects.Frame[i] ^= 1;
+                objects.FrameTimer[i] = ObjectFrameTime;
+            }
+            else
+            {
+                objects.FrameTimer[i]--;
+            }
         }
     }
 }
@@ -1226,6 +1468,20 @@ bool Level::IsActive()
     return instance != nullptr;
 }
 
+double Level::GetExpectedStepsToBattle()
+{
+    if ( instance == nullptr )
+        return -1;
+
+    uint16_t attrs = GetCurrentTileAttr();
+
+    if ( LTile::GetSpecial( attrs ) != LTile::S_Battle
+        || !LTile::IsRandomBattle( LTile::GetFormation( attrs ) ) )
+        return -1;
+
+    return Encounters::GetExpectedSteps( instance->battleRate );
+}
+
 uint16_t Level::GetCurrentTileAttr()
 {
     if ( instance == nullptr )
@@ -10,9 +10,10 @@
 #include "Module.h"
 #include "Dialog.h"
 #include "ObjEvents.h"
+#include "PassMap.h"
+#include "PathFinder.h"
 
 class MapSprite;
-class IMapSprite;
 
 
 class Level : public IModule, public IPlayfield
@@ -31,6 +32,15 @@ class Level : public IModule, public IPlayfield
         Obj_InRoom  = 0x80
     };
 
+    enum PassMode
+    {
+        Pass_Walk,          // the player can try to step here
+        Pass_Special,       // stepping here has to be checked by CanWalkSpecial
+        Pass_Object,        // objects can wander here
+        Pass_Route,         // the player can always step here
+        Pass_Max
+    };
+
     typedef void (Level::*UpdateFunc)();
 
     struct ObjectSpec
@@ -41,22 +51,6 @@ class Level : public IModule, public IPlayfield
         uint8_t Flags;
     };
 
-    struct Object
-    {
-        uint8_t Type;
-        uint8_t OrigType;
-        uint8_t Flags;
-        uint8_t MoveTimer;
-        uint8_t Col;
-        uint8_t Row;
-        uint8_t LastCol;
-        uint8_t LastRow;
-        float   OffsetX;
-        float   OffsetY;
-        float   SpeedX;
-        float   SpeedY;
-    };
-
     static const int TileTypes = 128;
     static const int RowCount = 64;
     static const int ColCount = 64;
@@ -73,13 +67,42 @@ class Level : public IModule, public IPlayfield
     static const int SwapTeleports = 64;
     static const int ExitTeleports = 16;
     static const int FirstLevelDomain = 64;
-    static const int Objects = 16;
+    static const int ObjectSpecsPerMap = 16;
+    static const int Objects = 240;
+    static const int ObjectTurnFrames = 16;
+    static const int ObjectFracBits = 4;
+    static const int ObjectFixedOne = 1 << ObjectFracBits;
     static const int DialogMessages = 256;
     static const int Chests = 256;
     static const int NoObject = 0xff;
 
     static Level* instance;
 
+    // The state of all objects, one array for each field, so that the pass 
+    // that moves and animates them every frame runs through memory in 
+    // order. Offsets and speeds are in pixels, in fixed point with 
+    // ObjectFracBits bits of fraction. An object is moving from LastCol and 
+    // LastRow to Col and Row as long as it has a speed.
+
+    struct ObjectTable
+    {
+        uint8_t Type[Objects];
+        uint8_t OrigType[Objects];
+        uint8_t Flags[Objects];
+        uint8_t MoveTimer[Objects];
+        uint8_t Col[Objects];
+        uint8_t Row[Objects];
+        uint8_t LastCol[Objects];
+        uint8_t LastRow[Objects];
+        uint8_t Dir[Objects];
+        uint8_t Frame[Objects];
+        uint8_t FrameTimer[Objects];
+        int16_t OffsetX[Objects];
+        int16_t OffsetY[Objects];
+        int8_t  SpeedX[Objects];
+        int8_t  SpeedY[Objects];
+    };
+
     // Maps must be uncompressed to get the tile references. 
     // Uncompress the whole current map into a buffer.
 
@@ -96,6 +119,15 @@ class Level : public IModule, public IPlayfield
 
     uint16_t tileAttr[TileTypes];
 
+    PassMap<RowCount, ColCount, Pass_Max> passMap;
+
+    // Made the first time the player clicks a tile to walk to
+    PathFinder* pathFinder;
+    PathWalker walker;
+    bool walkPending;
+    int walkGoalCol;
+    int walkGoalRow;
+
     LTeleport swapTeleports[SwapTeleports];
     OWTeleport exitTeleports[ExitTeleports];
 
@@ -117,10 +149,16 @@ class Level : public IModule, public IPlayfield
     uint8_t leftCol;
 
     MapSprite* playerSprite;
-    IMapSprite* objectSprites[Objects];
-    Object objects[Objects];
+    ObjectTable objects;
+    int objectCount;
     int nextObjIndex;
 
+    // The index of the visible object whose Col and Row, or LastCol and 
+    // LastRow, are on each tile; or NoObject. They're kept up to date as 
+    // objects move, appear, and disappear.
+    uint8_t objectAt[RowCount][ColCount];
+    uint8_t objectLeavingAt[RowCount][ColCount];
+
     UpdateFunc curUpdate;
     Direction movingDir;
     Direction facingDir;
@@ -151,6 +189,15 @@ public:
 
     void Init( int mapId, int startCol, int startRow, int inRoom );
 
+    // A suspended level is kept as it is, with its objects where they 
+    // were, while another scene is current. Resuming it makes it current
+    // again, and brings it up to date with what changed in the meantime.
+    void Suspend();
+    void Resume();
+
+    // About how much memory the level holds
+    int GetMemorySize();
+
     virtual void Update();
     virtual void Draw();
 
@@ -166,6 +213,10 @@ public:
     static bool IsActive();
     static uint16_t GetCurrentTileAttr();
 
+    // How many steps it's expected to take to start a battle, if the rest 
+    // of the tiles were like the player's; or -1 if there are no battles.
+    static double GetExpectedStepsToBattle();
+
 private:
     void DrawMap();
     void DrawPlayer();
@@ -175,18 +226,26 @@ private:
     void UpdateMoving();
     void UpdateDialog();
 
-    void UpdateMoveObjects();
+    void UpdateWalk();
+    Direction GetStepDirection();
+    PathFinder* GetPathFinder();
+
+    void UpdateObjects();
     void UpdateObject();
-    void UpdateObjectSprites();
+    void UpdateObject( int index );
 
     void MakeObjects( const ObjectSpec* objSpecs, int count );
+    void ShowObject( int index );
+    void PlaceObject( int index );
+    void RemoveObject( int index );
+    void SetObjectDirection( int index, Direction dir );
+    void DrawObject( int index, int screenX, int screenY );
     bool IsVisible( int objIndex );
     bool CanObjectMove( int index, int col, int row );
     bool CanPlayerMove( int col, int row );
     bool CanPlayerTalk( int col, int row, int& objIndex );
     void CheckObject( int type, CheckResult& result );
     void RefreshVisibleObjects();
-    void MakeObjectSprite( int index );
     void CheckTile( int col, int row, CheckResult& result );
     void OpenChest( int chestId, int col, int row, CheckResult& result );
     bool CanWalk( int col, int row );
@@ -208,6 +267,9 @@ private:
     int GetTileRef( int col, int row );
     void SetTileRef( int col, int row, int tileRef );
 
+    void MakePassMap();
+    void UpdatePassMap( int col, int row );
+
     int GetBattleFormation();
     void DealMoveDamage( int col, int row );
 
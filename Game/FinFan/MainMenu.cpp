@@ -7,6 +7,7 @@
 
 #include "Common.h"
 #include "MainMenu.h"
+#include "Atlas.h"
 #include "Menus.h"
 #include "ShopMenus.h"
 #include "Text.h"
@@ -32,13 +33,111 @@ MenuMaker makers[] =
 
 MainMenu* MainMenu::instance;
 
+static MenuStats stats;
+
+
+DirtyRect::DirtyRect()
+{
+    Clear();
+}
+
+void DirtyRect::Add( int x, int y, int width, int height )
+{
+    if ( x < left )
+        left = x;
+    if ( y < top )
+        top = y;
+    if ( x + width > right )
+        right = x + width;
+    if ( y + height > bottom )
+        bottom = y + height;
+
+    if ( left < 0 )
+        left = 0;
+    if ( top < 0 )
+        top = 0;
+    if ( right > StdViewWidth )
+        right = StdViewWidth;
+    if ( bottom > StdViewHeight )
+        bottom = StdViewHeight;
+}
+
+void DirtyRect::AddAll()
+{
+    left = 0;
+    top = 0;
+    right = StdViewWidth;
+    bottom = StdViewHeight;
+}
+
+void DirtyRect::Clear()
+{
+    left = StdViewWidth;
+    top = StdViewHeight;
+    right = 0;
+    bottom = 0;
+}
+
+bool DirtyRect::IsEmpty() const
+{
+    return left >= right || top >= bottom;
+}
+
+bool DirtyRect::IsAll() const
+{
+    return left == 0 && top == 0 && right == StdViewWidth && bottom == StdViewHeight;
+}
+
+int DirtyRect::GetX() const
+{
+    return left;
+}
+
+int DirtyRect::GetY() const
+{
+    return top;
+}
+
+int DirtyRect::GetWidth() const
+{
+    return right - left;
+}
+
+int DirtyRect::GetHeight() const
+{
+    return bottom - top;
+}
+
+
+bool Menu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    return false;
+}
+
+bool Menu::AddPrevIdleChanges( DirtyRect& dirty )
+{
+    if ( prevMenu == nullptr )
+        return true;
+
+    return prevMenu->AddIdleChanges( MenuDraw_Paused, dirty );
+}
+
+void Menu::AddCursorBlink( MenuDrawState state, int x, int y, DirtyRect& dirty )
+{
+    // A paused cursor is shown for 2 frames, then hidden for 2
+    if ( state == MenuDraw_Paused && (GetFrameCounter() % 2) == 0 )
+        dirty.Add( x, y, 16, 16 );
+}
+
 
 MainMenu::MainMenu()
     :   activeMenu( nullptr ),
         playerBmp( nullptr ),
-        menuBmp( nullptr )
+        menuBmp( nullptr ),
+        frameBmp( nullptr )
 {
     instance = this;
+    dirty.AddAll();
 }
 
 MainMenu::~MainMenu()
@@ -47,6 +146,7 @@ MainMenu::~MainMenu()
 
     PopAll();
 
+    al_destroy_bitmap( frameBmp );
     al_destroy_bitmap( menuBmp );
     al_destroy_bitmap( playerBmp );
 }
@@ -71,13 +171,17 @@ void MainMenu::Init()
     if ( !LoadResource( "shopText.tab", &shopText ) )
         return;
 
-    playerBmp = al_load_bitmap( "playerSprites.png" );
+    playerBmp = Atlas::Load( "playerSprites.png" );
     if ( playerBmp == nullptr )
         return;
 
-    menuBmp = al_load_bitmap( "menu.png" );
+    menuBmp = Atlas::Load( "menu.png" );
     if ( menuBmp == nullptr )
         return;
+
+    // The screen is kept here, so that it can be shown again as is, or 
+    // only the parts that changed drawn. Without it, it's drawn every frame.
+    frameBmp = al_create_bitmap( StdViewWidth, StdViewHeight );
 }
 
 void MainMenu::InitMain()
@@ -155,7 +259,11 @@ void MainMenu::Update()
     case Menu_Pop:
         Pop();
         if ( activeMenu == nullptr )
+        {
+            // This deletes the main menu
             SceneStack::HideMenu();
+            return;
+        }
         break;
 
     case Menu_Push:
@@ -167,13 +275,62 @@ void MainMenu::Update()
         Push( nextMenu );
         break;
     }
+
+    if ( action != Menu_None || Input::HasChanged() )
+        dirty.AddAll();
+    else if ( !activeMenu->AddIdleChanges( MenuDraw_Active, dirty ) )
+        dirty.AddAll();
+
+    if ( dirty.IsEmpty() )
+        stats.FramesSkipped++;
+}
+
+bool MainMenu::NeedsDraw()
+{
+    return frameBmp == nullptr || !dirty.IsEmpty();
 }
 
 void MainMenu::Draw()
 {
+    if ( frameBmp == nullptr )
+    {
+        al_clear_to_color( al_map_rgb( 0, 0, 0 ) );
+
+        activeMenu->Draw( MenuDraw_Active );
+        stats.FramesDrawn++;
+        return;
+    }
+
+    if ( !dirty.IsEmpty() )
+        DrawFrame();
+
+    al_draw_bitmap( frameBmp, 0, 0, 0 );
+}
+
+void MainMenu::DrawFrame()
+{
+    ALLEGRO_BITMAP* origBmp = al_get_target_bitmap();
+
+    al_set_target_bitmap( frameBmp );
+
+    if ( dirty.IsAll() )
+    {
+        stats.FramesDrawn++;
+    }
+    else
+    {
+        al_set_clipping_rectangle( dirty.GetX(), dirty.GetY(), dirty.GetWidth(), dirty.GetHeight() );
+        stats.FramesPartlyDrawn++;
+    }
+
     al_clear_to_color( al_map_rgb( 0, 0, 0 ) );
 
     activeMenu->Draw( MenuDraw_Active );
+
+    al_reset_clipping_rectangle();
+    al_set_target_bitmap( origBmp );
+
+    dirty.Clear();
 }
 
 void MainMenu::DrawMainPlayerInfo()
@@ -264,6 +421,13 @@ void MainMenu::DrawPlayerEquipableAnim( int playerId, int x, int y )
     al_draw_bitmap_region( instance->playerBmp, sx, sy, 16, 24, x, y, 0 );
 }
 
+void MainMenu::AddPlayerEquipableAnim( int x, int y, DirtyRect& dirty )
+{
+    // The frame changes every 16 frames; see DrawPlayerEquipableAnim
+    if ( (GetFrameCounter() % 16) == 0 )
+        dirty.Add( x, y, 16, 24 );
+}
+
 void MainMenu::DrawOrb( int index, bool lit, int x, int y )
 {
     int sx = 0;
@@ -353,3 +517,8 @@ void MainMenu::PlayPotion()
 {
     Sound::PushTrack( Sound_Potion, 0 );
 }
+
+void MainMenu::GetStats( MenuStats& stats )
+{
+    stats = ::stats;
+}
@@ -37,6 +37,40 @@ enum ShopType
 };
 
 
+struct MenuStats
+{
+    int FramesDrawn;
+    int FramesPartlyDrawn;
+    int FramesSkipped;
+};
+
+
+// Covers the parts of the screen that have to be drawn again
+
+class DirtyRect
+{
+    int left;
+    int top;
+    int right;
+    int bottom;
+
+public:
+    DirtyRect();
+
+    void Add( int x, int y, int width, int height );
+    void AddAll();
+    void Clear();
+
+    bool IsEmpty() const;
+    bool IsAll() const;
+
+    int GetX() const;
+    int GetY() const;
+    int GetWidth() const;
+    int GetHeight() const;
+};
+
+
 const int PlayerPicX = 24;
 const int PlayerPicY = 16;
 const int PlayerEntryHeight = 56;
@@ -49,6 +83,16 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu ) = 0;
     virtual void Draw( MenuDrawState state ) = 0;
+
+    // Adds the parts of the screen that change this frame on their own, 
+    // without any input, such as a blinking cursor. Returns false if the 
+    // menu doesn't keep track; then the whole screen is drawn every frame.
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
+
+protected:
+    bool AddPrevIdleChanges( DirtyRect& dirty );
+
+    static void AddCursorBlink( MenuDrawState state, int x, int y, DirtyRect& dirty );
 };
 
 
@@ -70,6 +114,8 @@ class MainMenu : public IModule
     Table<char, ShopStrings> shopText;
 
     Menu* activeMenu;
+    ALLEGRO_BITMAP* frameBmp;
+    DirtyRect dirty;
 
 public:
     MainMenu();
@@ -81,6 +127,7 @@ public:
 
     virtual void Update();
     virtual void Draw();
+    virtual bool NeedsDraw();
 
     virtual IPlayfield* AsPlayfield();
 
@@ -90,6 +137,7 @@ public:
     static void DrawPlayer( int playerId, int x, int y );
     static void DrawClass( int classId, int x, int y );
     static void DrawPlayerEquipableAnim( int playerId, int x, int y );
+    static void AddPlayerEquipableAnim( int x, int y, DirtyRect& dirty );
     static void DrawOrb( int index, bool lit, int x, int y );
 
     static bool ItemTargetsPlayer( int itemId );
@@ -106,8 +154,11 @@ public:
     static void PlayFanfare();
     static void PlayPotion();
 
+    static void GetStats( MenuStats& stats );
+
 private:
     void Init();
+    void DrawFrame();
 
     void Push( Menu* nextMenu );
     void Pop();
@@ -7,6 +7,7 @@
 
 #include "Common.h"
 #include "MapSprite.h"
+#include "DrawList.h"
 
 
 const int DefaultTimer = 7;
@@ -100,27 +101,39 @@ void MapSprite::Update()
 }
 
 void MapSprite::DrawAt( int screenX, int screenY )
+{
+    DrawFrameAt( bmp, dir, frame, frameOffsetY, showBottom, screenX, screenY );
+}
+
+void MapSprite::DrawFrameAt( 
+    ALLEGRO_BITMAP* bmp, 
+    Direction dir, 
+    int frame, 
+    int frameOffsetY, 
+    bool showBottom, 
+    int screenX, 
+    int screenY )
 {
     switch ( dir )
     {
     case Dir_Right:
     case Dir_Left:
-        DrawHorizontalAt( screenX, screenY );
+        DrawHorizontalAt( bmp, dir, frame, frameOffsetY, showBottom, screenX, screenY );
         break;
 
     case Dir_Down:
     case Dir_Up:
-        DrawVerticalAt( screenX, screenY );
+        DrawVerticalAt( bmp, dir, frame, frameOffsetY, showBottom, screenX, screenY );
         break;
     }
 }
 
-void MapSprite::DrawHorizontalAt( int screenX, int screenY )
+void MapSprite::DrawHorizontalAt( ALLEGRO_BITMAP* bmp, Direction dir, int frame, int frameOffsetY, bool showBottom, int screenX, int screenY )
 {
     int flags = (dir == Dir_Right) ? ALLEGRO_FLIP_HORIZONTAL : 0;
     int height = showBottom ? 16 : 8;
 
-    al_draw_bitmap_region(
+    DrawList::DrawBitmapRegion(
         bmp,
         walkLeftFrames[frame].X,
         walkLeftFrames[frame].Y + frameOffsetY,
@@ -131,12 +144,12 @@ void MapSprite::DrawHorizontalAt( int screenX, int screenY )
         flags );
 }
 
-void MapSprite::DrawVerticalAt( int screenX, int screenY )
+void MapSprite::DrawVerticalAt( ALLEGRO_BITMAP* bmp, Direction dir, int frame, int frameOffsetY, bool showBottom, int screenX, int screenY )
 {
     int srcX = (dir == Dir_Up) ? 16 : 0;
     int bottomFlags = (frame == 0) ? 0 : ALLEGRO_FLIP_HORIZONTAL;
 
-    al_draw_bitmap_region( 
+    DrawList::DrawBitmapRegion( 
         bmp, 
         srcX, 
         frameOffsetY + 0, 
@@ -148,7 +161,7 @@ void MapSprite::DrawVerticalAt( int screenX, int screenY )
 
     if ( showBottom )
     {
-        al_draw_bitmap_region( 
+        DrawList::DrawBitmapRegion( 
             bmp, 
             srcX, 
             frameOffsetY + 8, 
@@ -68,7 +68,17 @@ public:
     void Update();
     void DrawAt( int screenX, int screenY );
 
+    // Draws a walking frame of any sprite laid out like this one's bitmap.
+    static void DrawFrameAt( 
+        ALLEGRO_BITMAP* bmp, 
+        Direction dir, 
+        int frame, 
+        int frameOffsetY, 
+        bool showBottom, 
+        int screenX, 
+        int screenY );
+
 private:
-    void DrawHorizontalAt( int screenX, int screenY );
-    void DrawVerticalAt( int screenX, int screenY );
+    static void DrawHorizontalAt( ALLEGRO_BITMAP* bmp, Direction dir, int frame, int frameOffsetY, bool showBottom, int screenX, int screenY );
+    static void DrawVerticalAt( ALLEGRO_BITMAP* bmp, Direction dir, int frame, int frameOffsetY, bool showBottom, int screenX, int screenY );
 };
@@ -108,6 +108,11 @@ void StatusMenu::Draw( MenuDrawState state )
     Text::DrawString( str, StatDerivedX, Y + 152 );
 }
 
+bool StatusMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    return true;
+}
+
 
 //----------------------------------------------------------------------------
 
@@ -222,6 +227,12 @@ void EquipMenu::Draw( MenuDrawState state )
     }
 }
 
+bool EquipMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    AddCursorBlink( state, 16 + selIndex * (104-32), 8, dirty );
+    return true;
+}
+
 
 //----------------------------------------------------------------------------
 
@@ -291,6 +302,15 @@ void ChooseEquipSlotMenu::Draw( MenuDrawState state )
     }
 }
 
+bool ChooseEquipSlotMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    if ( !AddPrevIdleChanges( dirty ) )
+        return false;
+
+    AddCursorBlink( state, EquipSlotX - 16, EquipSlotY + selIndex * 16, dirty );
+    return true;
+}
+
 bool ChooseEquipSlotMenu::RemoveItem()
 {
     Player::Character& player = Player::Party[playerId];
@@ -459,6 +479,17 @@ void ChooseEquipItemMenu::Draw( MenuDrawState state )
     }
 }
 
+bool ChooseEquipItemMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    const int ItemY = EquipItemBoxY + 16;
+
+    if ( !AddPrevIdleChanges( dirty ) )
+        return false;
+
+    AddCursorBlink( state, 0, ItemY + (selRow - topRow) * 16, dirty );
+    return true;
+}
+
 void ChooseEquipItemMenu::EquipSelectedItem()
 {
     Player::Character& player = Player::Party[playerId];
@@ -495,9 +526,31 @@ void ChooseEquipItemMenu::EquipSelectedItem()
 CommandMenu* CommandMenu::instance;
 
 
+const int CmdBoxX = 176;
+const int CmdBoxY = 0;
+const int CmdBoxWidth = 80;
+const int CmdBoxHeight = 120;
+const int CmdX = CmdBoxX + 16;
+
+const int OrbBoxX = CmdBoxX;
+const int OrbBoxY = CmdBoxHeight;
+const int OrbBoxWidth = CmdBoxWidth;
+const int OrbBoxHeight = 64;
+
+const int GilBoxX = CmdBoxX;
+const int GilBoxY = OrbBoxY + OrbBoxHeight;
+
+
+static uint32_t GetTotalMinutes( uint32_t millis )
+{
+    return millis / (1000 * 60);
+}
+
+
 CommandMenu::CommandMenu()
     :   selIndex( 0 ),
-        showPics( true )
+        showPics( true ),
+        drawnMinutes( 0 )
 {
     instance = this;
 }
@@ -564,12 +617,6 @@ void CommandMenu::Draw( MenuDrawState state )
     if ( showPics )
         MainMenu::DrawMainPlayerPic();
 
-    const int CmdBoxX = 176;
-    const int CmdBoxY = 0;
-    const int CmdBoxWidth = 80;
-    const int CmdBoxHeight = 120;
-    const int CmdX = CmdBoxX + 16;
-
     Text::DrawBox( CmdBoxX, CmdBoxY, CmdBoxWidth, CmdBoxHeight );
 
     Text::DrawString( "ITEM", CmdX, CmdBoxY + 16 );
@@ -579,11 +626,6 @@ void CommandMenu::Draw( MenuDrawState state )
     Text::DrawString( "PARTY", CmdX, CmdBoxY + 80 );
     Text::DrawString( "SAVE", CmdX, CmdBoxY + 96 );
 
-    const int OrbBoxX = CmdBoxX;
-    const int OrbBoxY = CmdBoxHeight;
-    const int OrbBoxWidth = CmdBoxWidth;
-    const int OrbBoxHeight = 64;
-
     Text::DrawBox( OrbBoxX, OrbBoxY, OrbBoxWidth, OrbBoxHeight );
 
     MainMenu::DrawOrb( 0, Player::Items[Item_OrbFire] > 0, OrbBoxX + 16, OrbBoxY + 16 );
@@ -591,16 +633,16 @@ void CommandMenu::Draw( MenuDrawState state )
     MainMenu::DrawOrb( 2, Player::Items[Item_OrbAir] > 0, OrbBoxX + 16, OrbBoxY + 32 );
     MainMenu::DrawOrb( 3, Player::Items[Item_OrbEarth] > 0, OrbBoxX + 32, OrbBoxY + 32 );
 
-    const int GilBoxX = CmdBoxX;
-    const int GilBoxY = OrbBoxY + OrbBoxHeight;
-
     Text::DrawBox( CmdBoxX, GilBoxY, OrbBoxWidth, 56 );
 
     char str[32];
 
     uint32_t hours = 0;
     uint32_t minutes = 0;
-    Global::GetHoursMinutes( Global::GetTime(), hours, minutes );
+    uint32_t time = Global::GetTime();
+    Global::GetHoursMinutes( time, hours, minutes );
+
+    drawnMinutes = GetTotalMinutes( time );
 
     sprintf_s( str, "%02u:%02u", hours, minutes );
     Text::DrawString( str, GilBoxX + 16, GilBoxY + 16 );
@@ -616,6 +658,18 @@ void CommandMenu::Draw( MenuDrawState state )
     }
 }
 
+bool CommandMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    if ( !AddPrevIdleChanges( dirty ) )
+        return false;
+
+    if ( GetTotalMinutes( Global::GetTime() ) != drawnMinutes )
+        dirty.Add( GilBoxX + 16, GilBoxY + 16, 5 * 8, 8 );
+
+    AddCursorBlink( state, CmdX - 16, CmdBoxY + 16 + selIndex * 16, dirty );
+    return true;
+}
+
 void CommandMenu::ShowPics( bool visible )
 {
     if ( instance != nullptr )
@@ -691,6 +745,22 @@ void ChoosePartyMenu::Draw( MenuDrawState state )
     Text::DrawCursor( PlayerPicX - 16, y );
 }
 
+bool ChoosePartyMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    if ( !AddPrevIdleChanges( dirty ) )
+        return false;
+
+    // The first choice blinks whether or not this menu is active
+    if ( step == 1 )
+    {
+        int y = PlayerPicY + firstSelIndex * PlayerEntryHeight;
+
+        AddCursorBlink( MenuDraw_Paused, PlayerPicX - 16 + 4, y - 4, dirty );
+    }
+
+    return true;
+}
+
 
 //----------------------------------------------------------------------------
 
@@ -830,3 +900,12 @@ void ChooseCommandTargetMenu::Draw( MenuDrawState state )
         Text::DrawCursor( PlayerPicX - 16, y );
     }
 }
+
+bool ChooseCommandTargetMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    if ( !AddPrevIdleChanges( dirty ) )
+        return false;
+
+    AddCursorBlink( state, PlayerPicX - 16, PlayerPicY + selIndex * PlayerEntryHeight, dirty );
+    return true;
+}
@@ -87,6 +87,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 };
 
 
@@ -103,6 +104,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 };
 
 
@@ -124,6 +126,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 
 private:
     bool RemoveItem();
@@ -149,6 +152,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 
     int GetListLength();
 
@@ -245,12 +249,14 @@ class CommandMenu : public Menu
 
     int selIndex;
     bool showPics;
+    uint32_t drawnMinutes;
 
 public:
     CommandMenu();
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 
     static void ShowPics( bool visible );
 };
@@ -267,6 +273,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 };
 
 
@@ -297,4 +304,5 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 };
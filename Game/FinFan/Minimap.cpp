@@ -0,0 +1,416 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Common.h"
+#include "Minimap.h"
+#include "DrawList.h"
+
+#if defined( _M_IX86 ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define MINIMAP_SSE2 1
+#endif
+
+
+const int TileSize = 16;
+const int TilesPerRow = 16;
+
+
+// Sums the channels of the 16x16 ARGB pixels at the start of each row, and
+// returns their averages as a pixel.
+
+static uint32_t AveragePixels( const uint8_t* data, int pitch )
+{
+#if MINIMAP_SSE2
+    // Each 16-bit lane adds up one channel of half of the pixels: 128 
+    // values of 255 at most, so they can't overflow.
+
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+
+    for ( int y = 0; y < TileSize; y++ )
+    {
+        const __m128i* row = (const __m128i*) (data + y * pitch);
+
+        for ( int i = 0; i < TileSize / 4; i++ )
+        {
+            __m128i quad = _mm_loadu_si128( row + i );
+
+            sum = _mm_add_epi16( sum, _mm_unpacklo_epi8( quad, zero ) );
+            sum = _mm_add_epi16( sum, _mm_unpackhi_epi8( quad, zero ) );
+        }
+    }
+
+    // Fold the two pixels in the lanes into one, widening to 32 bits
+
+    __m128i wide = _mm_add_epi32( _mm_unpacklo_epi16( sum, zero ), _mm_unpackhi_epi16( sum, zero ) );
+    uint32_t channels[4];
+
+    _mm_storeu_si128( (__m128i*) channels, wide );
+
+    const int PixelCount = TileSize * TileSize;
+
+    return ((channels[3] / PixelCount) << 24)
+        | ((channels[2] / PixelCount) << 16)
+        | ((channels[1] / PixelCount) << 8)
+        | (channels[0] / PixelCount);
+#else
+    uint32_t channels[4] = { 0 };
+
+    for ( int y = 0; y < TileSize; y++ )
+    {
+        const uint8_t* row = data + y * pitch;
+
+        for ( int x = 0; x < TileSize * 4; x++ )
+            channels[x % 4] += row[x];
+    }
+
+    const int PixelCount = TileSize * TileSize;
+
+    return ((channels[3] / PixelCount) << 24)
+        | ((channels[2] / PixelCount) << 16)
+        | ((channels[1] / PixelCount) << 8)
+        | (channels[0] / PixelCount);
+#endif
+}
+
+// Averages two rows of pixels, and then every pair of pixels across. The
+// output can be the top row, since each pixel is read before it's written.
+
+static void ShrinkRow( const uint32_t* top, const uint32_t* bottom, uint32_t* out, int outWidth )
+{
+    int x = 0;
+
+#if MINIMAP_SSE2
+    for ( ; x + 4 <= outWidth; x += 4 )
+    {
+        __m128i a = _mm_avg_epu8(
+            _mm_loadu_si128( (const __m128i*) (top + x * 2) ),
+            _mm_loadu_si128( (const __m128i*) (bottom + x * 2) ) );
+        __m128i b = _mm_avg_epu8(
+            _mm_loadu_si128( (const __m128i*) (top + x * 2 + 4) ),
+            _mm_loadu_si128( (const __m128i*) (bottom + x * 2 + 4) ) );
+
+        // Split into the even and the odd pixels
+
+        __m128 evens = _mm_shuffle_ps( _mm_castsi128_ps( a ), _mm_castsi128_ps( b ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+        __m128 odds = _mm_shuffle_ps( _mm_castsi128_ps( a ), _mm_castsi128_ps( b ), _MM_SHUFFLE( 3, 1, 3, 1 ) );
+
+        __m128i avg = _mm_avg_epu8( _mm_castps_si128( evens ), _mm_castps_si128( odds ) );
+
+        _mm_storeu_si128( (__m128i*) (out + x), avg );
+    }
+#endif
+
+    for ( ; x < outWidth; x++ )
+    {
+        uint32_t color = 0;
+
+        for ( int shift = 0; shift < 32; shift += 8 )
+        {
+            uint32_t t0 = (top[x * 2] >> shift) & 0xFF;
+            uint32_t t1 = (top[x * 2 + 1] >> shift) & 0xFF;
+            uint32_t b0 = (bottom[x * 2] >> shift) & 0xFF;
+            uint32_t b1 = (bottom[x * 2 + 1] >> shift) & 0xFF;
+
+            // Round the same way as the vector code
+            uint32_t left = (t0 + b0 + 1) / 2;
+            uint32_t right = (t1 + b1 + 1) / 2;
+
+            color |= ((left + right + 1) / 2) << shift;
+        }
+
+        out[x] = color;
+    }
+}
+
+
+Minimap::Minimap()
+    :   bmp( nullptr ),
+        colorTileCount( 0 ),
+        width( 0 ),
+        height( 0 ),
+        scale( 1 ),
+        blockCols( 0 ),
+        blockRows( 0 ),
+        nextMissingBlock( 0 ),
+        pixels( nullptr ),
+        blocksSet( nullptr ),
+        dirtyTop( 0 ),
+        dirtyBottom( 0 )
+{
+    memset( tileColors, 0, sizeof tileColors );
+}
+
+Minimap::~Minimap()
+{
+    al_destroy_bitmap( bmp );
+
+    delete [] pixels;
+    delete [] blocksSet;
+}
+
+bool Minimap::Init( ALLEGRO_BITMAP* tiles, int tileTypes, int mapCols, int mapRows )
+{
+    if ( tileTypes > MaxTileTypes )
+        tileTypes = MaxTileTypes;
+
+    if ( mapCols <= 0 || mapCols % BlockSize != 0 
+        || mapRows <= 0 || mapRows % BlockSize != 0 )
+        return false;
+
+    ALLEGRO_LOCKED_REGION* region = al_lock_bitmap( tiles, ALLEGRO_PIXEL_FORMAT_ARGB_8888, ALLEGRO_LOCK_READONLY );
+    if ( region == nullptr )
+        return false;
+
+    for ( int i = 0; i < tileTypes; i++ )
+    {
+        int x = (i % TilesPerRow) * TileSize;
+        int y = (i / TilesPerRow) * TileSize;
+        const uint8_t* data = (const uint8_t*) region->data + y * region->pitch + x * 4;
+
+        tileColors[i] = AveragePixels( data, region->pitch );
+    }
+
+    al_unlock_bitmap( tiles );
+
+    // A bigger map than BlockSize * MaxSize makes a bigger picture, 
+    // because each block has to make at least one pixel.
+
+    scale = 1;
+
+    while ( scale < BlockSize && (mapCols / scale > MaxSize || mapRows / scale > MaxSize) )
+        scale *= 2;
+
+    width = mapCols / scale;
+    height = mapRows / scale;
+    blockCols = mapCols / BlockSize;
+    blockRows = mapRows / BlockSize;
+
+    pixels = new uint32_t[width * height];
+    blocksSet = new bool[blockCols * blockRows];
+
+    memset( pixels, 0, width * height * sizeof pixels[0] );
+    memset( blocksSet, 0, blockCols * blockRows * sizeof blocksSet[0] );
+
+    bmp = al_create_bitmap( width, height );
+    if ( bmp == nullptr )
+        return false;
+
+    MarkDirty( 0 );
+    MarkDirty( height - 1 );
+
+    return true;
+}
+
+int Minimap::GetWidth()
+{
+    return width;
+}
+
+int Minimap::GetHeight()
+{
+    return height;
+}
+
+int Minimap::GetScale()
+{
+    return scale;
+}
+
+uint32_t Minimap::GetAverageColor( ALLEGRO_BITMAP* bitmap, int x, int y )
+{
+    ALLEGRO_LOCKED_REGION* region = al_lock_bitmap_region(
+        bitmap,
+        x,
+        y,
+        TileSize,
+        TileSize,
+        ALLEGRO_PIXEL_FORMAT_ARGB_8888,
+        ALLEGRO_LOCK_READONLY );
+    if ( region == nullptr )
+        return 0;
+
+    uint32_t color = AveragePixels( (const uint8_t*) region->data, region->pitch );
+
+    al_unlock_bitmap( bitmap );
+
+    return color;
+}
+
+void Minimap::SetBlock( int blockCol, int blockRow, const uint8_t* tileRefs )
+{
+    if ( pixels == nullptr 
+        || blockCol < 0 || blockCol >= blockCols 
+        || blockRow < 0 || blockRow >= blockRows )
+        return;
+
+    uint32_t tilePixels[BlockSize * BlockSize];
+    int left = blockCol * BlockSize;
+    int top = blockRow * BlockSize;
+
+    for ( int i = 0; i < BlockSize * BlockSize; i++ )
+        tilePixels[i] = tileColors[tileRefs[i] % MaxTileTypes];
+
+    for ( int i = 0; i < colorTileCount; i++ )
+    {
+        int col = colorTiles[i].Col - left;
+        int row = colorTiles[i].Row - top;
+
+        if ( col >= 0 && col < BlockSize && row >= 0 && row < BlockSize )
+            tilePixels[row * BlockSize + col] = colorTiles[i].Color;
+    }
+
+    // Halve the block in place until it's at the scale of the picture
+
+    int size = BlockSize;
+
+    for ( int s = 1; s < scale; s *= 2 )
+    {
+        int outSize = size / 2;
+
+        for ( int y = 0; y < outSize; y++ )
+        {
+            ShrinkRow( 
+                &tilePixels[y * 2 * size], 
+                &tilePixels[(y * 2 + 1) * size], 
+                &tilePixels[y * outSize], 
+                outSize );
+        }
+
+        size = outSize;
+    }
+
+    int x = left / scale;
+    int y = top / scale;
+
+    for ( int i = 0; i < size; i++ )
+        memcpy( &pixels[(y + i) * width + x], &tilePixels[i * size], size * sizeof pixels[0] );
+
+    MarkDirty( y );
+    MarkDirty( y + size - 1 );
+
+    blocksSet[blockRow * blockCols + blockCol] = true;
+}
+
+bool Minimap::FindMissingBlock( int& blockCol, int& blockRow )
+{
+    int blockCount = blockCols * blockRows;
+
+    // Blocks are only ever set, so the search can go on from the last one
+
+    for ( ; nextMissingBlock < blockCount; nextMissingBlock++ )
+    {
+        if ( !blocksSet[nextMissingBlock] )
+        {
+            blockCol = nextMissingBlock % blockCols;
+            blockRow = nextMissingBlock / blockCols;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Minimap::IsBlockSet( int blockCol, int blockRow )
+{
+    if ( blockCol < 0 || blockCol >= blockCols || blockRow < 0 || blockRow >= blockRows )
+        return false;
+
+    return blocksSet[blockRow * blockCols + blockCol];
+}
+
+void Minimap::SetTileColor( int col, int row, uint32_t color )
+{
+    int i = 0;
+
+    for ( ; i < colorTileCount; i++ )
+    {
+        if ( colorTiles[i].Col == col && colorTiles[i].Row == row )
+            break;
+    }
+
+    if ( i == colorTileCount )
+    {
+        if ( colorTileCount == MaxTileColors )
+            return;
+
+        colorTileCount++;
+    }
+
+    colorTiles[i].Col = col;
+    colorTiles[i].Row = row;
+    colorTiles[i].Color = color;
+}
+
+void Minimap::ClearTileColor( int col, int row )
+{
+    for ( int i = 0; i < colorTileCount; i++ )
+    {
+        if ( colorTiles[i].Col == col && colorTiles[i].Row == row )
+        {
+            colorTiles[i] = colorTiles[--colorTileCount];
+            return;
+        }
+    }
+}
+
+void Minimap::MarkDirty( int y )
+{
+    if ( dirtyTop >= dirtyBottom )
+    {
+        dirtyTop = y;
+        dirtyBottom = y + 1;
+    }
+    else if ( y < dirtyTop )
+    {
+        dirtyTop = y;
+    }
+    else if ( y >= dirtyBottom )
+    {
+        dirtyBottom = y + 1;
+    }
+}
+
+void Minimap::Upload()
+{
+    if ( bmp == nullptr || dirtyTop >= dirtyBottom )
+        return;
+
+    // whole rows are written, so the lock doesn't have to read anything back
+    ALLEGRO_LOCKED_REGION* region = al_lock_bitmap_region(
+        bmp,
+        0,
+        dirtyTop,
+        width,
+        dirtyBottom - dirtyTop,
+        ALLEGRO_PIXEL_FORMAT_ARGB_8888,
+        ALLEGRO_LOCK_WRITEONLY );
+    if ( region == nullptr )
+        return;
+
+    for ( int y = dirtyTop; y < dirtyBottom; y++ )
+    {
+        uint8_t* dst = (uint8_t*) region->data + (y - dirtyTop) * region->pitch;
+
+        memcpy( dst, &pixels[y * width], width * sizeof pixels[0] );
+    }
+
+    al_unlock_bitmap( bmp );
+
+    dirtyTop = 0;
+    dirtyBottom = 0;
+}
+
+void Minimap::Draw( int x, int y )
+{
+    if ( bmp == nullptr )
+        return;
+
+    Upload();
+
+    DrawList::DrawBitmapRegion( bmp, 0, 0, width, height, x, y, 0 );
+}
@@ -0,0 +1,85 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+
+// A small picture of the whole overworld. Each tile is given the average
+// color of its graphic, and each square of Scale x Scale tiles makes one
+// pixel. The scale is the smallest power of two that keeps the picture 
+// within MaxSize, up to BlockSize.
+//
+// The map is given a block of BlockSize x BlockSize tiles at a time, as 
+// its chunks are read, so the whole map never has to be in memory. The 
+// picture is built on the CPU. Only the rows of the picture that change 
+// are uploaded again, and only the next time the picture is drawn.
+
+class Minimap
+{
+public:
+    static const int BlockSize = 32;
+    static const int MaxSize = 128;
+    static const int MaxTileTypes = 128;
+    static const int MaxTileColors = 4;
+
+    Minimap();
+    ~Minimap();
+
+    // The tile graphics are laid out as a grid of 16 tiles in each row,
+    // like the map's tiles. The size of the map is a multiple of 
+    // BlockSize.
+    bool Init( ALLEGRO_BITMAP* tiles, int tileTypes, int mapCols, int mapRows );
+
+    int GetWidth();
+    int GetHeight();
+    int GetScale();
+
+    // Sets the tile refs of a block of the map, row by row
+    void SetBlock( int blockCol, int blockRow, const uint8_t* tileRefs );
+
+    // Finds a block that hasn't been set yet, so that the picture can be 
+    // filled in a little at a time.
+    bool FindMissingBlock( int& blockCol, int& blockRow );
+    bool IsBlockSet( int blockCol, int blockRow );
+
+    // Shows a color in place of a tile, like the bridge that's drawn over
+    // the water. Clearing it shows the tile again. Either one takes effect
+    // when the tile's block is set again.
+    void SetTileColor( int col, int row, uint32_t color );
+    void ClearTileColor( int col, int row );
+
+    void Draw( int x, int y );
+
+    // The average color of one 16x16 graphic in a bitmap
+    static uint32_t GetAverageColor( ALLEGRO_BITMAP* bitmap, int x, int y );
+
+private:
+    struct TileColor
+    {
+        int Col;
+        int Row;
+        uint32_t Color;
+    };
+
+    ALLEGRO_BITMAP* bmp;
+    uint32_t tileColors[MaxTileTypes];
+    TileColor colorTiles[MaxTileColors];
+    int colorTileCount;
+    int width;
+    int height;
+    int scale;
+    int blockCols;
+    int blockRows;
+    int nextMissingBlock;
+    uint32_t* pixels;
+    bool* blocksSet;
+    int dirtyTop;
+    int dirtyBottom;
+
+    void MarkDirty( int y );
+    void Upload();
+};
@@ -28,5 +28,9 @@ public:
     virtual void Update() = 0;
     virtual void Draw() = 0;
 
+    // Returns false if the screen would look the same as the last frame
+    // drawn, so that drawing and presenting it can be skipped.
+    virtual bool NeedsDraw();
+
     virtual IPlayfield* AsPlayfield() = 0;
 };
@@ -7,8 +7,12 @@
 
 #include "Common.h"
 #include "Overworld.h"
+#include "Atlas.h"
+#include "DrawList.h"
+#include "Encounters.h"
 #include "MapSprite.h"
 #include "OWTile.h"
+#include "PathFinder.h"
 #include "Player.h"
 #include "VehicleSprites.h"
 #include "SceneStack.h"
@@ -30,15 +34,34 @@ const int IsmusRow = 164;
 const int BridgeCol = 152;
 const int BridgeRow = 152;
 
+// Battle domains of the water, after the 64 domains of land
+const int NorthRiverDomain = 0x40;
+const int SouthRiverDomain = 0x41;
+const int SeaDomain = 0x42;
+
+const int LandBattleRate = 10;
+const int SeaBattleRate = 3;
+
+const int MinimapChunksPerFrame = 4;
+
 
 Overworld::Overworld()
-    :   tiles( nullptr ),
+    :   rowCount( 0 ),
+        colCount( 0 ),
+        tiles( nullptr ),
         offsetX( 0 ),
         offsetY( 0 ),
-        uncompStartRow( 0 ),
         topRow( 0 ),
         leftCol( 0 ),
+        bridgeColor( 0 ),
+        ismusColor( 0 ),
+        minimapBridge( false ),
+        minimapCanal( false ),
+        showMinimap( false ),
         playerImage( nullptr ),
+        walkPending( false ),
+        walkGoalCol( 0 ),
+        walkGoalRow( 0 ),
         movingDir( Dir_None ),
         curUpdate( &Overworld::UpdateFootIdle ),
         shopPending( false ),
@@ -46,6 +69,10 @@ Overworld::Overworld()
         poisonMove( false )
 {
     instance = this;
+
+    memset( pathFinders, 0, sizeof pathFinders );
+    memset( routeLeftCols, 0, sizeof routeLeftCols );
+    memset( routeTopRows, 0, sizeof routeTopRows );
 }
 
 Overworld::~Overworld()
@@ -66,6 +93,12 @@ Overworld::~Overworld()
 
     delete airshipSprite;
     airshipSprite = nullptr;
+
+    for ( int i = 0; i < _countof( pathFinders ); i++ )
+    {
+        delete pathFinders[i];
+        pathFinders[i] = nullptr;
+    }
 }
 
 IPlayfield* Overworld::AsPlayfield()
@@ -103,14 +136,14 @@ void Overworld::HandleOpeningEnded()
 
 void Overworld::Init( int startCol, int startRow )
 {
-    if ( !LoadResource( "owMap.tab", &compressedRows ) )
+    if ( !OpenMap() )
         return;
 
-    tiles = al_load_bitmap( "owTiles.png" );
+    tiles = Atlas::Load( "owTiles.png" );
     if ( tiles == nullptr )
         return;
 
-    playerImage = al_load_bitmap( "mapPlayer.png" );
+    playerImage = Atlas::Load( "mapPlayer.png" );
     if ( playerImage == nullptr )
         return;
 
@@ -123,6 +156,12 @@ void Overworld::Init( int startCol, int startRow )
     if ( !LoadList( "enterTeleports.dat", enterTeleports, EnterTeleports ) )
         return;
 
+    MakeMinimap();
+
+    chunkMap.SetLoadHandler( 
+        [this]( int slot, int chunkCol, int chunkRow, const uint8_t* tileRefs )
+        { MakeChunkInfo( slot, chunkCol, chunkRow, tileRefs ); } );
+
     LoadMap( startCol, startRow );
 
     playerSprite = new MapSprite( playerImage );
@@ -137,10 +176,7 @@ void Overworld::Init( int startCol, int startRow )
 
     airshipSprite = new AirshipSprite( playerImage );
 
-    uint8_t ref = GetTileRef( startCol, startRow );
-    uint16_t attrs = tileAttr[ref];
-
-    if ( OWTile::CanCanoe( attrs ) )
+    if ( GetPass( Pass_Canoe, startCol, startRow ) )
     {
         Player::SetActiveVehicle( Vehicle_Canoe );
 
@@ -161,30 +197,68 @@ void Overworld::Init( int startCol, int startRow )
     SceneStack::BeginFade( 15, Color::Black(), Color::Transparent(), [] {} );
 }
 
-void Overworld::LoadMap( int middleCol, int middleRow )
+// The size of the map comes from the chunk file. The old row table is
+// always 256x256.
+
+bool Overworld::OpenMap()
 {
-    topRow = (middleRow - MiddleRow + RowCount) % RowCount;
-    leftCol = (middleCol - MiddleCol + ColCount) % ColCount;
+    if ( !chunkMap.Open( "owMap.chk" ) )
+    {
+        if ( !LoadResource( "owMap.tab", &compressedRows ) )
+            return false;
 
-    uncompStartRow = topRow % VisibleRows;
+        // Only the part of each row that's in the chunk is kept
+        auto readRows = [this]( int chunkCol, int chunkRow, uint8_t* tileRefs )
+        {
+            uint8_t rowRefs[TabCols];
 
-    for ( int i = 0; i < VisibleRows; i++ )
-    {
-        int bufRow = (uncompStartRow + i) % VisibleRows;
-        int mapRow = (topRow + i) % RowCount;
-        DecompressMap( compressedRows.GetItem( mapRow ), tileRefs[bufRow] );
+            for ( int y = 0; y < ChunkSize; y++ )
+            {
+                DecompressMap( compressedRows.GetItem( chunkRow * ChunkSize + y ), rowRefs );
+                memcpy( &tileRefs[y * ChunkSize], &rowRefs[chunkCol * ChunkSize], ChunkSize );
+            }
+
+            return true;
+        };
+
+        if ( !chunkMap.Open( TabCols, TabRows, readRows ) )
+            return false;
     }
+
+    colCount = chunkMap.GetCols();
+    rowCount = chunkMap.GetRows();
+
+    return true;
+}
+
+void Overworld::LoadMap( int middleCol, int middleRow )
+{
+    topRow = WrapRow( middleRow - MiddleRow );
+    leftCol = WrapCol( middleCol - MiddleCol );
+
+    chunkMap.StreamAround( middleCol, middleRow, ChunkSize, ChunkSize );
 }
 
 void Overworld::Update()
 {
     if ( SceneStack::IsFading() )
+    {
+        walkPending = false;
+        walker.Stop();
         return;
+    }
+
+    if ( Input::IsKeyPressing( MapKey ) )
+        showMinimap = !showMinimap;
+
+    UpdateWalk();
 
     (this->*curUpdate)();
 
     vehicleSprite->Update();
 
+    UpdateMinimap();
+
     if (  (Player::GetVehicles() & Vehicle_Airship) != 0 
         && Player::GetAirshipVisibility() < 0x1F )
     {
@@ -202,11 +276,16 @@ void Overworld::UpdateLift()
     }
 }
 
-bool Overworld::CanWalk( uint16_t attrs )
+bool Overworld::CanWalk( int col, int row )
 {
-    if ( !OWTile::CanWalk( attrs ) )
+    if ( !GetPass( Pass_Walk, col, row ) )
         return false;
 
+    if ( !GetPass( Pass_Special, col, row ) )
+        return true;
+
+    uint16_t attrs = tileAttr[GetTileRef( col, row )];
+
     if ( OWTile::GetSpecial( attrs ) == OWTile::S_Chime
         && Player::Items[Item_Chime] == 0 )
         return false;
@@ -248,16 +327,220 @@ static bool CanShipSpecial( int col, int row )
     return false;
 }
 
+// Vehicle positions are still kept as bytes, so this only matches the 
+// right tile on a map of 256 tiles or less.
+static bool IsAt( Point pos, int col, int row )
+{
+    return pos.X == col && pos.Y == row;
+}
+
+int Overworld::GetFightDomain( uint16_t attrs, int col, int row )
+{
+    if ( !OWTile::CanFight( attrs ) )
+        return NoDomain;
+
+    if ( (col == BridgeCol && row == BridgeRow)
+        || (col == IsmusCol && row == IsmusRow) )
+        return NoDomain;
+
+    int generalDomain = OWTile::GetFightDomain( attrs );
+
+    if ( generalDomain == OWTile::Sea )
+        return SeaDomain;
+
+    if ( generalDomain == OWTile::River )
+    {
+        if ( row < rowCount / 2 )
+            return NorthRiverDomain;
+        else
+            return SouthRiverDomain;
+    }
+
+    // Land is split into 8x8 areas
+    int domainCol = col * 8 / colCount;
+    int domainRow = row * 8 / rowCount;
+
+    return domainCol | (domainRow << 3);
+}
+
+int Overworld::GetDomainBattleRate( int domain )
+{
+    if ( domain == NoDomain )
+        return 0;
+
+    return (domain == SeaDomain) ? SeaBattleRate : LandBattleRate;
+}
+
+// Called for each chunk as it's read
+
+void Overworld::MakeChunkInfo( int slot, int chunkCol, int chunkRow, const uint8_t* tileRefs )
+{
+    memset( passBits[slot], 0, sizeof passBits[slot] );
+
+    for ( int y = 0; y < ChunkSize; y++ )
+    {
+        int row = chunkRow * ChunkSize + y;
+
+        for ( int x = 0; x < ChunkSize; x++ )
+        {
+            int col = chunkCol * ChunkSize + x;
+            uint16_t attrs = tileAttr[tileRefs[y * ChunkSize + x]];
+            uint32_t modes = 0;
+
+            if ( OWTile::CanWalk( attrs ) )
+                modes |= 1 << Pass_Walk;
+            if ( OWTile::GetSpecial( attrs ) != 0 )
+                modes |= 1 << Pass_Special;
+            if ( OWTile::CanCanoe( attrs ) )
+                modes |= 1 << Pass_Canoe;
+            if ( OWTile::CanShip( attrs ) )
+                modes |= 1 << Pass_Ship;
+            if ( OWTile::CanAirship( attrs ) )
+                modes |= 1 << Pass_Airship;
+            if ( OWTile::IsDock( attrs ) )
+                modes |= 1 << Pass_Dock;
+
+            // Routes follow the same rules as moving, with what's known now
+
+            bool walk = (OWTile::CanWalk( attrs ) 
+                && (OWTile::GetSpecial( attrs ) != OWTile::S_Chime || Player::Items[Item_Chime] != 0))
+                || CanWalkSpecial( col, row );
+
+            if ( walk )
+                modes |= 1 << Pass_RouteFoot;
+            if ( walk || OWTile::CanCanoe( attrs ) )
+                modes |= 1 << Pass_RouteCanoe;
+            if ( OWTile::CanShip( attrs ) && CanShipSpecial( col, row ) )
+                modes |= 1 << Pass_RouteShip;
+
+            for ( int mode = 0; mode < Pass_Max; mode++ )
+            {
+                if ( (modes & (1 << mode)) != 0 )
+                    passBits[slot][mode][y] |= 1U << x;
+            }
+
+            fightDomains[slot][y * ChunkSize + x] = GetFightDomain( attrs, col, row );
+        }
+    }
+
+    // The minimap's blocks are the size of chunks
+    if ( !minimap.IsBlockSet( chunkCol, chunkRow ) )
+        minimap.SetBlock( chunkCol, chunkRow, tileRefs );
+}
+
+bool Overworld::GetPass( int mode, int col, int row )
+{
+    int slot = chunkMap.GetSlot( col, row );
+    if ( slot < 0 )
+        return false;
+
+    col = WrapCol( col );
+    row = WrapRow( row );
+
+    return (passBits[slot][mode][row % ChunkSize] & (1U << (col % ChunkSize))) != 0;
+}
+
+int Overworld::GetFightDomain( int col, int row )
+{
+    int slot = chunkMap.GetSlot( col, row );
+    if ( slot < 0 )
+        return NoDomain;
+
+    col = WrapCol( col );
+    row = WrapRow( row );
+
+    return fightDomains[slot][(row % ChunkSize) * ChunkSize + col % ChunkSize];
+}
+
+void Overworld::MakeMinimap()
+{
+    if ( !minimap.Init( tiles, TileTypes, colCount, rowCount ) )
+        return;
+
+    bridgeColor = Minimap::GetAverageColor( playerImage, 1 * 16, 12 * 16 );
+    ismusColor = Minimap::GetAverageColor( playerImage, 2 * 16, 12 * 16 );
+
+    minimapBridge = false;
+    minimapCanal = false;
+    UpdateMinimap();
+}
+
+void Overworld::UpdateMinimap()
+{
+    // Only the pixels under the bridge and canal change, and only when 
+    // the story changes them
+
+    if ( Player::IsBridgeVisible() != minimapBridge )
+    {
+        minimapBridge = Player::IsBridgeVisible();
+
+        if ( minimapBridge )
+            minimap.SetTileColor( BridgeCol, BridgeRow, bridgeColor );
+        else
+            minimap.ClearTileColor( BridgeCol, BridgeRow );
+
+        SetMinimapChunk( BridgeCol, BridgeRow );
+    }
+
+    if ( Player::IsCanalBlocked() != minimapCanal )
+    {
+        minimapCanal = Player::IsCanalBlocked();
+
+        if ( minimapCanal )
+            minimap.SetTileColor( IsmusCol, IsmusRow, ismusColor );
+        else
+            minimap.ClearTileColor( IsmusCol, IsmusRow );
+
+        SetMinimapChunk( IsmusCol, IsmusRow );
+    }
+
+    // Fill in the rest of the picture a few chunks at a time, without
+    // keeping them
+
+    for ( int i = 0; i < MinimapChunksPerFrame; i++ )
+    {
+        int chunkCol;
+        int chunkRow;
+        uint8_t tileRefs[ChunkMap::ChunkCells];
+
+        if ( !minimap.FindMissingBlock( chunkCol, chunkRow ) )
+            break;
+
+        // A chunk that can't be read is shown blank, so it isn't tried again
+        if ( !chunkMap.CopyChunk( chunkCol, chunkRow, tileRefs ) )
+            memset( tileRefs, 0, sizeof tileRefs );
+
+        minimap.SetBlock( chunkCol, chunkRow, tileRefs );
+    }
+}
+
+// Sets the chunk with a tile again, if it's been set, to show a new color 
+// for the tile. Otherwise, the color is shown when the chunk is set.
+
+void Overworld::SetMinimapChunk( int col, int row )
+{
+    int chunkCol = WrapCol( col ) / ChunkSize;
+    int chunkRow = WrapRow( row ) / ChunkSize;
+    uint8_t tileRefs[ChunkMap::ChunkCells];
+
+    if ( minimap.IsBlockSet( chunkCol, chunkRow )
+        && chunkMap.CopyChunk( chunkCol, chunkRow, tileRefs ) )
+        minimap.SetBlock( chunkCol, chunkRow, tileRefs );
+}
+
 void Overworld::UpdateFootIdle()
 {
     if ( Input::IsKeyPressing( MenuKey ) )
     {
+        walker.Stop();
         SceneStack::ShowMenu();
         return;
     }
 
     if ( Input::IsKeyDown( ConfirmKey ) )
     {
+        walker.Stop();
+
         if ( (Player::GetVehicles() & Vehicle_Airship) != 0 
             && GetPlayerRowCol() == Player::GetAirshipRowCol() )
         {
@@ -277,26 +560,31 @@ void Overworld::UpdateFootIdle()
         return;
     }
 
-    Direction dir = Input::GetInputDirection();
+    Direction dir = GetStepDirection();
 
     if ( dir != Dir_None )
     {
-        Point facingPos = GetFacingRowCol( dir );
-        uint8_t ref = GetTileRef( facingPos.X, facingPos.Y );
+        int facingCol;
+        int facingRow;
+        GetFacingTile( dir, facingCol, facingRow );
+
+        uint8_t ref = GetTileRef( facingCol, facingRow );
         uint16_t attrs = tileAttr[ref];
         bool allowMove = false;
 
-        if ( CanWalk( attrs ) || CanWalkSpecial( facingPos.X, facingPos.Y ) )
+        if ( CanWalk( facingCol, facingRow ) || CanWalkSpecial( facingCol, facingRow ) )
             allowMove = true;
-        else if ( OWTile::CanCanoe( attrs ) && (Player::GetVehicles() & Vehicle_Canoe) != 0 )
+        else if ( GetPass( Pass_Canoe, facingCol, facingRow ) 
+            && (Player::GetVehicles() & Vehicle_Canoe) != 0 )
             allowMove = true;
-        else if ( OWTile::CanShip( attrs ) && (Player::GetVehicles() & Vehicle_Ship) != 0 )
+        else if ( GetPass( Pass_Ship, facingCol, facingRow ) 
+            && (Player::GetVehicles() & Vehicle_Ship) != 0 )
         {
-            Point curRowCol = GetPlayerRowCol();
-            uint8_t hereRef = GetTileRef( curRowCol.X, curRowCol.Y );
-            uint16_t hereAttrs = tileAttr[hereRef];
+            int curCol;
+            int curRow;
+            GetPlayerTile( curCol, curRow );
 
-            if ( OWTile::IsDock( hereAttrs ) && facingPos == Player::GetShipRowCol() )
+            if ( GetPass( Pass_Dock, curCol, curRow ) && IsAt( Player::GetShipRowCol(), facingCol, facingRow ) )
                 allowMove = true;
         }
 
@@ -314,6 +602,10 @@ void Overworld::UpdateFootIdle()
             if ( Player::DealPoisonDamage() )
                 poisonMove = true;
         }
+        else
+        {
+            walker.Stop();
+        }
     }
 }
 
@@ -321,19 +613,24 @@ void Overworld::UpdateCanoeIdle()
 {
     if ( Input::IsKeyPressing( MenuKey ) )
     {
+        walker.Stop();
         SceneStack::ShowMenu();
         return;
     }
 
-    Direction dir = Input::GetInputDirection();
+    Direction dir = GetStepDirection();
 
     if ( dir != Dir_None )
     {
+        int facingCol;
+        int facingRow;
+        GetFacingTile( dir, facingCol, facingRow );
+
         uint8_t ref = GetFacingTileRef( dir );
         uint16_t attrs = tileAttr[ref];
         bool allowMove = false;
 
-        if ( OWTile::CanWalk( attrs ) )
+        if ( GetPass( Pass_Walk, facingCol, facingRow ) )
         {
             allowMove = true;
 
@@ -344,10 +641,11 @@ void Overworld::UpdateCanoeIdle()
             playerSprite->SetY( canoeSprite->GetY() );
             vehicleSprite = playerSprite;
         }
-        else if ( OWTile::CanCanoe( attrs ) )
+        else if ( GetPass( Pass_Canoe, facingCol, facingRow ) )
             allowMove = true;
-        else if ( OWTile::CanShip( attrs ) && (Player::GetVehicles() & Vehicle_Ship) != 0
-            && Player::GetShipRowCol() == GetFacingRowCol( dir ) )
+        else if ( GetPass( Pass_Ship, facingCol, facingRow ) 
+            && (Player::GetVehicles() & Vehicle_Ship) != 0
+            && IsAt( Player::GetShipRowCol(), facingCol, facingRow ) )
             allowMove = true;
 
         if ( allowMove )
@@ -359,6 +657,10 @@ void Overworld::UpdateCanoeIdle()
 
             curUpdate = &Overworld::UpdateMoving;
         }
+        else
+        {
+            walker.Stop();
+        }
     }
 }
 
@@ -366,21 +668,26 @@ void Overworld::UpdateShipIdle()
 {
     if ( Input::IsKeyPressing( MenuKey ) )
     {
+        walker.Stop();
         SceneStack::ShowMenu();
         return;
     }
 
-    Direction dir = Input::GetInputDirection();
+    Direction dir = GetStepDirection();
 
     if ( dir != Dir_None )
     {
-        Point facingPos = GetFacingRowCol( dir );
+        int facingCol;
+        int facingRow;
+        GetFacingTile( dir, facingCol, facingRow );
+
         uint8_t ref = GetFacingTileRef( dir );
         uint16_t attrs = tileAttr[ref];
         bool allowMove = false;
 
-        if ( OWTile::IsDock( attrs ) 
-            || (OWTile::CanCanoe( attrs ) && (Player::GetVehicles() & Vehicle_Canoe) != 0) )
+        if ( GetPass( Pass_Dock, facingCol, facingRow ) 
+            || (GetPass( Pass_Canoe, facingCol, facingRow ) 
+                && (Player::GetVehicles() & Vehicle_Canoe) != 0) )
         {
             movingSpeed = 1;
             allowMove = true;
@@ -397,7 +704,8 @@ void Overworld::UpdateShipIdle()
 
             Player::SetShipRowCol( GetPlayerRowCol() );
         }
-        else if ( OWTile::CanShip( attrs ) && CanShipSpecial( facingPos.X, facingPos.Y ) )
+        else if ( GetPass( Pass_Ship, facingCol, facingRow ) 
+            && CanShipSpecial( facingCol, facingRow ) )
         {
             movingSpeed = 2;
             allowMove = true;
@@ -411,6 +719,10 @@ void Overworld::UpdateShipIdle()
 
             curUpdate = &Overworld::UpdateMoving;
         }
+        else
+        {
+            walker.Stop();
+        }
     }
 }
 
@@ -419,11 +731,11 @@ void Overworld::UpdateLand()
     if ( !airshipSprite->FinishedLiftLand() )
         return;
 
-    Point curRowCol = GetPlayerRowCol();
-    uint8_t hereRef = GetTileRef( curRowCol.X, curRowCol.Y );
-    uint16_t hereAttrs = tileAttr[hereRef];
+    int curCol;
+    int curRow;
+    GetPlayerTile( curCol, curRow );
 
-    if ( OWTile::CanAirship( hereAttrs ) )
+    if ( GetPass( Pass_Airship, curCol, curRow ) )
     {
         Player::SetActiveVehicle( Vehicle_Foot );
 
@@ -431,7 +743,7 @@ void Overworld::UpdateLand()
         playerSprite->SetY( airshipSprite->GetY() );
         vehicleSprite = playerSprite;
 
-        Player::SetAirshipRowCol( curRowCol );
+        Player::SetAirshipRowCol( GetPlayerRowCol() );
 
         Sound::PlayTrack( Sound_Field, 0, true );
 
@@ -448,19 +760,22 @@ void Overworld::UpdateAirshipIdle()
 {
     if ( Input::IsKeyPressing( MenuKey ) )
     {
+        walker.Stop();
         SceneStack::ShowMenu();
         return;
     }
 
     if ( Input::IsKeyDown( ConfirmKey ) )
     {
+        walker.Stop();
+        Sound::StopEffect();
         Sound::PlayEffect( SEffect_Land );
         airshipSprite->SetState( AirshipSprite::Landing );
         curUpdate = &Overworld::UpdateLand;
         return;
     }
 
-    Direction dir = Input::GetInputDirection();
+    Direction dir = GetStepDirection();
 
     if ( dir != Dir_None )
     {
@@ -492,8 +807,8 @@ void Overworld::UpdateMoving()
 
     ShiftMap( shiftX, shiftY );
 
-    vehicleSprite->SetX( (uint32_t) (vehicleSprite->GetX() + shiftX) % (ColCount*TileWidth) );
-    vehicleSprite->SetY( (uint32_t) (vehicleSprite->GetY() + shiftY) % (RowCount*TileHeight) );
+    vehicleSprite->SetX( (uint32_t) (vehicleSprite->GetX() + shiftX) % (colCount*TileWidth) );
+    vehicleSprite->SetY( (uint32_t) (vehicleSprite->GetY() + shiftY) % (rowCount*TileHeight) );
 
     if ( poisonMove )
         Sound::PlayEffect( SEffect_Step );
@@ -504,15 +819,15 @@ void Overworld::UpdateMoving()
         vehicleSprite->Stop();
         poisonMove = false;
 
-        Point curCell = GetPlayerRowCol();
-        uint8_t ref = GetTileRef( curCell.X, curCell.Y );
-        uint16_t attrs = tileAttr[ref];
+        int curCol;
+        int curRow;
+        GetPlayerTile( curCol, curRow );
 
         if ( Player::GetActiveVehicle() == Vehicle_Airship )
         {
             curUpdate = &Overworld::UpdateAirshipIdle;
         }
-        else if ( OWTile::CanCanoe( attrs ) )
+        else if ( GetPass( Pass_Canoe, curCol, curRow ) )
         {
             if ( Player::GetActiveVehicle() != Vehicle_Canoe )
             {
@@ -527,9 +842,11 @@ void Overworld::UpdateMoving()
 
             curUpdate = &Overworld::UpdateCanoeIdle;
         }
-        else if ( OWTile::CanShip( attrs ) )
+        else if ( GetPass( Pass_Ship, curCol, curRow ) )
         {
-            if ( Player::GetActiveVehicle() != Vehicle_Ship && curCell == Player::GetShipRowCol() )
+            bool atShip = IsAt( Player::GetShipRowCol(), curCol, curRow );
+
+            if ( Player::GetActiveVehicle() != Vehicle_Ship && atShip )
             {
                 Player::SetActiveVehicle( Vehicle_Ship );
 
@@ -544,12 +861,12 @@ void Overworld::UpdateMoving()
 
                 curUpdate = &Overworld::UpdateShipIdle;
             }
-            else if ( Player::GetActiveVehicle() != Vehicle_Ship && curCell != Player::GetShipRowCol() )
+            else if ( Player::GetActiveVehicle() != Vehicle_Ship && !atShip )
             {
                 // special case for walking over a special tile that's usually water
                 curUpdate = &Overworld::UpdateFootIdle;
 
-                if ( (curCell.X == BridgeCol && curCell.Y == BridgeRow) 
+                if ( (curCol == BridgeCol && curRow == BridgeRow) 
                     && !Player::WasOpeningScenePlayed() )
                 {
                     playOpening = true;
@@ -587,12 +904,12 @@ void Overworld::UpdateMoving()
         }
         else if ( !skipBattle && GetTriggeredBattle( formationId ) )
         {
-            Point pos = GetPlayerRowCol();
-            int tile = GetTileRef( pos.X, pos.Y );
+            int tile = GetTileRef( curCol, curRow );
 
             SceneStack::BeginFade( 15, Color::Transparent(), Color::Black(), 
                 [this, formationId, tile] 
                 { SceneStack::EnterBattle( formationId, tileBackdrops[tile] ); } );
+            Sound::StopEffect();
             Sound::PlayEffect( SEffect_Fight );
         }
         else
@@ -607,8 +924,11 @@ void Overworld::UpdateMoving()
 
 bool Overworld::GetTriggeredTeleport( int& teleportId )
 {
-    Point curPos = GetPlayerRowCol();
-    int ref = GetTileRef( curPos.X, curPos.Y );
+    int curCol;
+    int curRow;
+    GetPlayerTile( curCol, curRow );
+
+    int ref = GetTileRef( curCol, curRow );
     uint16_t attrs = tileAttr[ref];
 
     if ( Player::GetActiveVehicle() == Vehicle_Airship )
@@ -624,69 +944,78 @@ bool Overworld::GetTriggeredTeleport( int& teleportId )
 
 bool Overworld::GetTriggeredBattle( int& formationId )
 {
-    Point curPos = GetPlayerRowCol();
-    int ref = GetTileRef( curPos.X, curPos.Y );
-    uint16_t attrs = tileAttr[ref];
+    int curCol;
+    int curRow;
+    GetPlayerTile( curCol, curRow );
 
     if ( Player::GetActiveVehicle() == Vehicle_Airship )
         return false;
 
-    if ( !OWTile::CanFight( attrs ) )
+    int domain = GetFightDomain( curCol, curRow );
+
+    if ( domain == NoDomain )
         return false;
 
-    if ( (curPos.X == BridgeCol && curPos.Y == BridgeRow)
-        || (curPos.X == IsmusCol && curPos.Y == IsmusRow) )
+    if ( !Encounters::Step( GetDomainBattleRate( domain ) ) )
         return false;
 
-    int generalDomain = 0;
-    int domain = 0;
-    bool triggered = false;
-    int r = GetNextRandom( 256 );
+    formationId = Global::GetBattleFormation( domain );
 
-    generalDomain = OWTile::GetFightDomain( attrs );
+    return true;
+}
 
-    if ( generalDomain == OWTile::Sea )
-        triggered = r < 3;
-    else
-        triggered = r < 10;
+int Overworld::GetBattleRate( int col, int row )
+{
+    if ( instance == nullptr )
+        return 0;
 
-    if ( !triggered )
-        return false;
+    return GetDomainBattleRate( instance->GetFightDomain( col, row ) );
+}
 
-    if ( generalDomain == OWTile::Sea )
-    {
-        domain = 0x42;
-    }
-    else if ( generalDomain == OWTile::River )
-    {
-        if ( curPos.Y < 128 )
-            domain = 0x40;
-        else
-            domain = 0x41;
-    }
-    else // Land
-    {
-        int domainCol = curPos.X / 32;
-        int domainRow = curPos.Y / 32;
+double Overworld::GetExpectedStepsToBattle()
+{
+    if ( instance == nullptr || Player::GetActiveVehicle() == Vehicle_Airship )
+        return -1;
 
-        domain = domainCol | (domainRow << 3);
-    }
+    int curCol;
+    int curRow;
+    instance->GetPlayerTile( curCol, curRow );
 
-    formationId = Global::GetBattleFormation( domain );
+    return Encounters::GetExpectedSteps( GetBattleRate( curCol, curRow ) );
+}
 
-    return true;
+int Overworld::WrapCol( int col )
+{
+    col %= colCount;
+    return col < 0 ? col + colCount : col;
+}
+
+int Overworld::WrapRow( int row )
+{
+    row %= rowCount;
+    return row < 0 ? row + rowCount : row;
 }
 
+// For the game's state, which keeps positions as bytes
+
 Point Overworld::GetPlayerRowCol()
 {
-    int col = (uint8_t) (leftCol + MiddleCol);
-    int row = (uint8_t) (topRow + MiddleRow);
-    Point pos = { col, row };
+    int col;
+    int row;
+    GetPlayerTile( col, row );
+
+    Point pos = { (uint8_t) col, (uint8_t) row };
 
     return pos;
 }
 
-Point Overworld::GetFacingRowCol( Direction direction )
+void Overworld::GetPlayerTile( int& col, int& row )
+{
+    col = WrapCol( leftCol + MiddleCol );
+    row = WrapRow( topRow + MiddleRow );
+}
+
+void Overworld::GetFacingTile( Direction direction, int& col, int& row )
 {
     int shiftCol = 0;
     int shiftRow = 0;
@@ -699,11 +1028,10 @@ Point Overworld::GetFacingRowCol( Direction direction )
     case Dir_Up:    shiftRow = -1; break;
     }
 
-    Point pos = GetPlayerRowCol();
-    pos.X += shiftCol;
-    pos.Y += shiftRow;
+    GetPlayerTile( col, row );
 
-    return pos;
+    col = WrapCol( col + shiftCol );
+    row = WrapRow( row + shiftRow );
 }
 
 int Overworld::GetFacingTileRef( Direction direction )
@@ -719,24 +1047,20 @@ int Overworld::GetFacingTileRef( Direction direction )
     case Dir_Up:    shiftRow = -1; break;
     }
 
-    int col = (uint8_t) ((vehicleSprite->GetX() / TileWidth) + shiftCol);
-    int row = (uint8_t) ((vehicleSprite->GetY() / TileHeight) + shiftRow);
+    int col = (vehicleSprite->GetX() / TileWidth) + shiftCol;
+    int row = (vehicleSprite->GetY() / TileHeight) + shiftRow;
 
     return GetTileRef( col, row );
 }
 
 int Overworld::GetTileRef( int col, int row )
 {
-    int relRow = (uint8_t) (row - topRow);
-    int bufRow = (uncompStartRow + relRow) % VisibleRows;
-
-    return tileRefs[bufRow][col];
+    return chunkMap.GetTileRef( col, row );
 }
 
 void Overworld::ShiftMap( int shiftX, int shiftY )
 {
-    int newBufRow = -1;
-    int newMapRow = -1;
+    bool newTile = false;
 
     if ( shiftX < 0 )
     {
@@ -744,7 +1068,8 @@ void Overworld::ShiftMap( int shiftX, int shiftY )
         if ( offsetX < 0 )
         {
             offsetX += TileWidth;
-            leftCol = (leftCol - 1 + ColCount) % ColCount;
+            leftCol = (leftCol - 1 + colCount) % colCount;
+            newTile = true;
         }
     }
     else if ( shiftX > 0 )
@@ -753,7 +1078,8 @@ void Overworld::ShiftMap( int shiftX, int shiftY )
         if ( offsetX >= TileWidth )
         {
             offsetX -= TileWidth;
-            leftCol = (leftCol + 1) % ColCount;
+            leftCol = (leftCol + 1) % colCount;
+            newTile = true;
         }
     }
 
@@ -763,10 +1089,8 @@ void Overworld::ShiftMap( int shiftX, int shiftY )
         if ( offsetY < 0 )
         {
             offsetY += TileHeight;
-            topRow = (topRow - 1 + RowCount) % RowCount;
-            uncompStartRow = (uncompStartRow - 1 + VisibleRows) % VisibleRows;
-            newBufRow = uncompStartRow;
-            newMapRow = topRow;
+            topRow = (topRow - 1 + rowCount) % rowCount;
+            newTile = true;
         }
     }
     else if ( shiftY > 0 )
@@ -775,23 +1099,31 @@ void Overworld::ShiftMap( int shiftX, int shiftY )
         if ( offsetY >= TileHeight )
         {
             offsetY -= TileHeight;
-            topRow = (topRow + 1) % RowCount;
-            newBufRow = uncompStartRow;
-            uncompStartRow = (uncompStartRow + 1) % VisibleRows;
-            newMapRow = (topRow + (VisibleRows - 1)) % RowCount;
+            topRow = (topRow + 1) % rowCount;
+            newTile = true;
         }
     }
 
-    if ( newBufRow >= 0 )
+    if ( newTile )
     {
-        DecompressMap( compressedRows.GetItem( newMapRow ), tileRefs[newBufRow] );
+        // Read the chunks the player is heading into while they're still 
+        // a screen away.
+        chunkMap.StreamAround( 
+            leftCol + MiddleCol, 
+            topRow + MiddleRow, 
+            ChunkSize, 
+            ChunkSize );
     }
 }
 
 void Overworld::Draw()
 {
+    DrawList::Begin();
+
+    DrawList::SetLayer( Layer_Map );
     DrawMap();
 
+    DrawList::SetLayer( Layer_Sprites );
     DrawVehicles();
 
     if ( Player::IsCanalBlocked() )
@@ -800,33 +1132,72 @@ void Overworld::Draw()
     if ( Player::IsBridgeVisible() && Player::GetActiveVehicle() != Vehicle_Ship )
         DrawBridge();
 
+    DrawList::SetLayer( Layer_Player );
     DrawPlayer();
 
+    DrawList::SetLayer( Layer_Above );
+
     if ( Player::IsBridgeVisible() && Player::GetActiveVehicle() == Vehicle_Ship )
         DrawBridge();
+
+    if ( showMinimap )
+    {
+        DrawList::SetLayer( Layer_Overlay );
+        DrawMinimap();
+    }
+
+    DrawList::End();
 }
 
-void Overworld::DrawMap()
+void Overworld::DrawMinimap()
 {
-    al_hold_bitmap_drawing( true );
+    const int Left = (StdViewWidth - minimap.GetWidth()) / 2;
+    const int Top = (StdViewHeight - minimap.GetHeight()) / 2;
+    const int Scale = minimap.GetScale();
+
+    minimap.Draw( Left, Top );
+
+    // Mark the vehicles that are parked, and the player, who blinks
+
+    Vehicle vehicles = Player::GetVehicles();
+    Vehicle activeVehicle = Player::GetActiveVehicle();
 
+    if ( (vehicles & Vehicle_Ship) != 0 && activeVehicle != Vehicle_Ship )
+    {
+        Point pos = Player::GetShipRowCol();
+        DrawList::DrawFilledRectangle( Left + pos.X / Scale - 1, Top + pos.Y / Scale - 1, 2, 2, al_map_rgb( 0, 0, 255 ) );
+    }
+
+    if ( (vehicles & Vehicle_Airship) != 0 && activeVehicle != Vehicle_Airship )
+    {
+        Point pos = Player::GetAirshipRowCol();
+        DrawList::DrawFilledRectangle( Left + pos.X / Scale - 1, Top + pos.Y / Scale - 1, 2, 2, al_map_rgb( 255, 255, 0 ) );
+    }
+
+    if ( (GetFrameCounter() & 16) == 0 )
+    {
+        int col;
+        int row;
+        GetPlayerTile( col, row );
+        DrawList::DrawFilledRectangle( Left + col / Scale - 1, Top + row / Scale - 1, 3, 3, al_map_rgb( 255, 0, 0 ) );
+    }
+}
+
+void Overworld::DrawMap()
+{
     for ( int i = 0; i < VisibleRows; i++ )
     {
         for ( int j = 0; j < VisibleCols; j++ )
         {
-            int bufRow = (uncompStartRow + i) % VisibleRows;
-            int bufCol = (leftCol + j) % ColCount;
-            int tileRef = tileRefs[bufRow][bufCol];
+            int tileRef = GetTileRef( leftCol + j, topRow + i );
             int srcX = (tileRef % 16) * TileWidth;
             int srcY = (tileRef / 16) * TileHeight;
             int destX = j * TileWidth - offsetX;
             int destY = i * TileHeight - offsetY;
 
-            al_draw_bitmap_region( tiles, srcX, srcY, TileWidth, TileHeight, destX, destY, 0 );
+            DrawList::DrawBitmapRegion( tiles, srcX, srcY, TileWidth, TileHeight, destX, destY, 0 );
         }
     }
-
-    al_hold_bitmap_drawing( false );
 }
 
 void Overworld::DrawPlayer()
@@ -861,10 +1232,10 @@ void Overworld::DrawVehicles()
 
 void Overworld::DrawImage( int col, int row, int imageCol, int imageRow )
 {
-    col = (uint8_t) (col - leftCol);
-    row = (uint8_t) (row - topRow);
+    col = WrapCol( col - leftCol );
+    row = WrapRow( row - topRow );
 
-    al_draw_bitmap_region( 
+    DrawList::DrawBitmapRegion( 
         playerImage, 
         imageCol * 16, 
         imageRow * 16, 
@@ -896,8 +1267,11 @@ uint16_t Overworld::GetCurrentTileAttr()
     if ( instance == nullptr )
         return 0;
 
-    Point curPos = instance->GetPlayerRowCol();
-    int ref = instance->GetTileRef( curPos.X, curPos.Y );
+    int curCol;
+    int curRow;
+    instance->GetPlayerTile( curCol, curRow );
+
+    int ref = instance->GetTileRef( curCol, curRow );
 
     return instance->tileAttr[ref];
 }
@@ -909,3 +1283,183 @@ Point Overworld::GetPlayerPos()
 
     return instance->GetCurrentPos();
 }
+
+// A click on the map sets a tile to go to. The path is found from where 
+// the player stops next, with the vehicle they're using then, and taken 
+// one step each time they're idle. The arrow keys take over from it.
+
+void Overworld::UpdateWalk()
+{
+    Point click;
+
+    if ( Input::GetClick( click ) )
+    {
+        walkGoalCol = WrapCol( leftCol + (click.X + offsetX) / TileWidth );
+        walkGoalRow = WrapRow( topRow + (click.Y + offsetY) / TileHeight );
+        walkPending = true;
+        walker.Stop();
+    }
+
+    walker.Update();
+}
+
+Direction Overworld::GetStepDirection()
+{
+    Direction dir = Input::GetInputDirection();
+
+    if ( dir != Dir_None )
+    {
+        walkPending = false;
+        walker.Stop();
+        return dir;
+    }
+
+    if ( walkPending )
+    {
+        walkPending = false;
+        StartWalk( walkGoalCol, walkGoalRow );
+    }
+
+    return walker.GetNextStep();
+}
+
+void Overworld::StartWalk( int col, int row )
+{
+    int startCol;
+    int startRow;
+    GetPlayerTile( startCol, startRow );
+
+    int mode = Pass_RouteFoot;
+
+    if ( Player::GetActiveVehicle() == Vehicle_Airship )
+    {
+        Direction path[PathWalker::MaxSteps];
+        int count = FindAirshipPath( col, row, path, _countof( path ) );
+
+        walker.Start( path, count );
+        return;
+    }
+    else if ( Player::GetActiveVehicle() == Vehicle_Ship )
+        mode = Pass_RouteShip;
+    else if ( (Player::GetVehicles() & Vehicle_Canoe) != 0 )
+        mode = Pass_RouteCanoe;
+
+    PathFinder* finder = GetPathFinder( mode, startCol, startRow );
+    int index = mode - Pass_RouteFoot;
+    int left = routeLeftCols[index];
+    int top = routeTopRows[index];
+
+    // A goal outside of the finder's area can't be reached
+    walker.Start( 
+        finder, 
+        WrapCol( startCol - left ), 
+        WrapRow( startRow - top ), 
+        WrapCol( col - left ), 
+        WrapRow( row - top ) );
+    walker.Update();
+}
+
+// A map that fits in a path finder gets one for all of it, which wraps 
+// like the map. A bigger one gets one for the area around the player that 
+// doesn't wrap. It's moved when the player gets out of the middle of it.
+
+PathFinder* Overworld::GetPathFinder( int mode, int startCol, int startRow )
+{
+    int index = mode - Pass_RouteFoot;
+    PathFinder* finder = pathFinders[index];
+    bool wholeMap = colCount <= MaxRouteCols && rowCount <= MaxRouteRows;
+
+    if ( finder != nullptr )
+    {
+        if ( wholeMap )
+            return finder;
+
+        int col = WrapCol( startCol - routeLeftCols[index] );
+        int row = WrapRow( startRow - routeTopRows[index] );
+
+        if ( col >= MaxRouteCols / 4 && col < MaxRouteCols * 3 / 4
+            && row >= MaxRouteRows / 4 && row < MaxRouteRows * 3 / 4 )
+            return finder;
+    }
+    else
+    {
+        finder = new PathFinder();
+        pathFinders[index] = finder;
+    }
+
+    int cols = colCount;
+    int rows = rowCount;
+    int left = 0;
+    int top = 0;
+
+    if ( !wholeMap )
+    {
+        // Line the area up with chunks, so each row of a cluster is in one
+        cols = MaxRouteCols;
+        rows = MaxRouteRows;
+        left = WrapCol( startCol - cols / 2 ) / ChunkSize * ChunkSize;
+        top = WrapRow( startRow - rows / 2 ) / ChunkSize * ChunkSize;
+    }
+
+    auto readRow = [this, mode, left, top]( int col, int row )
+    {
+        int slot = chunkMap.GetSlot( left + col, top + row );
+        if ( slot < 0 )
+            return (uint16_t) 0;
+
+        col = WrapCol( left + col );
+        row = WrapRow( top + row );
+
+        return (uint16_t) (passBits[slot][mode][row % ChunkSize] >> (col % ChunkSize));
+    };
+
+    if ( !finder->Init( cols, rows, wholeMap, readRow ) )
+    {
+        delete finder;
+        pathFinders[index] = nullptr;
+        return nullptr;
+    }
+
+    routeLeftCols[index] = left;
+    routeTopRows[index] = top;
+
+    return finder;
+}
+
+// The airship can fly over anything, so go straight, the short way around
+int Overworld::FindAirshipPath( int col, int row, Direction* path, int maxSteps )
+{
+    int startCol;
+    int startRow;
+    GetPlayerTile( startCol, startRow );
+
+    int dx = WrapCol( col - startCol );
+    int dy = WrapRow( row - startRow );
+    Direction dirX = Dir_Right;
+    Direction dirY = Dir_Down;
+
+    if ( dx > colCount / 2 )
+    {
+        dx = colCount - dx;
+        dirX = Dir_Left;
+    }
+
+    if ( dy > rowCount / 2 )
+    {
+        dy = rowCount - dy;
+        dirY = Dir_Up;
+    }
+
+    if ( dx + dy > maxSteps )
+        return -1;
+
+    int count = 0;
+
+    for ( int i = 0; i < dx; i++ )
+        path[count++] = dirX;
+
+    for ( int i = 0; i < dy; i++ )
+        path[count++] = dirY;
+
+    return count;
+}
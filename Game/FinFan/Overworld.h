@@ -8,13 +8,17 @@
 #pragma once
 
 #include "Module.h"
+#include "ChunkMap.h"
+#include "Minimap.h"
+#include "PathFinder.h"
 
 
 class Overworld : public IModule, public IPlayfield
 {
     static const int TileTypes = 128;
-    static const int RowCount = 256;
-    static const int ColCount = 256;
+    static const int TabRows = 256;
+    static const int TabCols = 256;
+    static const int ChunkSize = ChunkMap::ChunkSize;
     static const int TileWidth = 16;
     static const int TileHeight = 16;
     static const int VisibleRows = 16;
@@ -23,20 +27,47 @@ class Overworld : public IModule, public IPlayfield
     static const int MiddleCol = 7;
     static const int EnterTeleports = 32;
 
+    enum PassMode
+    {
+        Pass_Walk,
+        Pass_Special,       // walking here has to be checked by CanWalk
+        Pass_Canoe,
+        Pass_Ship,
+        Pass_Airship,       // the airship can land here
+        Pass_Dock,
+
+        // Where each way of getting around can go, given the player's items
+        // and story flags when the map was loaded
+        Pass_RouteFoot,
+        Pass_RouteCanoe,
+        Pass_RouteShip,
+        Pass_Max
+    };
+
+    static const int Routes = Pass_RouteShip - Pass_RouteFoot + 1;
+    static const int NoDomain = 0xff;
+
+    // The most that a path finder covers. A bigger map gets one for the 
+    // area around the player.
+    static const int MaxRouteCols = PathFinder::MaxCols;
+    static const int MaxRouteRows = PathFinder::MaxRows;
+
     typedef void (Overworld::*UpdateFunc)();
 
     static Overworld* instance;
 
-    // The whole map is stored as a collection of rows, each individually compressed
+    // The map is extracted in chunks, each individually compressed. 
+    // They're streamed in from the file as the player gets near them.
     // Each uncompressed cell or element is the number of a unique tile (a tile reference)
 
-    Table<uint8_t, RowCount> compressedRows;
+    ChunkMap chunkMap;
+    int rowCount;
+    int colCount;
 
-    // Rows must be uncompressed to get the tile references. 
-    // Uncompress the rows that are visible into a buffer.
-    // 15 rows are visible at a time, if they're aligned with the screen. Otherwise, there are 16.
+    // Or the map is stored as a collection of 256 rows, each individually 
+    // compressed. They're uncompressed a chunk at a time.
 
-    uint8_t tileRefs[VisibleRows][ColCount];
+    Table<uint8_t, TabRows> compressedRows;
 
     // The tile graphics are laid out as a grid of 16 tiles in each row
     // Going left to right, top to bottom, the tiles are in the tile reference order
@@ -45,8 +76,42 @@ class Overworld : public IModule, public IPlayfield
 
     uint16_t tileAttr[TileTypes];
 
+    // The tiles of the overworld never change, so these are made for each
+    // chunk when it's read, and kept in its slot. The bridge and canal are
+    // checked separately.
+    //
+    // A bit for each tile and way of moving, a word for each row
+
+    uint32_t passBits[ChunkMap::MaxResident][Pass_Max][ChunkSize];
+
+    // The battle domain of each tile, or NoDomain where there are no 
+    // random battles.
+
+    uint8_t fightDomains[ChunkMap::MaxResident][ChunkMap::ChunkCells];
+
+    // Made the first time the player clicks a tile to go to with each 
+    // kind of route. Each covers the area from its left column and top row.
+    PathFinder* pathFinders[Routes];
+    int routeLeftCols[Routes];
+    int routeTopRows[Routes];
+    PathWalker walker;
+    bool walkPending;
+    int walkGoalCol;
+    int walkGoalRow;
+
     uint8_t tileBackdrops[TileTypes];
 
+    // Filled in a few chunks at a time, and as chunks are read. The bridge 
+    // and canal are laid over it as they change; vehicles are marked when 
+    // it's drawn.
+
+    Minimap minimap;
+    uint32_t bridgeColor;
+    uint32_t ismusColor;
+    bool minimapBridge;
+    bool minimapCanal;
+    bool showMinimap;
+
     LTeleport enterTeleports[EnterTeleports];
 
     // Keep track of the alignment of the visible region relative to the screen
@@ -54,11 +119,6 @@ class Overworld : public IModule, public IPlayfield
     int     offsetX;
     int     offsetY;
 
-    // In order to avoid uncompressing rows that are already in the buffer, 
-    // keep track of where the top row is in the uncompressed buffer
-
-    int     uncompStartRow;
-
     int     topRow;
     int     leftCol;
 
@@ -95,13 +155,31 @@ public:
     static uint16_t GetCurrentTileAttr();
     static Point GetPlayerPos();
 
+    // The chance out of 256 that a step on a tile starts a battle, on foot 
+    // or by ship. Tools can add these up along a route.
+    static int GetBattleRate( int col, int row );
+
+    // How many steps it's expected to take to start a battle, if the rest 
+    // of the tiles were like the player's; or -1 if there are no battles.
+    static double GetExpectedStepsToBattle();
+
 private:
+    bool OpenMap();
     void LoadMap( int middleCol, int middleRow );
+    void MakeChunkInfo( int slot, int chunkCol, int chunkRow, const uint8_t* tileRefs );
+    bool GetPass( int mode, int col, int row );
+    int GetFightDomain( int col, int row );
+    int GetFightDomain( uint16_t attrs, int col, int row );
+    static int GetDomainBattleRate( int domain );
+    void MakeMinimap();
+    void UpdateMinimap();
+    void SetMinimapChunk( int col, int row );
     void ShiftMap( int shiftX, int shiftY );
 
     void DrawMap();
     void DrawPlayer();
     void DrawVehicles();
+    void DrawMinimap();
     void DrawImage( int col, int row, int imageCol, int imageRow );
     void DrawBridge();
     void DrawIsmus();
@@ -109,8 +187,12 @@ private:
     int GetFacingTileRef( Direction direction );
     int GetTileRef( int col, int row );
 
+    int WrapCol( int col );
+    int WrapRow( int row );
+
     Point GetPlayerRowCol();
-    Point GetFacingRowCol( Direction direction );
+    void GetPlayerTile( int& col, int& row );
+    void GetFacingTile( Direction direction, int& col, int& row );
 
     void UpdateFootIdle();
     void UpdateCanoeIdle();
@@ -120,7 +202,13 @@ private:
     void UpdateLift();
     void UpdateLand();
 
-    bool CanWalk( uint16_t attrs );
+    bool CanWalk( int col, int row );
+
+    void UpdateWalk();
+    Direction GetStepDirection();
+    void StartWalk( int col, int row );
+    PathFinder* GetPathFinder( int mode, int startCol, int startRow );
+    int FindAirshipPath( int col, int row, Direction* path, int maxSteps );
 
     bool GetTriggeredTeleport( int& teleportId );
     bool GetTriggeredBattle( int& formationId );
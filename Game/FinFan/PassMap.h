@@ -0,0 +1,80 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+
+// A bit-plane for each way of moving over a map, with one bit for each 
+// tile. They're made from tile attributes when a map is loaded, and updated
+// when a tile changes. Then movement checks only have to read a bit.
+//
+// Positions wrap around the edges of the map, like the maps themselves.
+
+template <int Rows, int Cols, int Modes>
+class PassMap
+{
+public:
+    static const int WordBits = 32;
+    static const int RowWords = (Cols + WordBits - 1) / WordBits;
+
+private:
+    uint32_t bits[Modes][Rows][RowWords];
+
+public:
+    PassMap()
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        memset( bits, 0, sizeof bits );
+    }
+
+    bool Get( int mode, int col, int row ) const
+    {
+        col = Wrap( col, Cols );
+        row = Wrap( row, Rows );
+
+        return (bits[mode][row][col / WordBits] & (1U << (col % WordBits))) != 0;
+    }
+
+    void Set( int mode, int col, int row, bool value )
+    {
+        col = Wrap( col, Cols );
+        row = Wrap( row, Rows );
+
+        uint32_t mask = 1U << (col % WordBits);
+
+        if ( value )
+            bits[mode][row][col / WordBits] |= mask;
+        else
+            bits[mode][row][col / WordBits] &= ~mask;
+    }
+
+    // Sets the bit of every mode for a tile from a mask of modes
+    void SetModes( int col, int row, uint32_t modeMask )
+    {
+        for ( int mode = 0; mode < Modes; mode++ )
+            Set( mode, col, row, (modeMask & (1U << mode)) != 0 );
+    }
+
+    // A whole row of one mode, RowWords long, for scanning many tiles
+    const uint32_t* GetRow( int mode, int row ) const
+    {
+        return bits[mode][Wrap( row, Rows )];
+    }
+
+private:
+    static int Wrap( int value, int count )
+    {
+        value %= count;
+        if ( value < 0 )
+            value += count;
+        return value;
+    }
+};
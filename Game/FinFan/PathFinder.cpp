@@ -0,0 +1,959 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Common.h"
+#include "PathFinder.h"
+#include <limits.h>
+
+
+static const Direction borderDirs[] =
+{
+    Dir_Left,
+    Dir_Right,
+    Dir_Up,
+    Dir_Down
+};
+
+
+PathFinder::PathFinder()
+    :   cols( 0 ),
+        rows( 0 ),
+        wrap( false ),
+        clusterCols( 0 ),
+        clusterRows( 0 ),
+        clusterCount( 0 ),
+        bordersDirty( false ),
+        clusters( nullptr ),
+        nodeCount( 0 ),
+        startNode( 0 ),
+        goalNode( 0 ),
+        nodes( nullptr ),
+        heap( nullptr ),
+        heapSize( 0 ),
+        searchStamp( 0 ),
+        phase( Phase_Idle ),
+        queryStartCol( 0 ),
+        queryStartRow( 0 ),
+        goalCol( 0 ),
+        goalRow( 0 ),
+        startCount( 0 ),
+        directLength( INT_MAX ),
+        directStart( 0 ),
+        found( false )
+{
+}
+
+PathFinder::~PathFinder()
+{
+    FreeGraph();
+}
+
+void PathFinder::FreeGraph()
+{
+    delete [] clusters;
+    delete [] nodes;
+    delete [] heap;
+
+    clusters = nullptr;
+    nodes = nullptr;
+    heap = nullptr;
+}
+
+bool PathFinder::Init( int cols, int rows, bool wrap, ReadRowFunc readRow )
+{
+    if ( !readRow
+        || cols < ClusterSize * 2 || cols > MaxCols || (cols % ClusterSize) != 0
+        || rows < ClusterSize * 2 || rows > MaxRows || (rows % ClusterSize) != 0 )
+        return false;
+
+    FreeGraph();
+
+    this->readRow = readRow;
+    this->cols = cols;
+    this->rows = rows;
+    this->wrap = wrap;
+
+    clusterCols = cols / ClusterSize;
+    clusterRows = rows / ClusterSize;
+    clusterCount = clusterCols * clusterRows;
+
+    startNode = clusterCount * MaxClusterNodes;
+    goalNode = startNode + MaxStarts;
+    nodeCount = goalNode + 1;
+
+    clusters = new Cluster[clusterCount];
+    nodes = new Node[nodeCount];
+    heap = new uint16_t[nodeCount];
+
+    memset( clusters, 0, clusterCount * sizeof clusters[0] );
+    memset( nodes, 0, nodeCount * sizeof nodes[0] );
+
+    // The graph is built by the first query, a few clusters at a time
+    for ( int i = 0; i < clusterCount; i++ )
+    {
+        clusters[i].OpenDirty = true;
+        clusters[i].BordersDirty = true;
+    }
+
+    bordersDirty = true;
+    searchStamp = 0;
+    phase = Phase_Idle;
+
+    return true;
+}
+
+void PathFinder::Invalidate( int col, int row )
+{
+    col = WrapCol( col );
+    row = WrapRow( row );
+
+    if ( clusters == nullptr || col < 0 || col >= cols || row < 0 || row >= rows )
+        return;
+
+    Cluster& c = clusters[GetCluster( col, row )];
+
+    c.OpenDirty = true;
+    c.BordersDirty = true;
+    bordersDirty = true;
+
+    // the costs found so far might not hold anymore
+    if ( phase != Phase_Idle )
+        phase = Phase_Start;
+}
+
+int PathFinder::GetMemorySize()
+{
+    return sizeof *this
+        + clusterCount * sizeof clusters[0]
+        + nodeCount * (sizeof nodes[0] + sizeof heap[0]);
+}
+
+bool PathFinder::IsOpen( int col, int row )
+{
+    col = WrapCol( col );
+    row = WrapRow( row );
+
+    if ( col < 0 || col >= cols || row < 0 || row >= rows )
+        return false;
+
+    int cluster = GetCluster( col, row );
+
+    ReadOpen( cluster );
+
+    return (clusters[cluster].Open[row % ClusterSize] & (1 << (col % ClusterSize))) != 0;
+}
+
+void PathFinder::ReadOpen( int cluster )
+{
+    Cluster& c = clusters[cluster];
+
+    if ( !c.OpenDirty )
+        return;
+
+    int left = (cluster % clusterCols) * ClusterSize;
+    int top = (cluster / clusterCols) * ClusterSize;
+
+    for ( int y = 0; y < ClusterSize; y++ )
+        c.Open[y] = readRow( left, top + y );
+
+    c.OpenDirty = false;
+}
+
+// Positions outside the map are left alone if it doesn't wrap
+
+int PathFinder::WrapCol( int col ) const
+{
+    if ( !wrap )
+        return col;
+
+    col %= cols;
+    return col < 0 ? col + cols : col;
+}
+
+int PathFinder::WrapRow( int row ) const
+{
+    if ( !wrap )
+        return row;
+
+    row %= rows;
+    return row < 0 ? row + rows : row;
+}
+
+int PathFinder::GetDistance( int col1, int row1, int col2, int row2 ) const
+{
+    int dx = abs( WrapCol( col1 ) - WrapCol( col2 ) );
+    int dy = abs( WrapRow( row1 ) - WrapRow( row2 ) );
+
+    // the short way might be around the edge
+    if ( wrap && dx > cols / 2 )
+        dx = cols - dx;
+    if ( wrap && dy > rows / 2 )
+        dy = rows - dy;
+
+    return dx + dy;
+}
+
+int PathFinder::GetCluster( int col, int row ) const
+{
+    return (WrapRow( row ) / ClusterSize) * clusterCols + WrapCol( col ) / ClusterSize;
+}
+
+// Returns -1 past the edge of a map that doesn't wrap
+
+int PathFinder::GetNeighbor( int cluster, int border ) const
+{
+    int x = cluster % clusterCols;
+    int y = cluster / clusterCols;
+
+    switch ( border )
+    {
+    case Border_Left:   x--; break;
+    case Border_Right:  x++; break;
+    case Border_Up:     y--; break;
+    case Border_Down:   y++; break;
+    }
+
+    if ( wrap )
+    {
+        x = (x + clusterCols) % clusterCols;
+        y = (y + clusterRows) % clusterRows;
+    }
+    else if ( x < 0 || x >= clusterCols || y < 0 || y >= clusterRows )
+    {
+        return -1;
+    }
+
+    return y * clusterCols + x;
+}
+
+void PathFinder::GetBorderCell( int cluster, int border, int pos, int& col, int& row ) const
+{
+    int left = (cluster % clusterCols) * ClusterSize;
+    int top = (cluster / clusterCols) * ClusterSize;
+
+    switch ( border )
+    {
+    case Border_Left:   col = left;                     row = top + pos; break;
+    case Border_Right:  col = left + ClusterSize - 1;   row = top + pos; break;
+    case Border_Up:     col = left + pos;               row = top; break;
+    case Border_Down:   col = left + pos;               row = top + ClusterSize - 1; break;
+    }
+}
+
+void PathFinder::GetNodeCell( int node, int& col, int& row ) const
+{
+    int cluster = node / MaxClusterNodes;
+    int slot = node % MaxClusterNodes;
+    int border = slot / MaxBorderNodes;
+
+    GetBorderCell( cluster, border, clusters[cluster].BorderPos[border][slot % MaxBorderNodes], col, row );
+}
+
+bool PathFinder::IsNode( int node ) const
+{
+    int cluster = node / MaxClusterNodes;
+    int slot = node % MaxClusterNodes;
+
+    return (slot % MaxBorderNodes) < clusters[cluster].BorderCount[slot / MaxBorderNodes];
+}
+
+// Returns true once every cluster is up to date. Borders are quick to 
+// build, so they're all done at once; distances take most of the time, so 
+// they're built as far as the budget goes.
+
+bool PathFinder::Refresh( int& nodeBudget )
+{
+    // A cluster shares each border with a neighbor, so rebuilding a
+    // border changes the entrances of both
+
+    if ( bordersDirty )
+    {
+        for ( int i = 0; i < clusterCount; i++ )
+        {
+            if ( clusters[i].BordersDirty )
+            {
+                for ( int border = 0; border < Borders; border++ )
+                    BuildBorder( i, border );
+
+                clusters[i].BordersDirty = false;
+            }
+        }
+
+        bordersDirty = false;
+    }
+
+    for ( int i = 0; i < clusterCount; i++ )
+    {
+        if ( clusters[i].DistDirty )
+        {
+            if ( nodeBudget <= 0 )
+                return false;
+
+            BuildDistances( i );
+
+            clusters[i].DistDirty = false;
+            nodeBudget -= MaxClusterNodes;
+        }
+    }
+
+    return true;
+}
+
+void PathFinder::BuildBorder( int cluster, int border )
+{
+    int neighbor = GetNeighbor( cluster, border );
+    int otherBorder = border ^ 1;
+    Cluster& c = clusters[cluster];
+
+    if ( neighbor < 0 )
+    {
+        c.BorderCount[border] = 0;
+        c.DistDirty = true;
+        return;
+    }
+
+    Cluster& n = clusters[neighbor];
+    int count = 0;
+    int runStart = -1;
+
+    for ( int pos = 0; pos <= ClusterSize; pos++ )
+    {
+        bool open = false;
+
+        if ( pos < ClusterSize )
+        {
+            int col, row;
+            int otherCol, otherRow;
+
+            GetBorderCell( cluster, border, pos, col, row );
+            GetBorderCell( neighbor, otherBorder, pos, otherCol, otherRow );
+
+            open = IsOpen( col, row ) && IsOpen( otherCol, otherRow );
+        }
+
+        if ( open && runStart < 0 )
+        {
+            runStart = pos;
+        }
+        else if ( !open && runStart >= 0 )
+        {
+            // a run is at least one open and one closed tile, so they fit
+            uint8_t middle = (runStart + pos - 1) / 2;
+
+            c.BorderPos[border][count] = middle;
+            n.BorderPos[otherBorder][count] = middle;
+            count++;
+            runStart = -1;
+        }
+    }
+
+    c.BorderCount[border] = count;
+    n.BorderCount[otherBorder] = count;
+
+    c.DistDirty = true;
+    n.DistDirty = true;
+}
+
+void PathFinder::SearchCluster( int cluster, int col, int row )
+{
+    int left = (cluster % clusterCols) * ClusterSize;
+    int top = (cluster / clusterCols) * ClusterSize;
+    int head = 0;
+    int tail = 0;
+
+    memset( localDist, Unreachable, sizeof localDist );
+
+    ReadOpen( cluster );
+
+    const uint16_t* open = clusters[cluster].Open;
+
+    int start = (WrapRow( row ) - top) * ClusterSize + (WrapCol( col ) - left);
+
+    localDist[start] = 0;
+    localDir[start] = Dir_None;
+    localQueue[tail++] = start;
+
+    // every cell is queued at most once, so the queue doesn't wrap
+    while ( head < tail )
+    {
+        int cell = localQueue[head++];
+        int x = cell % ClusterSize;
+        int y = cell / ClusterSize;
+
+        for ( int border = 0; border < Borders; border++ )
+        {
+            int nx = x;
+            int ny = y;
+
+            switch ( border )
+            {
+            case Border_Left:   nx--; break;
+            case Border_Right:  nx++; break;
+            case Border_Up:     ny--; break;
+            case Border_Down:   ny++; break;
+            }
+
+            if ( nx < 0 || nx >= ClusterSize || ny < 0 || ny >= ClusterSize )
+                continue;
+
+            int next = ny * ClusterSize + nx;
+
+            if ( localDist[next] != Unreachable || (open[ny] & (1 << nx)) == 0 )
+                continue;
+
+            // distances longer than fit in a byte are treated as no path
+            if ( localDist[cell] + 1 >= Unreachable )
+                continue;
+
+            localDist[next] = localDist[cell] + 1;
+            localDir[next] = borderDirs[border];
+            localQueue[tail++] = next;
+        }
+    }
+}
+
+void PathFinder::GetClusterDists( int cluster, uint8_t* dists )
+{
+    int left = (cluster % clusterCols) * ClusterSize;
+    int top = (cluster / clusterCols) * ClusterSize;
+
+    for ( int slot = 0; slot < MaxClusterNodes; slot++ )
+    {
+        int node = cluster * MaxClusterNodes + slot;
+
+        if ( !IsNode( node ) )
+        {
+            dists[slot] = Unreachable;
+            continue;
+        }
+
+        int col, row;
+
+        GetNodeCell( node, col, row );
+        dists[slot] = localDist[(row - top) * ClusterSize + (col - left)];
+    }
+}
+
+void PathFinder::BuildDistances( int cluster )
+{
+    Cluster& c = clusters[cluster];
+
+    memset( c.Dist, Unreachable, sizeof c.Dist );
+
+    for ( int slot = 0; slot < MaxClusterNodes; slot++ )
+    {
+        int node = cluster * MaxClusterNodes + slot;
+
+        if ( !IsNode( node ) )
+            continue;
+
+        int col, row;
+
+        GetNodeCell( node, col, row );
+        SearchCluster( cluster, col, row );
+        GetClusterDists( cluster, c.Dist[slot] );
+    }
+}
+
+int PathFinder::AddLocalPath(
+    int cluster,
+    int fromCol,
+    int fromRow,
+    int toCol,
+    int toRow,
+    Direction* path,
+    int count,
+    int maxSteps )
+{
+    int left = (cluster % clusterCols) * ClusterSize;
+    int top = (cluster / clusterCols) * ClusterSize;
+
+    SearchCluster( cluster, fromCol, fromRow );
+
+    int cell = (WrapRow( toRow ) - top) * ClusterSize + (WrapCol( toCol ) - left);
+    int length = localDist[cell];
+
+    if ( length == Unreachable )
+        return -1;
+    if ( count + length > maxSteps )
+        return -1;
+
+    // walk back from the end of the path
+
+    for ( int i = length - 1; i >= 0; i-- )
+    {
+        Direction dir = (Direction) localDir[cell];
+
+        localPath[i] = dir;
+
+        switch ( dir )
+        {
+        case Dir_Left:  cell++; break;
+        case Dir_Right: cell--; break;
+        case Dir_Up:    cell += ClusterSize; break;
+        case Dir_Down:  cell -= ClusterSize; break;
+        }
+    }
+
+    memcpy( path + count, localPath, length * sizeof localPath[0] );
+
+    return count + length;
+}
+
+void PathFinder::SiftUp( int index )
+{
+    int node = heap[index];
+    int priority = nodes[node].Priority;
+
+    while ( index > 0 )
+    {
+        int parent = (index - 1) / 2;
+
+        if ( nodes[heap[parent]].Priority <= priority )
+            break;
+
+        heap[index] = heap[parent];
+        nodes[heap[index]].HeapIndex = index;
+        index = parent;
+    }
+
+    heap[index] = node;
+    nodes[node].HeapIndex = index;
+}
+
+int PathFinder::Pop()
+{
+    int top = heap[0];
+    int last = heap[--heapSize];
+
+    if ( heapSize > 0 )
+    {
+        int priority = nodes[last].Priority;
+        int i = 0;
+
+        for ( ;; )
+        {
+            int child = i * 2 + 1;
+
+            if ( child >= heapSize )
+                break;
+
+            if ( child + 1 < heapSize && nodes[heap[child + 1]].Priority < nodes[heap[child]].Priority )
+                child++;
+
+            if ( nodes[heap[child]].Priority >= priority )
+                break;
+
+            heap[i] = heap[child];
+            nodes[heap[i]].HeapIndex = i;
+            i = child;
+        }
+
+        heap[i] = last;
+        nodes[last].HeapIndex = i;
+    }
+
+    nodes[top].HeapIndex = Closed;
+
+    return top;
+}
+
+void PathFinder::Relax( int node, int fromNode, int cost )
+{
+    Node& n = nodes[node];
+
+    if ( n.Stamp == searchStamp )
+    {
+        if ( n.HeapIndex == Closed || n.Cost <= cost )
+            return;
+
+        // the estimate stays the same, so only the cost changes the priority
+        n.Priority -= n.Cost - cost;
+        n.Cost = cost;
+        n.Parent = fromNode;
+        SiftUp( n.HeapIndex );
+        return;
+    }
+
+    int estimate = 0;
+
+    if ( node < startNode )
+    {
+        int col, row;
+
+        GetNodeCell( node, col, row );
+        estimate = GetDistance( col, row, goalCol, goalRow );
+    }
+    else if ( node < goalNode )
+    {
+        const Start& start = starts[node - startNode];
+
+        estimate = GetDistance( start.Col, start.Row, goalCol, goalRow );
+    }
+
+    n.Stamp = searchStamp;
+    n.Cost = cost;
+    n.Priority = cost + estimate;
+    n.Parent = fromNode;
+
+    heap[heapSize] = node;
+    SiftUp( heapSize++ );
+}
+
+void PathFinder::StartPath( int startCol, int startRow, int goalCol, int goalRow )
+{
+    if ( clusters == nullptr )
+        return;
+
+    queryStartCol = WrapCol( startCol );
+    queryStartRow = WrapRow( startRow );
+    this->goalCol = WrapCol( goalCol );
+    this->goalRow = WrapRow( goalRow );
+
+    phase = Phase_Start;
+}
+
+int PathFinder::ContinuePath( int nodeBudget, Direction* path, int maxSteps )
+{
+    if ( phase == Phase_Idle || path == nullptr )
+        return -1;
+
+    int result = Pending;
+
+    if ( phase == Phase_Start )
+        result = SetUpQuery();
+
+    if ( phase == Phase_Refresh && Refresh( nodeBudget ) )
+    {
+        SetUpSearch();
+        phase = Phase_Search;
+    }
+
+    if ( phase == Phase_Search && Search( nodeBudget ) )
+    {
+        result = MakePath( path, maxSteps );
+        phase = Phase_Idle;
+    }
+
+    return result;
+}
+
+int PathFinder::FindPath(
+    int startCol,
+    int startRow,
+    int goalCol,
+    int goalRow,
+    Direction* path,
+    int maxSteps )
+{
+    StartPath( startCol, startRow, goalCol, goalRow );
+
+    return ContinuePath( INT_MAX, path, maxSteps );
+}
+
+// Finds where the search starts from. Returns Pending if there's a search 
+// to do, or else the answer to the query.
+
+int PathFinder::SetUpQuery()
+{
+    phase = Phase_Idle;
+    startCount = 0;
+
+    if ( !IsOpen( goalCol, goalRow ) )
+        return -1;
+
+    if ( queryStartCol == goalCol && queryStartRow == goalRow )
+        return 0;
+
+    if ( IsOpen( queryStartCol, queryStartRow ) )
+    {
+        Start& start = starts[startCount++];
+
+        start.Col = queryStartCol;
+        start.Row = queryStartRow;
+        start.Cost = 0;
+        start.FirstDir = Dir_None;
+    }
+    else
+    {
+        // Entrances are only made between open tiles, so a closed start 
+        // might not reach any. Start from each open neighbor instead.
+
+        for ( int border = 0; border < Borders; border++ )
+        {
+            int col = queryStartCol;
+            int row = queryStartRow;
+
+            switch ( border )
+            {
+            case Border_Left:   col--; break;
+            case Border_Right:  col++; break;
+            case Border_Up:     row--; break;
+            case Border_Down:   row++; break;
+            }
+
+            if ( !IsOpen( col, row ) )
+                continue;
+
+            Start& start = starts[startCount++];
+
+            start.Col = WrapCol( col );
+            start.Row = WrapRow( row );
+            start.Cost = 1;
+            start.FirstDir = borderDirs[border];
+        }
+
+        if ( startCount == 0 )
+            return -1;
+    }
+
+    phase = Phase_Refresh;
+
+    return Pending;
+}
+
+void PathFinder::SetUpSearch()
+{
+    int goalCluster = GetCluster( goalCol, goalRow );
+    int goalLeft = (goalCluster % clusterCols) * ClusterSize;
+    int goalTop = (goalCluster / clusterCols) * ClusterSize;
+    int goalCell = (goalRow - goalTop) * ClusterSize + (goalCol - goalLeft);
+
+    SearchCluster( goalCluster, goalCol, goalRow );
+    GetClusterDists( goalCluster, goalDist );
+
+    searchStamp++;
+    heapSize = 0;
+    directLength = INT_MAX;
+    directStart = 0;
+    found = false;
+
+    for ( int i = 0; i < startCount; i++ )
+    {
+        Start& start = starts[i];
+        int cluster = GetCluster( start.Col, start.Row );
+
+        SearchCluster( cluster, start.Col, start.Row );
+        GetClusterDists( cluster, start.Dist );
+
+        // a path inside the cluster might beat any that leaves it
+        if ( cluster == goalCluster && localDist[goalCell] != Unreachable
+            && start.Cost + localDist[goalCell] < directLength )
+        {
+            directLength = start.Cost + localDist[goalCell];
+            directStart = i;
+        }
+
+        Relax( startNode + i, startNode + i, start.Cost );
+    }
+}
+
+// Searches over entrances. Returns true when the search is done, whether 
+// or not it reached the goal.
+
+bool PathFinder::Search( int& nodeBudget )
+{
+    int goalCluster = GetCluster( goalCol, goalRow );
+
+    while ( heapSize > 0 )
+    {
+        // nothing left can beat the path inside the goal cluster
+        if ( nodes[heap[0]].Priority >= directLength )
+            return true;
+
+        if ( nodeBudget <= 0 )
+            return false;
+
+        int node = Pop();
+
+        nodeBudget--;
+
+        if ( node == goalNode )
+        {
+            found = true;
+            return true;
+        }
+
+        int cost = nodes[node].Cost;
+
+        if ( node >= startNode )
+        {
+            const Start& start = starts[node - startNode];
+            int cluster = GetCluster( start.Col, start.Row );
+
+            for ( int slot = 0; slot < MaxClusterNodes; slot++ )
+            {
+                if ( start.Dist[slot] != Unreachable )
+                    Relax( cluster * MaxClusterNodes + slot, node, cost + start.Dist[slot] );
+            }
+            continue;
+        }
+
+        int cluster = node / MaxClusterNodes;
+        int slot = node % MaxClusterNodes;
+        int border = slot / MaxBorderNodes;
+        const Cluster& c = clusters[cluster];
+
+        // cross to the matching entrance of the neighbor
+
+        int neighbor = GetNeighbor( cluster, border );
+        int otherSlot = (border ^ 1) * MaxBorderNodes + slot % MaxBorderNodes;
+
+        Relax( neighbor * MaxClusterNodes + otherSlot, node, cost + 1 );
+
+        // go to the other entrances of this cluster
+
+        for ( int other = 0; other < MaxClusterNodes; other++ )
+        {
+            if ( other != slot && c.Dist[slot][other] != Unreachable )
+                Relax( cluster * MaxClusterNodes + other, node, cost + c.Dist[slot][other] );
+        }
+
+        if ( cluster == goalCluster && goalDist[slot] != Unreachable )
+            Relax( goalNode, node, cost + goalDist[slot] );
+    }
+
+    return true;
+}
+
+int PathFinder::MakePath( Direction* path, int maxSteps )
+{
+    int goalCluster = GetCluster( goalCol, goalRow );
+    int chainLength = 0;
+    int startIndex = directStart;
+
+    if ( found )
+    {
+        if ( nodes[goalNode].Cost > maxSteps )
+            return -1;
+
+        // Turn the chain of entrances into steps. The chain is walked from
+        // the goal, so collect it first. The search is over, so the heap 
+        // has room for it.
+
+        int node = nodes[goalNode].Parent;
+
+        for ( ; node < startNode; node = nodes[node].Parent )
+            heap[chainLength++] = node;
+
+        startIndex = node - startNode;
+    }
+    else if ( directLength == INT_MAX )
+    {
+        return -1;
+    }
+
+    const Start& start = starts[startIndex];
+    int count = 0;
+
+    if ( start.FirstDir != Dir_None )
+    {
+        if ( maxSteps < 1 )
+            return -1;
+
+        path[count++] = start.FirstDir;
+    }
+
+    int fromCol = start.Col;
+    int fromRow = start.Row;
+    int fromCluster = GetCluster( fromCol, fromRow );
+
+    for ( int i = chainLength - 1; i >= 0 && count >= 0; i-- )
+    {
+        int node = heap[i];
+        int cluster = node / MaxClusterNodes;
+        int col, row;
+
+        GetNodeCell( node, col, row );
+
+        if ( cluster == fromCluster )
+        {
+            count = AddLocalPath( cluster, fromCol, fromRow, col, row, path, count, maxSteps );
+        }
+        else if ( count < maxSteps )
+        {
+            int slot = node % MaxClusterNodes;
+            int border = slot / MaxBorderNodes;
+
+            // entered through the opposite border of this cluster
+            path[count++] = borderDirs[border ^ 1];
+        }
+        else
+        {
+            count = -1;
+        }
+
+        fromCol = col;
+        fromRow = row;
+        fromCluster = cluster;
+    }
+
+    if ( count >= 0 )
+        count = AddLocalPath( goalCluster, fromCol, fromRow, goalCol, goalRow, path, count, maxSteps );
+
+    return count;
+}
+
+
+PathWalker::PathWalker()
+    :   finder( nullptr ),
+        stepCount( 0 ),
+        nextStep( 0 )
+{
+}
+
+void PathWalker::Start( PathFinder* finder, int startCol, int startRow, int goalCol, int goalRow )
+{
+    Stop();
+
+    if ( finder == nullptr )
+        return;
+
+    this->finder = finder;
+    finder->StartPath( startCol, startRow, goalCol, goalRow );
+}
+
+void PathWalker::Start( const Direction* path, int count )
+{
+    Stop();
+
+    if ( count <= 0 || count > MaxSteps )
+        return;
+
+    memcpy( steps, path, count * sizeof steps[0] );
+    stepCount = count;
+}
+
+void PathWalker::Stop()
+{
+    finder = nullptr;
+    stepCount = 0;
+    nextStep = 0;
+}
+
+void PathWalker::Update()
+{
+    if ( finder == nullptr )
+        return;
+
+    int count = finder->ContinuePath( FrameNodeBudget, steps, MaxSteps );
+
+    if ( count == PathFinder::Pending )
+        return;
+
+    finder = nullptr;
+    stepCount = (count < 0) ? 0 : count;
+    nextStep = 0;
+}
+
+Direction PathWalker::GetNextStep()
+{
+    if ( finder != nullptr || nextStep >= stepCount )
+        return Dir_None;
+
+    return steps[nextStep++];
+}
@@ -0,0 +1,230 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+
+// Finds shortest 4-way paths over the open tiles of a map, with 
+// hierarchical A*. The map is cut into square clusters. Wherever two
+// clusters touch and both sides are open, an entrance is placed in the
+// middle of the opening. The distances between the entrances of a cluster
+// are kept, so a search only goes over entrances, and then the steps
+// inside each cluster are filled in.
+//
+// The open tiles are read a cluster at a time, and kept. When tiles 
+// change, call Invalidate; the clusters around them are read and rebuilt 
+// by the next query.
+//
+// A query can be spread over frames: StartPath sets it up, and each call 
+// to ContinuePath does at most a given amount of work. Rebuilding a 
+// cluster counts as expanding MaxClusterNodes nodes.
+//
+// Paths are nearly shortest: only one entrance is made per opening.
+
+class PathFinder
+{
+public:
+    static const int ClusterSize = 16;
+    static const int MaxCols = 256;
+    static const int MaxRows = 256;
+
+    // Returned by ContinuePath while the search isn't done
+    static const int Pending = -2;
+
+    // Returns a bit for each of ClusterSize tiles of a row, starting with
+    // the lowest bit, set if the tile is open. The column is a multiple of
+    // ClusterSize.
+    typedef std::function<uint16_t (int col, int row)> ReadRowFunc;
+
+    PathFinder();
+    ~PathFinder();
+
+    // The width and height must be multiples of ClusterSize, at least two
+    // clusters each. If wrap is set, paths can go around the edges, like
+    // the maps of the game; otherwise, the map ends there.
+    bool Init( int cols, int rows, bool wrap, ReadRowFunc readRow );
+
+    void Invalidate( int col, int row );
+
+    // Begins a query from the start to the goal, and forgets the one 
+    // before. The start doesn't have to be open.
+    void StartPath( int startCol, int startRow, int goalCol, int goalRow );
+
+    // Expands up to nodeBudget nodes of the query. When the query is done, 
+    // fills path with the directions to go, and returns how many steps 
+    // there are; or -1 if there's no path or it's longer than maxSteps.
+    // Otherwise, returns Pending.
+    int ContinuePath( int nodeBudget, Direction* path, int maxSteps );
+
+    // Runs a whole query at once
+    int FindPath(
+        int startCol,
+        int startRow,
+        int goalCol,
+        int goalRow,
+        Direction* path,
+        int maxSteps );
+
+    int GetMemorySize();
+
+private:
+    enum Border
+    {
+        Border_Left,
+        Border_Right,
+        Border_Up,
+        Border_Down,
+        Borders
+    };
+
+    enum Phase
+    {
+        Phase_Idle,
+        Phase_Start,
+        Phase_Refresh,
+        Phase_Search,
+    };
+
+    static const int ClusterCells = ClusterSize * ClusterSize;
+    static const int MaxBorderNodes = ClusterSize / 2;
+    static const int MaxClusterNodes = Borders * MaxBorderNodes;
+    static const int MaxStarts = Borders;
+    static const uint8_t Unreachable = 0xFF;
+    static const uint16_t Closed = 0xFFFF;
+
+    struct Cluster
+    {
+        uint16_t Open[ClusterSize];
+        uint8_t BorderCount[Borders];
+        uint8_t BorderPos[Borders][MaxBorderNodes];
+        uint8_t Dist[MaxClusterNodes][MaxClusterNodes];
+        bool OpenDirty;
+        bool BordersDirty;
+        bool DistDirty;
+    };
+
+    struct Node
+    {
+        uint32_t Stamp;         // the search that last reached the node
+        uint16_t Cost;
+        uint16_t Priority;      // the cost plus the estimate to the goal
+        uint16_t Parent;
+        uint16_t HeapIndex;     // or Closed once it's expanded
+    };
+
+    // A closed start has up to one start for each open neighbor, a step
+    // away. An open start has only itself.
+    struct Start
+    {
+        int Col;
+        int Row;
+        int Cost;
+        Direction FirstDir;
+        uint8_t Dist[MaxClusterNodes];
+    };
+
+    ReadRowFunc readRow;
+    int cols;
+    int rows;
+    bool wrap;
+    int clusterCols;
+    int clusterRows;
+    int clusterCount;
+    bool bordersDirty;
+
+    Cluster* clusters;
+
+    // The entrances of every cluster, then the starts, then the goal. The
+    // heap holds at most every node once, so it never runs out of room.
+    int nodeCount;
+    int startNode;
+    int goalNode;
+    Node* nodes;
+    uint16_t* heap;
+    int heapSize;
+    uint32_t searchStamp;
+
+    // the query under way
+    Phase phase;
+    int queryStartCol;
+    int queryStartRow;
+    int goalCol;
+    int goalRow;
+    Start starts[MaxStarts];
+    int startCount;
+    int directLength;
+    int directStart;
+    bool found;
+
+    uint8_t goalDist[MaxClusterNodes];
+
+    uint8_t localDist[ClusterCells];
+    uint8_t localDir[ClusterCells];
+    uint8_t localQueue[ClusterCells];
+    Direction localPath[ClusterCells];
+
+    bool IsOpen( int col, int row );
+    int WrapCol( int col ) const;
+    int WrapRow( int row ) const;
+    int GetDistance( int col1, int row1, int col2, int row2 ) const;
+
+    int GetCluster( int col, int row ) const;
+    int GetNeighbor( int cluster, int border ) const;
+    void GetBorderCell( int cluster, int border, int pos, int& col, int& row ) const;
+    void GetNodeCell( int node, int& col, int& row ) const;
+    bool IsNode( int node ) const;
+
+    void FreeGraph();
+    void ReadOpen( int cluster );
+    bool Refresh( int& nodeBudget );
+    void BuildBorder( int cluster, int border );
+    void BuildDistances( int cluster );
+
+    void SearchCluster( int cluster, int col, int row );
+    void GetClusterDists( int cluster, uint8_t* dists );
+    int AddLocalPath( int cluster, int fromCol, int fromRow, int toCol, int toRow, Direction* path, int count, int maxSteps );
+
+    int SetUpQuery();
+    void SetUpSearch();
+    bool Search( int& nodeBudget );
+    int MakePath( Direction* path, int maxSteps );
+
+    void SiftUp( int index );
+    int Pop();
+    void Relax( int node, int fromNode, int cost );
+};
+
+
+// Hands out the steps of a path to the player, one each time they're 
+// ready to take one. If the path is being found, Update carries on the 
+// search a little each frame, and there are no steps until it's done.
+
+class PathWalker
+{
+public:
+    static const int MaxSteps = 1024;
+
+    // Rebuilding a cluster takes about as long as expanding 
+    // MaxClusterNodes nodes. This keeps a frame's share of a search under 
+    // half a millisecond, and builds the overworld in about a second.
+    static const int FrameNodeBudget = 128;
+
+    PathWalker();
+
+    void Start( PathFinder* finder, int startCol, int startRow, int goalCol, int goalRow );
+    void Start( const Direction* path, int count );
+    void Stop();
+
+    void Update();
+    Direction GetNextStep();
+
+private:
+    PathFinder* finder;
+    Direction steps[MaxSteps];
+    int stepCount;
+    int nextStep;
+};
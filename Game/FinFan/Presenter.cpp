@@ -0,0 +1,413 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Common.h"
+#include "Presenter.h"
+#include "Config.h"
+#include <algorithm>
+
+#if defined( _M_IX86 ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define PRESENTER_SSE2 1
+#endif
+
+
+const int ViewWidth = StdViewWidth;
+const int ViewHeight = StdViewHeight;
+const int MaxScale = 16;
+
+
+static ALLEGRO_DISPLAY* display;
+static ALLEGRO_BITMAP* viewBmp;
+static bool cpuUpscale;
+static PresentFilter filter;
+
+static int scale = 1;
+static int offsetX;
+static int offsetY;
+
+static bool shaded;
+static float shadeColor[3];
+static float shadeKeep;
+static bool shadeLutValid;
+static float lutColor[3];
+static float lutKeep;
+static uint8_t shadeLut[3][256];
+
+static uint32_t shadedRow[ViewWidth];
+static uint32_t scaledRow[ViewWidth * MaxScale];
+static uint32_t filteredRow[ViewWidth * MaxScale];
+
+static PresentStats stats;
+
+
+bool Presenter::Init( ALLEGRO_DISPLAY* display )
+{
+    ALLEGRO_STATE state;
+    int filterOption = PresentFilter_None;
+
+    ::display = display;
+
+    Config::GetBool( "cpuUpscale", cpuUpscale );
+    Config::GetInt( "presentFilter", filterOption );
+
+    if ( filterOption > PresentFilter_None && filterOption < PresentFilter_Max )
+    {
+        filter = (PresentFilter) filterOption;
+        cpuUpscale = true;
+    }
+
+    // the view is always scaled by whole numbers, so it never needs to be 
+    // sampled between pixels
+
+    al_store_state( &state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS );
+    al_set_new_bitmap_flags( ALLEGRO_VIDEO_BITMAP );
+    al_set_new_bitmap_format( ALLEGRO_PIXEL_FORMAT_ANY_NO_ALPHA );
+    viewBmp = al_create_bitmap( ViewWidth, ViewHeight );
+    al_restore_state( &state );
+
+    return true;
+}
+
+void Presenter::Uninit()
+{
+    if ( viewBmp != nullptr )
+    {
+        al_destroy_bitmap( viewBmp );
+        viewBmp = nullptr;
+    }
+}
+
+bool Presenter::IsActive()
+{
+    return viewBmp != nullptr;
+}
+
+void Presenter::Resize( int screenWidth, int screenHeight )
+{
+    float viewAspect = ViewWidth / (float) ViewHeight;
+    float screenAspect = screenWidth / (float) screenHeight;
+
+    if ( viewAspect > screenAspect )
+        scale = screenWidth / ViewWidth;
+    else
+        scale = screenHeight / ViewHeight;
+
+    if ( scale <= 0 )
+        scale = 1;
+    else if ( cpuUpscale && scale > MaxScale )
+        scale = MaxScale;
+
+    // it looks better when the offsets are whole numbers
+    offsetX = (screenWidth - ViewWidth * scale) / 2;
+    offsetY = (screenHeight - ViewHeight * scale) / 2;
+
+    if ( offsetX < 0 )
+        offsetX = 0;
+    if ( offsetY < 0 )
+        offsetY = 0;
+
+    stats.Scale = scale;
+    stats.Cpu = cpuUpscale;
+}
+
+void Presenter::ScreenToView( int screenX, int screenY, int& viewX, int& viewY )
+{
+    int x = screenX - offsetX;
+    int y = screenY - offsetY;
+
+    // keep points left of or above the view outside of it
+    viewX = (x < 0) ? -1 : x / scale;
+    viewY = (y < 0) ? -1 : y / scale;
+}
+
+void Presenter::BeginFrame()
+{
+    shaded = false;
+    shadeColor[0] = 0;
+    shadeColor[1] = 0;
+    shadeColor[2] = 0;
+    shadeKeep = 1;
+
+    if ( viewBmp == nullptr )
+        return;
+
+    ALLEGRO_TRANSFORM t;
+
+    al_set_target_bitmap( viewBmp );
+    al_identity_transform( &t );
+    al_use_transform( &t );
+}
+
+static void ExpandRow( const uint32_t* src, uint32_t* dst, int scale )
+{
+    int i = 0;
+
+#if PRESENTER_SSE2
+    if ( scale == 2 )
+    {
+        for ( ; i < ViewWidth; i += 4 )
+        {
+            __m128i c = _mm_loadu_si128( (const __m128i*) (src + i) );
+
+            _mm_storeu_si128( (__m128i*) (dst + i * 2), _mm_unpacklo_epi32( c, c ) );
+            _mm_storeu_si128( (__m128i*) (dst + i * 2 + 4), _mm_unpackhi_epi32( c, c ) );
+        }
+        return;
+    }
+    else if ( scale == 3 )
+    {
+        for ( ; i < ViewWidth; i += 4 )
+        {
+            __m128i c = _mm_loadu_si128( (const __m128i*) (src + i) );
+
+            // a a a b | b b c c | c d d d
+            _mm_storeu_si128( (__m128i*) (dst + i * 3), _mm_shuffle_epi32( c, _MM_SHUFFLE( 1, 0, 0, 0 ) ) );
+            _mm_storeu_si128( (__m128i*) (dst + i * 3 + 4), _mm_shuffle_epi32( c, _MM_SHUFFLE( 2, 2, 1, 1 ) ) );
+            _mm_storeu_si128( (__m128i*) (dst + i * 3 + 8), _mm_shuffle_epi32( c, _MM_SHUFFLE( 3, 3, 3, 2 ) ) );
+        }
+        return;
+    }
+    else if ( scale == 4 )
+    {
+        for ( ; i < ViewWidth; i += 4 )
+        {
+            __m128i c = _mm_loadu_si128( (const __m128i*) (src + i) );
+
+            _mm_storeu_si128( (__m128i*) (dst + i * 4), _mm_shuffle_epi32( c, _MM_SHUFFLE( 0, 0, 0, 0 ) ) );
+            _mm_storeu_si128( (__m128i*) (dst + i * 4 + 4), _mm_shuffle_epi32( c, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+            _mm_storeu_si128( (__m128i*) (dst + i * 4 + 8), _mm_shuffle_epi32( c, _MM_SHUFFLE( 2, 2, 2, 2 ) ) );
+            _mm_storeu_si128( (__m128i*) (dst + i * 4 + 12), _mm_shuffle_epi32( c, _MM_SHUFFLE( 3, 3, 3, 3 ) ) );
+        }
+        return;
+    }
+#endif
+
+    for ( ; i < ViewWidth; i++ )
+    {
+        uint32_t c = src[i];
+
+        for ( int j = 0; j < scale; j++ )
+            *dst++ = c;
+    }
+}
+
+// Halves the brightness of a row, leaving alpha alone
+static void DarkenRow( const uint32_t* src, uint32_t* dst, int count )
+{
+    int i = 0;
+
+#if PRESENTER_SSE2
+    const __m128i colorMask = _mm_set1_epi32( 0x007F7F7F );
+    const __m128i alphaMask = _mm_set1_epi32( (int) 0xFF000000 );
+
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        __m128i c = _mm_loadu_si128( (const __m128i*) (src + i) );
+        __m128i half = _mm_and_si128( _mm_srli_epi32( c, 1 ), colorMask );
+
+        _mm_storeu_si128( (__m128i*) (dst + i), _mm_or_si128( half, _mm_and_si128( c, alphaMask ) ) );
+    }
+#endif
+
+    for ( ; i < count; i++ )
+    {
+        uint32_t c = src[i];
+
+        dst[i] = ((c >> 1) & 0x007F7F7F) | (c & 0xFF000000);
+    }
+}
+
+void Presenter::Shade( ALLEGRO_COLOR color, float keep )
+{
+    shadeColor[0] = color.r + shadeColor[0] * keep;
+    shadeColor[1] = color.g + shadeColor[1] * keep;
+    shadeColor[2] = color.b + shadeColor[2] * keep;
+    shadeKeep *= keep;
+    shaded = true;
+}
+
+static void MakeShadeLut()
+{
+    // a fade holds each step for at least a frame, so only remake the 
+    // table when the step changes
+    if ( shadeLutValid
+        && lutKeep == shadeKeep 
+        && memcmp( lutColor, shadeColor, sizeof lutColor ) == 0 )
+        return;
+
+    for ( int ch = 0; ch < 3; ch++ )
+    {
+        float add = shadeColor[ch] * 255;
+
+        for ( int i = 0; i < 256; i++ )
+        {
+            int value = (int) (add + i * shadeKeep + 0.5f);
+
+            if ( value > 255 )
+                value = 255;
+            else if ( value < 0 )
+                value = 0;
+
+            shadeLut[ch][i] = value;
+        }
+    }
+
+    memcpy( lutColor, shadeColor, sizeof lutColor );
+    lutKeep = shadeKeep;
+    shadeLutValid = true;
+}
+
+static const uint32_t* ShadeRow( const uint32_t* src )
+{
+    for ( int i = 0; i < ViewWidth; i++ )
+    {
+        uint32_t c = src[i];
+
+        shadedRow[i] = (c & 0xFF000000)
+            | (shadeLut[0][(c >> 16) & 0xFF] << 16)
+            | (shadeLut[1][(c >> 8) & 0xFF] << 8)
+            | shadeLut[2][c & 0xFF];
+    }
+
+    return shadedRow;
+}
+
+static bool UpscaleCpu( ALLEGRO_BITMAP* backbuffer )
+{
+    ALLEGRO_LOCKED_REGION* srcRegion = al_lock_bitmap( 
+        viewBmp, 
+        ALLEGRO_PIXEL_FORMAT_ARGB_8888, 
+        ALLEGRO_LOCK_READONLY );
+    if ( srcRegion == nullptr )
+        return false;
+
+    ALLEGRO_LOCKED_REGION* dstRegion = al_lock_bitmap_region( 
+        backbuffer, 
+        offsetX, 
+        offsetY, 
+        ViewWidth * scale, 
+        ViewHeight * scale, 
+        ALLEGRO_PIXEL_FORMAT_ARGB_8888, 
+        ALLEGRO_LOCK_WRITEONLY );
+    if ( dstRegion == nullptr )
+    {
+        al_unlock_bitmap( viewBmp );
+        return false;
+    }
+
+    int rowWidth = ViewWidth * scale;
+    size_t rowSize = rowWidth * sizeof scaledRow[0];
+    bool scanlines = filter == PresentFilter_Scanlines && scale >= 2;
+
+    if ( shaded )
+        MakeShadeLut();
+
+    for ( int y = 0; y < ViewHeight; y++ )
+    {
+        const uint32_t* src = (const uint32_t*) ((const uint8_t*) srcRegion->data + y * srcRegion->pitch);
+
+        if ( shaded )
+            src = ShadeRow( src );
+
+        ExpandRow( src, scaledRow, scale );
+
+        int brightRows = scanlines ? scale - 1 : scale;
+
+        for ( int j = 0; j < brightRows; j++ )
+        {
+            uint8_t* dst = (uint8_t*) dstRegion->data + (y * scale + j) * dstRegion->pitch;
+
+            memcpy( dst, scaledRow, rowSize );
+        }
+
+        // the last row of each group is the dark one
+        if ( scanlines )
+        {
+            uint8_t* dst = (uint8_t*) dstRegion->data + (y * scale + scale - 1) * dstRegion->pitch;
+
+            DarkenRow( scaledRow, filteredRow, rowWidth );
+            memcpy( dst, filteredRow, rowSize );
+        }
+    }
+
+    al_unlock_bitmap( backbuffer );
+    al_unlock_bitmap( viewBmp );
+    return true;
+}
+
+// The shade color is cleared under the view, and the view is added to it, 
+// scaled down by the tint. That's still one draw of the view.
+static void DrawShaded()
+{
+    ALLEGRO_STATE state;
+    float keep = shadeKeep;
+
+    if ( keep < 0 )
+        keep = 0;
+
+    al_store_state( &state, ALLEGRO_STATE_BLENDER );
+
+    al_set_clipping_rectangle( offsetX, offsetY, ViewWidth * scale, ViewHeight * scale );
+    al_clear_to_color( al_map_rgb_f( 
+        std::min( shadeColor[0], 1.f ), 
+        std::min( shadeColor[1], 1.f ), 
+        std::min( shadeColor[2], 1.f ) ) );
+
+    al_set_blender( ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ONE );
+    al_draw_tinted_scaled_bitmap( 
+        viewBmp, 
+        al_map_rgba_f( keep, keep, keep, 1 ), 
+        0, 0, ViewWidth, ViewHeight, 
+        offsetX, offsetY, ViewWidth * scale, ViewHeight * scale, 
+        0 );
+
+    al_restore_state( &state );
+}
+
+void Presenter::EndFrame()
+{
+    if ( viewBmp == nullptr )
+        return;
+
+    double startTime = al_get_time();
+    ALLEGRO_BITMAP* backbuffer = al_get_backbuffer( display );
+    ALLEGRO_TRANSFORM t;
+
+    al_set_target_bitmap( backbuffer );
+    al_identity_transform( &t );
+    al_use_transform( &t );
+    al_set_clipping_rectangle( 0, 0, al_get_bitmap_width( backbuffer ), al_get_bitmap_height( backbuffer ) );
+    al_clear_to_color( al_map_rgb( 0, 0, 0 ) );
+
+    // the CPU can't write outside the backbuffer, so fall back to a plain 
+    // draw when the screen is smaller than the view
+    if ( !cpuUpscale || !UpscaleCpu( backbuffer ) )
+    {
+        if ( shaded )
+            DrawShaded();
+        else
+            al_draw_scaled_bitmap( 
+                viewBmp, 
+                0, 0, ViewWidth, ViewHeight, 
+                offsetX, offsetY, ViewWidth * scale, ViewHeight * scale, 
+                0 );
+    }
+
+    double time = al_get_time() - startTime;
+
+    if ( time > stats.MaxTime )
+        stats.MaxTime = time;
+
+    stats.TotalTime += time;
+    stats.Frames++;
+}
+
+void Presenter::GetStats( PresentStats& stats )
+{
+    stats = ::stats;
+}
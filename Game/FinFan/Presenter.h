@@ -0,0 +1,70 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+
+enum PresentFilter
+{
+    PresentFilter_None,
+    PresentFilter_Scanlines,
+    PresentFilter_Max
+};
+
+
+struct PresentStats
+{
+    int Scale;
+    bool Cpu;
+
+    // Time spent scaling the view to the screen
+    double MaxTime;
+    double TotalTime;
+    int Frames;
+};
+
+
+// Scenes draw into a view bitmap at the native resolution, with no 
+// transform. At the end of the frame, the view is scaled to the screen by 
+// a whole number in one step, so the cost of scaling is the same no matter 
+// how much was drawn, and it can be measured by itself.
+//
+// By default, the view is scaled with one bitmap draw. The cpuUpscale 
+// option scales it on the CPU instead. The presentFilter option picks a 
+// filter, which needs the CPU path.
+//
+// Fades and flashes are applied while presenting, instead of blending a 
+// rectangle over the whole view. On the CPU path, each channel goes 
+// through a lookup table made once for each step of the fade. Fades of 
+// only part of the view, like text coming in line by line, are still 
+// drawn with tinted bitmaps.
+
+class Presenter
+{
+public:
+    static bool Init( ALLEGRO_DISPLAY* display );
+    static void Uninit();
+
+    // If the view bitmap couldn't be made, then scenes draw straight to the
+    // backbuffer through a scaling transform, as before
+    static bool IsActive();
+
+    static void Resize( int screenWidth, int screenHeight );
+
+    // Maps a point on the screen, like a click, to a pixel of the view
+    static void ScreenToView( int screenX, int screenY, int& viewX, int& viewY );
+
+    static void BeginFrame();
+    static void EndFrame();
+
+    // For the frame being drawn, each pixel of the view will become 
+    // color + pixel * keep. The color is premultiplied. Calls add up, in
+    // the order they're made, until the frame is presented.
+    static void Shade( ALLEGRO_COLOR color, float keep );
+
+    static void GetStats( PresentStats& stats );
+};
@@ -7,6 +7,7 @@
 
 #include "Common.h"
 #include "SceneStack.h"
+#include "Config.h"
 #include "Module.h"
 #include "MainMenu.h"
 #include "BattleMod.h"
@@ -14,6 +15,7 @@
 #include "Level.h"
 #include "Title.h"
 #include "StoryScenes.h"
+#include "Presenter.h"
 #include <allegro5\allegro_primitives.h>
 
 
@@ -41,6 +43,10 @@ struct SceneFrame
     uint8_t Col;
     uint8_t Row;
     uint8_t InRoom;
+
+    // The suspended level, or nullptr if it has to be made again
+    ::Level* Snapshot;
+    int     SnapshotSize;
 };
 
 typedef IModule* (*SceneMaker)();
@@ -48,11 +54,16 @@ typedef IModule* (*SceneMaker)();
 
 SceneChange pendingScene;
 
+const int DefaultSnapshotBudget = 512 * 1024;
+
 SceneFrame stack[100];
 int stackLength;
 int curLevelId;
 bool inShop;
 
+int snapshotBudget = DefaultSnapshotBudget;
+int snapshotsSize;
+
 IModule* curScene;
 IModule* curOverlay;
 
@@ -68,6 +79,7 @@ SceneMaker sceneMakers[] =
 };
 
 bool fade;
+bool fadeDrawn;
 int fadeTimer;
 int fadeFrames;
 ALLEGRO_COLOR startColor;
@@ -75,6 +87,14 @@ ALLEGRO_COLOR endColor;
 SceneStack::FadeEndProc fadeEndProc;
 
 
+void SceneStack::Init()
+{
+    int budgetKB = DefaultSnapshotBudget / 1024;
+
+    if ( Config::GetInt( "levelSnapshotKB", budgetKB ) && budgetKB >= 0 )
+        snapshotBudget = budgetKB * 1024;
+}
+
 void SceneStack::ShowShop( int id )
 {
     if ( curOverlay == nullptr )
@@ -188,6 +208,34 @@ void SceneStack::SwitchScene( SceneId id )
     pendingScene.Level = id;
 }
 
+static void DropSnapshot( SceneFrame& frame )
+{
+    if ( frame.Snapshot == nullptr )
+        return;
+
+    delete frame.Snapshot;
+    frame.Snapshot = nullptr;
+
+    snapshotsSize -= frame.SnapshotSize;
+    frame.SnapshotSize = 0;
+}
+
+// Drops the snapshots of the frames from the given one to the top
+
+static void DropSnapshots( int firstFrame )
+{
+    for ( int i = firstFrame; i < stackLength; i++ )
+        DropSnapshot( stack[i] );
+}
+
+// The deepest levels are the ones least likely to be popped back to soon
+
+static void TrimSnapshots()
+{
+    for ( int i = 0; i < stackLength && snapshotsSize > snapshotBudget; i++ )
+        DropSnapshot( stack[i] );
+}
+
 static void PushLevel()
 {
     int inRoom = 0;
@@ -202,11 +250,29 @@ static void PushLevel()
             inRoom = playfield->GetInRoom();
             pos = playfield->GetCurrentPos();
 
-            stack[stackLength].Level = curLevelId;
-            stack[stackLength].Col = pos.X;
-            stack[stackLength].Row = pos.Y;
-            stack[stackLength].InRoom = inRoom;
+            SceneFrame& frame = stack[stackLength];
+
+            frame.Level = curLevelId;
+            frame.Col = pos.X;
+            frame.Row = pos.Y;
+            frame.InRoom = inRoom;
+            frame.Snapshot = nullptr;
+            frame.SnapshotSize = 0;
             stackLength++;
+
+            if ( curLevelId != -1 )
+            {
+                Level* level = static_cast<Level*>( curScene );
+
+                level->Suspend();
+
+                frame.Snapshot = level;
+                frame.SnapshotSize = level->GetMemorySize();
+                snapshotsSize += frame.SnapshotSize;
+                curScene = nullptr;
+
+                TrimSnapshots();
+            }
         }
     }
 
@@ -245,6 +311,19 @@ static void PopLevel()
         curScene = field;
         curLevelId = -1;
     }
+    else if ( frame.Snapshot != nullptr )
+    {
+        Level* level = frame.Snapshot;
+
+        frame.Snapshot = nullptr;
+        snapshotsSize -= frame.SnapshotSize;
+        frame.SnapshotSize = 0;
+
+        level->Resume();
+
+        curScene = level;
+        curLevelId = frame.Level;
+    }
     else
     {
         Level* level = new Level();
@@ -261,6 +340,8 @@ static void PopLevel()
 
 static void PopAllLevels()
 {
+    DropSnapshots( 1 );
+
     if ( stackLength > 1 )
         stackLength = 1;
 
@@ -275,6 +356,8 @@ static void SwitchToField()
     delete curScene;
     curScene = nullptr;
 
+    DropSnapshots( 0 );
+
     Overworld* field = new Overworld();
     field->Init( pendingScene.Col, pendingScene.Row );
 
@@ -303,6 +386,8 @@ static void SwitchScene()
     delete curScene;
     curScene = nullptr;
 
+    DropSnapshots( 0 );
+
     IModule* scene = MakeScene( pendingScene.Level );
 
     curScene = scene;
@@ -377,7 +462,11 @@ static void DrawFade()
         startColor.b + (endColor.b - startColor.b) * factor, 
         startColor.a + (endColor.a - startColor.a) * factor );
 
-    al_draw_filled_rectangle( 0, 0, StdViewWidth, StdViewHeight, fadeColor );
+    // the fade color is premultiplied, so the view keeps (1 - alpha)
+    if ( Presenter::IsActive() )
+        Presenter::Shade( fadeColor, 1 - fadeColor.a );
+    else
+        al_draw_filled_rectangle( 0, 0, StdViewWidth, StdViewHeight, fadeColor );
 }
 
 void SceneStack::BeginFade( int frames, ALLEGRO_COLOR startColor, ALLEGRO_COLOR endColor, FadeEndProc p )
@@ -416,6 +505,18 @@ void SceneStack::Update()
     UpdateFade();
 }
 
+bool SceneStack::NeedsDraw()
+{
+    // The last frame of a fade has to be covered, once it ends
+    if ( fade || fadeDrawn )
+        return true;
+
+    if ( curOverlay != nullptr )
+        return curOverlay->NeedsDraw();
+    else
+        return curScene->NeedsDraw();
+}
+
 void SceneStack::Draw()
 {
     if ( curOverlay != nullptr )
@@ -424,4 +525,5 @@ void SceneStack::Draw()
         curScene->Draw();
 
     DrawFade();
+    fadeDrawn = fade;
 }
@@ -18,11 +18,19 @@ enum SceneId
 };
 
 
+// Levels that are pushed under another one are suspended rather than 
+// destroyed, so that popping back to them is instant. They're kept as long
+// as they all fit in a memory budget, given in KB by the config option 
+// levelSnapshotKB. When they don't, the deepest ones are destroyed, and 
+// they're made again from scratch when they're popped back to.
+
 class SceneStack
 {
 public:
     typedef std::function<void ()> FadeEndProc;
 
+    static void Init();
+
     static void ShowShop( int id );
     static void ShowMenu();
     static void HideMenu();
@@ -48,4 +56,5 @@ public:
 
     static void Update();
     static void Draw();
+    static bool NeedsDraw();
 };
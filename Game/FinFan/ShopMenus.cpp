@@ -90,6 +90,16 @@ void DrawPlayerEquipability( int playerId, bool canEquip )
         MainMenu::DrawPlayer( playerId, point.X, point.Y );
 }
 
+void AddPlayerEquipability( DirtyRect& dirty )
+{
+    for ( int i = 0; i < Players; i++ )
+    {
+        Point point = GetPlayerEquipabilityPos( i );
+
+        MainMenu::AddPlayerEquipableAnim( point.X, point.Y, dirty );
+    }
+}
+
 
 //----------------------------------------------------------------------------
 //  ItemShopMenu
@@ -169,6 +179,14 @@ void ItemShopMenu::Draw( MenuDrawState state )
     }
 }
 
+bool ItemShopMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    const int FirstItemX = TopMenuBoxX + 24;
+
+    AddCursorBlink( state, FirstItemX + selIndex * (72 - 24) - 16, TopMenuBoxY+8, dirty );
+    return true;
+}
+
 void ItemShopMenu::SetMessage( int shopMsgId )
 {
     instance->msg = MainMenu::GetShopText( shopMsgId );
@@ -273,6 +291,20 @@ void BuyItemMenu::Draw( MenuDrawState state )
     }
 }
 
+bool BuyItemMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    int shopType = MainMenu::GetShopType( shopId );
+
+    if ( !AddPrevIdleChanges( dirty ) )
+        return false;
+
+    if ( shopType == ShopType_Weapon || shopType == ShopType_Armor )
+        AddPlayerEquipability( dirty );
+
+    AddCursorBlink( state, 0, ItemBoxY+16 + selIndex * 16, dirty );
+    return true;
+}
+
 void BuyItemMenu::DrawEquipUI()
 {
     char str[32];
@@ -430,6 +462,15 @@ void AmountMenu::Draw( MenuDrawState state )
     }
 }
 
+bool AmountMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    if ( !AddPrevIdleChanges( dirty ) )
+        return false;
+
+    AddCursorBlink( state, 0, ItemBoxY + 16, dirty );
+    return true;
+}
+
 
 //----------------------------------------------------------------------------
 //  SellItemMenu
@@ -570,6 +611,17 @@ void SellItemMenu::Draw( MenuDrawState state )
     }
 }
 
+bool SellItemMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    const int ItemY = ItemBoxY + 16;
+
+    if ( !AddPrevIdleChanges( dirty ) )
+        return false;
+
+    AddCursorBlink( state, 8 + selCol * 15 * 8, ItemY + (selRow - topRow) * 16, dirty );
+    return true;
+}
+
 
 //----------------------------------------------------------------------------
 //  MagicShopMenu
@@ -661,6 +713,14 @@ void MagicShopMenu::Draw( MenuDrawState state )
     }
 }
 
+bool MagicShopMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    const int FirstItemX = TopMenuBoxX + 32;
+
+    AddCursorBlink( state, FirstItemX + selIndex * (104 - 32) - 16, TopMenuBoxY+8, dirty );
+    return true;
+}
+
 void MagicShopMenu::SetMessage( int shopMsgId )
 {
     instance->msg = MainMenu::GetShopText( shopMsgId );
@@ -742,6 +802,16 @@ void BuySpellMenu::Draw( MenuDrawState state )
     }
 }
 
+bool BuySpellMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    if ( !AddPrevIdleChanges( dirty ) )
+        return false;
+
+    AddPlayerEquipability( dirty );
+    AddCursorBlink( state, SpellListBoxX, SpellListBoxY+16 + selIndex * 16, dirty );
+    return true;
+}
+
 
 //----------------------------------------------------------------------------
 //  LearnerMenu
@@ -838,6 +908,17 @@ void LearnerMenu::Draw( MenuDrawState state )
     }
 }
 
+bool LearnerMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    Point point = GetPlayerEquipabilityPos( selIndex );
+
+    if ( !AddPrevIdleChanges( dirty ) )
+        return false;
+
+    AddCursorBlink( state, point.X - 16, point.Y, dirty );
+    return true;
+}
+
 
 //----------------------------------------------------------------------------
 //  ChurchShopMenu
@@ -941,6 +1022,14 @@ void ChurchShopMenu::RevivePlayer()
     selIndex = 0;
 }
 
+bool ChurchShopMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    if ( step == 0 )
+        AddCursorBlink( state, 0+16-16, 40+16 + selIndex * 16, dirty );
+
+    return true;
+}
+
 void ChurchShopMenu::Draw( MenuDrawState state )
 {
     DrawCommonShop( shopId, msg, true );
@@ -1074,6 +1163,14 @@ void InnShopMenu::Draw( MenuDrawState state )
     }
 }
 
+bool InnShopMenu::AddIdleChanges( MenuDrawState state, DirtyRect& dirty )
+{
+    if ( step == 0 )
+        AddCursorBlink( state, 0+16-16, 40+16 + selIndex * 16, dirty );
+
+    return true;
+}
+
 Menu* InnShopMenu::Make( int shopId )
 {
     return new InnShopMenu( shopId );
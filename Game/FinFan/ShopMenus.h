@@ -31,6 +31,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 
     static Menu* Make( int shopId );
 
@@ -52,6 +53,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 
 private:
     void DrawEquipUI();
@@ -71,6 +73,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 };
 
 
@@ -86,6 +89,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 };
 
 
@@ -108,6 +112,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 
     static Menu* Make( int shopId );
 
@@ -126,6 +131,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 };
 
 
@@ -139,6 +145,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 
 private:
     bool LearnSpell();
@@ -165,6 +172,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 
     static Menu* Make( int shopId );
 
@@ -191,6 +199,7 @@ public:
 
     virtual MenuAction Update( Menu*& nextMenu );
     virtual void Draw( MenuDrawState state );
+    virtual bool AddIdleChanges( MenuDrawState state, DirtyRect& dirty );
 
     static Menu* Make( int shopId );
 
@@ -0,0 +1,367 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Common.h"
+#include "SoftMixer.h"
+#include <allegro5\allegro_audio.h>
+#include <atomic>
+
+#if defined( _M_IX86 ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define SOFTMIXER_SSE2 1
+#endif
+
+
+const int MixerFreq = 44100;
+const int MixerFragments = 2;
+const int MinBufferFrames = 64;
+const int MaxBufferFrames = 4096;
+
+
+struct MixVoice
+{
+    const int16_t* Data;
+    int Frames;
+    int Channels;
+    int Pos;
+    bool Loop;
+    bool Playing;
+
+    // Bumped every time the game thread changes the voice, so that the mixer
+    // thread doesn't write back a position for a sound that was replaced.
+    uint32_t Serial;
+};
+
+
+static ALLEGRO_VOICE* mixerVoice;
+static ALLEGRO_AUDIO_STREAM* outStream;
+static ALLEGRO_EVENT_QUEUE* mixerQueue;
+static ALLEGRO_THREAD* mixerThread;
+static ALLEGRO_MUTEX* voiceLock;
+static MixVoice voices[SoftMixer::Voices];
+static int32_t* accum;
+static int bufferFrames;
+
+// Counted on the mixer thread, and read on the game thread
+static std::atomic<int> underruns;
+static std::atomic<int> overruns;
+
+
+static void AddMono( int32_t* dst, const int16_t* src, int frames )
+{
+    int i = 0;
+
+#if SOFTMIXER_SSE2
+    for ( ; i + 4 <= frames; i += 4 )
+    {
+        __m128i s = _mm_loadl_epi64( (const __m128i*) (src + i) );
+        __m128i lr = _mm_unpacklo_epi16( s, s );
+        __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( lr, lr ), 16 );
+        __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( lr, lr ), 16 );
+        __m128i* d = (__m128i*) (dst + i * 2);
+
+        _mm_storeu_si128( d, _mm_add_epi32( _mm_loadu_si128( d ), lo ) );
+        _mm_storeu_si128( d + 1, _mm_add_epi32( _mm_loadu_si128( d + 1 ), hi ) );
+    }
+#endif
+
+    for ( ; i < frames; i++ )
+    {
+        dst[i * 2] += src[i];
+        dst[i * 2 + 1] += src[i];
+    }
+}
+
+static void AddStereo( int32_t* dst, const int16_t* src, int frames )
+{
+    int i = 0;
+
+#if SOFTMIXER_SSE2
+    for ( ; i + 4 <= frames; i += 4 )
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i*) (src + i * 2) );
+        __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( s, s ), 16 );
+        __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( s, s ), 16 );
+        __m128i* d = (__m128i*) (dst + i * 2);
+
+        _mm_storeu_si128( d, _mm_add_epi32( _mm_loadu_si128( d ), lo ) );
+        _mm_storeu_si128( d + 1, _mm_add_epi32( _mm_loadu_si128( d + 1 ), hi ) );
+    }
+#endif
+
+    for ( ; i < frames; i++ )
+    {
+        dst[i * 2] += src[i * 2];
+        dst[i * 2 + 1] += src[i * 2 + 1];
+    }
+}
+
+static void Pack( int16_t* dst, const int32_t* src, int samples )
+{
+    int i = 0;
+
+#if SOFTMIXER_SSE2
+    for ( ; i + 8 <= samples; i += 8 )
+    {
+        __m128i a = _mm_loadu_si128( (const __m128i*) (src + i) );
+        __m128i b = _mm_loadu_si128( (const __m128i*) (src + i + 4) );
+
+        _mm_storeu_si128( (__m128i*) (dst + i), _mm_packs_epi32( a, b ) );
+    }
+#endif
+
+    for ( ; i < samples; i++ )
+    {
+        int32_t s = src[i];
+
+        if ( s > INT16_MAX )
+            s = INT16_MAX;
+        else if ( s < INT16_MIN )
+            s = INT16_MIN;
+
+        dst[i] = (int16_t) s;
+    }
+}
+
+static void MixVoiceInto( MixVoice& voice, int32_t* dst, int frames )
+{
+    int done = 0;
+
+    while ( done < frames && voice.Playing )
+    {
+        int n = voice.Frames - voice.Pos;
+
+        if ( n > frames - done )
+            n = frames - done;
+
+        const int16_t* src = voice.Data + voice.Pos * voice.Channels;
+
+        if ( voice.Channels == 1 )
+            AddMono( dst + done * 2, src, n );
+        else
+            AddStereo( dst + done * 2, src, n );
+
+        done += n;
+        voice.Pos += n;
+
+        if ( voice.Pos == voice.Frames )
+        {
+            if ( voice.Loop )
+                voice.Pos = 0;
+            else
+                voice.Playing = false;
+        }
+    }
+}
+
+static void MixFragment( int16_t* fragment )
+{
+    MixVoice local[SoftMixer::Voices];
+
+    // Only hold the lock long enough to copy the voices in and out, not while
+    // mixing.
+
+    al_lock_mutex( voiceLock );
+    memcpy( local, voices, sizeof local );
+    al_unlock_mutex( voiceLock );
+
+    memset( accum, 0, bufferFrames * 2 * sizeof accum[0] );
+
+    for ( int i = 0; i < SoftMixer::Voices; i++ )
+    {
+        if ( local[i].Playing )
+            MixVoiceInto( local[i], accum, bufferFrames );
+    }
+
+    Pack( fragment, accum, bufferFrames * 2 );
+
+    al_lock_mutex( voiceLock );
+    for ( int i = 0; i < SoftMixer::Voices; i++ )
+    {
+        if ( voices[i].Serial == local[i].Serial )
+        {
+            voices[i].Pos = local[i].Pos;
+            voices[i].Playing = local[i].Playing;
+        }
+    }
+    al_unlock_mutex( voiceLock );
+}
+
+static void* MixerThreadProc( ALLEGRO_THREAD* thread, void* arg )
+{
+    bool started = false;
+
+    while ( !al_get_thread_should_stop( thread ) )
+    {
+        ALLEGRO_EVENT event;
+
+        if ( !al_wait_for_event_timed( mixerQueue, &event, 0.1f ) )
+            continue;
+
+        if ( event.any.type != ALLEGRO_EVENT_AUDIO_STREAM_FRAGMENT )
+            continue;
+
+        // If every fragment is free, then the device already played out all
+        // that was queued, and we fell behind. Except at the start, when 
+        // nothing's been queued yet.
+
+        if ( started && al_get_available_audio_stream_fragments( outStream ) == MixerFragments )
+            underruns++;
+
+        void* fragment = al_get_audio_stream_fragment( outStream );
+        if ( fragment == nullptr )
+        {
+            // Woken up with nothing to fill.
+            overruns++;
+            continue;
+        }
+
+        MixFragment( (int16_t*) fragment );
+        al_set_audio_stream_fragment( outStream, fragment );
+        started = true;
+    }
+
+    return nullptr;
+}
+
+bool SoftMixer::Init( int bufferFrames )
+{
+    if ( bufferFrames < MinBufferFrames )
+        bufferFrames = MinBufferFrames;
+    else if ( bufferFrames > MaxBufferFrames )
+        bufferFrames = MaxBufferFrames;
+
+    // Keep it a multiple of 4 frames for the SIMD loops.
+
+    ::bufferFrames = bufferFrames & ~3;
+
+    voiceLock = al_create_mutex();
+    if ( voiceLock == nullptr )
+        return false;
+
+    accum = new int32_t[::bufferFrames * 2];
+
+    mixerVoice = al_create_voice( MixerFreq, ALLEGRO_AUDIO_DEPTH_INT16, ALLEGRO_CHANNEL_CONF_2 );
+    if ( mixerVoice == nullptr )
+        return false;
+
+    outStream = al_create_audio_stream( 
+        MixerFragments, ::bufferFrames, MixerFreq, ALLEGRO_AUDIO_DEPTH_INT16, ALLEGRO_CHANNEL_CONF_2 );
+    if ( outStream == nullptr )
+        return false;
+
+    mixerQueue = al_create_event_queue();
+    if ( mixerQueue == nullptr )
+        return false;
+
+    al_register_event_source( mixerQueue, al_get_audio_stream_event_source( outStream ) );
+
+    if ( !al_attach_audio_stream_to_voice( outStream, mixerVoice ) )
+        return false;
+
+    mixerThread = al_create_thread( MixerThreadProc, nullptr );
+    if ( mixerThread == nullptr )
+        return false;
+
+    al_start_thread( mixerThread );
+    return true;
+}
+
+void SoftMixer::Uninit()
+{
+    if ( mixerThread != nullptr )
+    {
+        al_join_thread( mixerThread, nullptr );
+        al_destroy_thread( mixerThread );
+        mixerThread = nullptr;
+    }
+
+    al_destroy_audio_stream( outStream );
+    outStream = nullptr;
+
+    if ( mixerQueue != nullptr )
+    {
+        al_destroy_event_queue( mixerQueue );
+        mixerQueue = nullptr;
+    }
+
+    al_destroy_voice( mixerVoice );
+    mixerVoice = nullptr;
+
+    delete [] accum;
+    accum = nullptr;
+
+    if ( voiceLock != nullptr )
+    {
+        al_destroy_mutex( voiceLock );
+        voiceLock = nullptr;
+    }
+}
+
+bool SoftMixer::IsActive()
+{
+    return mixerThread != nullptr;
+}
+
+bool SoftMixer::CanPlay( ALLEGRO_SAMPLE* sample )
+{
+    ALLEGRO_CHANNEL_CONF chanConf = al_get_sample_channels( sample );
+
+    return al_get_sample_depth( sample ) == ALLEGRO_AUDIO_DEPTH_INT16
+        && al_get_sample_frequency( sample ) == MixerFreq
+        && al_get_sample_length( sample ) > 0
+        && (chanConf == ALLEGRO_CHANNEL_CONF_1 || chanConf == ALLEGRO_CHANNEL_CONF_2);
+}
+
+void SoftMixer::StartVoice( int index, ALLEGRO_SAMPLE* sample, bool loop )
+{
+    if ( index < 0 || index >= Voices )
+        return;
+
+    al_lock_mutex( voiceLock );
+
+    MixVoice& voice = voices[index];
+
+    voice.Data = (const int16_t*) al_get_sample_data( sample );
+    voice.Frames = al_get_sample_length( sample );
+    voice.Channels = (al_get_sample_channels( sample ) == ALLEGRO_CHANNEL_CONF_1) ? 1 : 2;
+    voice.Pos = 0;
+    voice.Loop = loop;
+    voice.Playing = true;
+    voice.Serial++;
+
+    al_unlock_mutex( voiceLock );
+}
+
+void SoftMixer::StopVoice( int index )
+{
+    if ( index < 0 || index >= Voices )
+        return;
+
+    al_lock_mutex( voiceLock );
+    voices[index].Playing = false;
+    voices[index].Serial++;
+    al_unlock_mutex( voiceLock );
+}
+
+bool SoftMixer::IsVoicePlaying( int index )
+{
+    if ( index < 0 || index >= Voices )
+        return false;
+
+    al_lock_mutex( voiceLock );
+    bool playing = voices[index].Playing;
+    al_unlock_mutex( voiceLock );
+
+    return playing;
+}
+
+void SoftMixer::GetCounters( int& underruns, int& overruns )
+{
+    underruns = ::underruns;
+    overruns = ::overruns;
+}
@@ -0,0 +1,34 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+struct ALLEGRO_SAMPLE;
+
+
+// Mixes sound effect voices into one output stream on its own thread, with
+// a buffer small enough to keep effect latency low. Music keeps streaming
+// through Allegro's mixer on a separate voice.
+
+class SoftMixer
+{
+public:
+    static const int Voices = 8;
+    static const int DefaultBufferFrames = 256;
+
+    static bool Init( int bufferFrames );
+    static void Uninit();
+
+    static bool IsActive();
+    static bool CanPlay( ALLEGRO_SAMPLE* sample );
+
+    static void StartVoice( int index, ALLEGRO_SAMPLE* sample, bool loop );
+    static void StopVoice( int index );
+    static bool IsVoicePlaying( int index );
+
+    static void GetCounters( int& underruns, int& overruns );
+};
@@ -0,0 +1,547 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Common.h"
+#include "SoftRender.h"
+#include "Config.h"
+#include <limits.h>
+
+#if defined( _M_IX86 ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define SOFTRENDER_SSE2 1
+#endif
+
+
+struct IndexedImage
+{
+    ALLEGRO_BITMAP* Parent;
+    int16_t X;
+    int16_t Y;
+    int16_t Width;
+    int16_t Height;
+    bool Opaque;
+    uint8_t* Pixels;
+};
+
+
+const int SystemColors = 64;
+const int MaxImages = 64;
+const int MaxScale = 16;
+
+
+static bool active;
+static bool paletteLoaded;
+static uint8_t paletteRgb[SystemColors][3];
+static uint32_t paletteArgb[256];
+
+static uint8_t framebuffer[SoftRender::Height][SoftRender::Width];
+static uint32_t scaledRow[SoftRender::Width * MaxScale];
+
+static IndexedImage images[MaxImages];
+static int imageCount;
+static int lastImage;
+
+
+bool SoftRender::Init()
+{
+    bool softRender = false;
+
+    Config::GetBool( "softRender", softRender );
+
+    active = softRender;
+    return true;
+}
+
+void SoftRender::Uninit()
+{
+    for ( int i = 0; i < imageCount; i++ )
+    {
+        delete [] images[i].Pixels;
+    }
+
+    imageCount = 0;
+    lastImage = 0;
+    active = false;
+}
+
+bool SoftRender::IsActive()
+{
+    return active;
+}
+
+// The system colors are only loaded once the game starts
+
+static void LoadPalette()
+{
+    if ( paletteLoaded )
+        return;
+
+    for ( int i = 0; i < SystemColors; i++ )
+    {
+        ALLEGRO_COLOR color = Global::GetSystemColor( i );
+        unsigned char r, g, b;
+
+        al_unmap_rgb( color, &r, &g, &b );
+
+        paletteRgb[i][0] = r;
+        paletteRgb[i][1] = g;
+        paletteRgb[i][2] = b;
+        paletteArgb[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+    }
+
+    paletteLoaded = true;
+}
+
+static uint8_t FindColorIndex( int r, int g, int b )
+{
+    int best = 0;
+    int bestDist = INT_MAX;
+
+    for ( int i = 0; i < SystemColors; i++ )
+    {
+        int dr = paletteRgb[i][0] - r;
+        int dg = paletteRgb[i][1] - g;
+        int db = paletteRgb[i][2] - b;
+        int dist = dr * dr + dg * dg + db * db;
+
+        if ( dist < bestDist )
+        {
+            best = i;
+            bestDist = dist;
+
+            if ( dist == 0 )
+                break;
+        }
+    }
+
+    return best;
+}
+
+static uint8_t FindColorIndex( ALLEGRO_COLOR color )
+{
+    unsigned char r, g, b;
+
+    LoadPalette();
+    al_unmap_rgb( color, &r, &g, &b );
+
+    return FindColorIndex( r, g, b );
+}
+
+static bool ConvertImage( ALLEGRO_BITMAP* bitmap, IndexedImage& image )
+{
+    ALLEGRO_BITMAP* parent = al_get_parent_bitmap( bitmap );
+    int x = al_get_bitmap_x( bitmap );
+    int y = al_get_bitmap_y( bitmap );
+    int width = al_get_bitmap_width( bitmap );
+    int height = al_get_bitmap_height( bitmap );
+
+    ALLEGRO_LOCKED_REGION* region = al_lock_bitmap_region( 
+        parent, x, y, width, height, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY );
+    if ( region == nullptr )
+        return false;
+
+    image.Parent = parent;
+    image.X = x;
+    image.Y = y;
+    image.Width = width;
+    image.Height = height;
+    image.Opaque = true;
+    image.Pixels = new uint8_t[width * height];
+
+    // Neighboring pixels are usually the same color
+    uint32_t lastRgba = 0;
+    uint8_t lastIndex = FindColorIndex( 0, 0, 0 );
+
+    for ( int row = 0; row < height; row++ )
+    {
+        const uint8_t* src = (const uint8_t*) region->data + row * region->pitch;
+        uint8_t* dst = image.Pixels + row * width;
+
+        for ( int col = 0; col < width; col++, src += 4 )
+        {
+            if ( src[3] == 0 )
+            {
+                dst[col] = SoftRender::Transparent;
+                image.Opaque = false;
+                continue;
+            }
+
+            uint32_t rgba = src[0] | (src[1] << 8) | (src[2] << 16) | 0xFF000000;
+
+            if ( rgba != lastRgba )
+            {
+                lastRgba = rgba;
+                lastIndex = FindColorIndex( src[0], src[1], src[2] );
+            }
+
+            dst[col] = lastIndex;
+        }
+    }
+
+    al_unlock_bitmap( parent );
+
+    return true;
+}
+
+static IndexedImage* GetImage( ALLEGRO_BITMAP* bitmap )
+{
+    ALLEGRO_BITMAP* parent = al_get_parent_bitmap( bitmap );
+    int x = al_get_bitmap_x( bitmap );
+    int y = al_get_bitmap_y( bitmap );
+
+    if ( parent == nullptr )
+        return nullptr;
+
+    // Sprites are usually drawn several times in a row
+    for ( int n = 0; n < imageCount; n++ )
+    {
+        int i = (lastImage + n) % imageCount;
+        IndexedImage& image = images[i];
+
+        if ( image.Parent == parent && image.X == x && image.Y == y
+            && image.Width == al_get_bitmap_width( bitmap )
+            && image.Height == al_get_bitmap_height( bitmap ) )
+        {
+            lastImage = i;
+            return &image;
+        }
+    }
+
+    if ( imageCount == MaxImages )
+        return nullptr;
+
+    LoadPalette();
+
+    if ( !ConvertImage( bitmap, images[imageCount] ) )
+        return nullptr;
+
+    lastImage = imageCount;
+    imageCount++;
+
+    return &images[lastImage];
+}
+
+bool SoftRender::CanDraw( ALLEGRO_BITMAP* bitmap )
+{
+    return GetImage( bitmap ) != nullptr;
+}
+
+void SoftRender::Invalidate( ALLEGRO_BITMAP* parent )
+{
+    int count = 0;
+
+    for ( int i = 0; i < imageCount; i++ )
+    {
+        if ( images[i].Parent == parent )
+            delete [] images[i].Pixels;
+        else
+            images[count++] = images[i];
+    }
+
+    imageCount = count;
+    lastImage = 0;
+}
+
+
+//----------------------------------------------------------------------------
+//  Blitters
+//----------------------------------------------------------------------------
+
+static void MaskRow( uint8_t* dst, const uint8_t* src, int count )
+{
+    int i = 0;
+
+#if SOFTRENDER_SSE2
+    const __m128i transparent = _mm_set1_epi8( (char) SoftRender::Transparent );
+
+    for ( ; i + 16 <= count; i += 16 )
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i*) (src + i) );
+        __m128i d = _mm_loadu_si128( (const __m128i*) (dst + i) );
+        __m128i keep = _mm_cmpeq_epi8( s, transparent );
+
+        d = _mm_or_si128( _mm_and_si128( keep, d ), _mm_andnot_si128( keep, s ) );
+        _mm_storeu_si128( (__m128i*) (dst + i), d );
+    }
+#endif
+
+    for ( ; i < count; i++ )
+    {
+        if ( src[i] != SoftRender::Transparent )
+            dst[i] = src[i];
+    }
+}
+
+static void TintRow( uint8_t* dst, const uint8_t* src, int count, uint8_t color )
+{
+    int i = 0;
+
+#if SOFTRENDER_SSE2
+    const __m128i transparent = _mm_set1_epi8( (char) SoftRender::Transparent );
+    const __m128i tint = _mm_set1_epi8( (char) color );
+
+    for ( ; i + 16 <= count; i += 16 )
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i*) (src + i) );
+        __m128i d = _mm_loadu_si128( (const __m128i*) (dst + i) );
+        __m128i keep = _mm_cmpeq_epi8( s, transparent );
+
+        d = _mm_or_si128( _mm_and_si128( keep, d ), _mm_andnot_si128( keep, tint ) );
+        _mm_storeu_si128( (__m128i*) (dst + i), d );
+    }
+#endif
+
+    for ( ; i < count; i++ )
+    {
+        if ( src[i] != SoftRender::Transparent )
+            dst[i] = color;
+    }
+}
+
+// Reads the source right to left. Sprites are narrow, so it's left scalar.
+
+static void MaskRowFlipped( uint8_t* dst, const uint8_t* srcEnd, int count, int tint )
+{
+    for ( int i = 0; i < count; i++ )
+    {
+        uint8_t c = *(srcEnd - i);
+
+        if ( c != SoftRender::Transparent )
+            dst[i] = tint >= 0 ? (uint8_t) tint : c;
+    }
+}
+
+static void FillRow( uint8_t* dst, int count, uint8_t color )
+{
+    memset( dst, color, count );
+}
+
+// Returns false if nothing is left after clipping to the framebuffer
+
+static bool ClipRect( int& x, int& y, int& width, int& height, int& skipX, int& skipY )
+{
+    skipX = 0;
+    skipY = 0;
+
+    if ( x < 0 )
+    {
+        skipX = -x;
+        width += x;
+        x = 0;
+    }
+
+    if ( y < 0 )
+    {
+        skipY = -y;
+        height += y;
+        y = 0;
+    }
+
+    if ( x + width > SoftRender::Width )
+        width = SoftRender::Width - x;
+
+    if ( y + height > SoftRender::Height )
+        height = SoftRender::Height - y;
+
+    return width > 0 && height > 0;
+}
+
+// A negative tint draws the image's own colors
+
+static void BlitImage( 
+    const IndexedImage& image, 
+    int tint, 
+    int srcX, 
+    int srcY, 
+    int width, 
+    int height, 
+    int destX, 
+    int destY, 
+    int flags )
+{
+    int fullWidth = width;
+    int fullHeight = height;
+    int skipX = 0;
+    int skipY = 0;
+
+    if ( srcX < 0 || srcY < 0 || srcX + width > image.Width || srcY + height > image.Height )
+        return;
+
+    if ( !ClipRect( destX, destY, width, height, skipX, skipY ) )
+        return;
+
+    bool flipX = (flags & ALLEGRO_FLIP_HORIZONTAL) != 0;
+    bool flipY = (flags & ALLEGRO_FLIP_VERTICAL) != 0;
+
+    for ( int row = 0; row < height; row++ )
+    {
+        int srcRow = flipY ? (srcY + fullHeight - 1 - skipY - row) : (srcY + skipY + row);
+        const uint8_t* src = image.Pixels + srcRow * image.Width;
+        uint8_t* dst = framebuffer[destY + row] + destX;
+
+        if ( flipX )
+            MaskRowFlipped( dst, src + srcX + fullWidth - 1 - skipX, width, tint );
+        else if ( tint >= 0 )
+            TintRow( dst, src + srcX + skipX, width, (uint8_t) tint );
+        else if ( image.Opaque )
+            memcpy( dst, src + srcX + skipX, width );
+        else
+            MaskRow( dst, src + srcX + skipX, width );
+    }
+}
+
+void SoftRender::Clear( ALLEGRO_COLOR color )
+{
+    memset( framebuffer, FindColorIndex( color ), sizeof framebuffer );
+}
+
+void SoftRender::DrawBitmapRegion( 
+    ALLEGRO_BITMAP* bitmap, 
+    int srcX, 
+    int srcY, 
+    int width, 
+    int height, 
+    int destX, 
+    int destY, 
+    int flags )
+{
+    IndexedImage* image = GetImage( bitmap );
+
+    if ( image != nullptr )
+        BlitImage( *image, -1, srcX, srcY, width, height, destX, destY, flags );
+}
+
+void SoftRender::DrawTintedBitmapRegion( 
+    ALLEGRO_BITMAP* bitmap, 
+    ALLEGRO_COLOR tint, 
+    int srcX, 
+    int srcY, 
+    int width, 
+    int height, 
+    int destX, 
+    int destY, 
+    int flags )
+{
+    IndexedImage* image = GetImage( bitmap );
+
+    if ( image != nullptr )
+        BlitImage( *image, FindColorIndex( tint ), srcX, srcY, width, height, destX, destY, flags );
+}
+
+void SoftRender::DrawFilledRectangle( int x, int y, int width, int height, ALLEGRO_COLOR color )
+{
+    int skipX = 0;
+    int skipY = 0;
+
+    if ( !ClipRect( x, y, width, height, skipX, skipY ) )
+        return;
+
+    uint8_t index = FindColorIndex( color );
+
+    for ( int row = 0; row < height; row++ )
+    {
+        FillRow( framebuffer[y + row] + x, width, index );
+    }
+}
+
+
+//----------------------------------------------------------------------------
+//  Presenting
+//----------------------------------------------------------------------------
+
+static void ExpandRow( const uint8_t* src, uint32_t* dst, int scale )
+{
+    int i = 0;
+
+    if ( scale == 1 )
+    {
+        for ( ; i < SoftRender::Width; i++ )
+            dst[i] = paletteArgb[src[i]];
+        return;
+    }
+
+#if SOFTRENDER_SSE2
+    if ( scale == 2 )
+    {
+        for ( ; i < SoftRender::Width; i += 4 )
+        {
+            __m128i c = _mm_setr_epi32( 
+                paletteArgb[src[i]], 
+                paletteArgb[src[i + 1]], 
+                paletteArgb[src[i + 2]], 
+                paletteArgb[src[i + 3]] );
+
+            _mm_storeu_si128( (__m128i*) (dst + i * 2), _mm_unpacklo_epi32( c, c ) );
+            _mm_storeu_si128( (__m128i*) (dst + i * 2 + 4), _mm_unpackhi_epi32( c, c ) );
+        }
+        return;
+    }
+#endif
+
+    for ( ; i < SoftRender::Width; i++ )
+    {
+        uint32_t c = paletteArgb[src[i]];
+
+        for ( int j = 0; j < scale; j++ )
+            *dst++ = c;
+    }
+}
+
+void SoftRender::Present()
+{
+    ALLEGRO_BITMAP* target = al_get_target_bitmap();
+    const ALLEGRO_TRANSFORM* transform = al_get_current_transform();
+    int scale = 1;
+    int offsetX = 0;
+    int offsetY = 0;
+
+    if ( transform != nullptr )
+    {
+        scale = (int) transform->m[0][0];
+        offsetX = (int) transform->m[3][0];
+        offsetY = (int) transform->m[3][1];
+    }
+
+    if ( scale < 1 )
+        scale = 1;
+    else if ( scale > MaxScale )
+        scale = MaxScale;
+
+    LoadPalette();
+
+    ALLEGRO_LOCKED_REGION* region = al_lock_bitmap_region( 
+        target, 
+        offsetX, 
+        offsetY, 
+        Width * scale, 
+        Height * scale, 
+        ALLEGRO_PIXEL_FORMAT_ARGB_8888, 
+        ALLEGRO_LOCK_WRITEONLY );
+    if ( region == nullptr )
+        return;
+
+    size_t rowSize = Width * scale * sizeof scaledRow[0];
+
+    for ( int y = 0; y < Height; y++ )
+    {
+        ExpandRow( framebuffer[y], scaledRow, scale );
+
+        for ( int j = 0; j < scale; j++ )
+        {
+            uint8_t* dst = (uint8_t*) region->data + (y * scale + j) * region->pitch;
+
+            memcpy( dst, scaledRow, rowSize );
+        }
+    }
+
+    al_unlock_bitmap( target );
+}
+
+const uint8_t* SoftRender::GetFramebuffer()
+{
+    return &framebuffer[0][0];
+}
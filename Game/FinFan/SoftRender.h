@@ -0,0 +1,71 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+
+// Composes the view on the CPU into a framebuffer of NES color indexes.
+// Bitmaps are converted to color indexes the first time they're drawn.
+// Presenting converts the framebuffer to colors and scales it to the
+// target in one pass, so frames are the same on every machine.
+//
+// Only sub-bitmaps (see Atlas) can be drawn: the region they refer to 
+// never changes, so their converted pixels can be kept. They're found by 
+// the address of their parent, so a parent must be invalidated before it's 
+// destroyed; another bitmap could get the same address later.
+
+class SoftRender
+{
+public:
+    static const int Width = StdViewWidth;
+    static const int Height = StdViewHeight;
+    static const uint8_t Transparent = 0xFF;
+
+    // Turned on with the softRender option
+    static bool Init();
+    static void Uninit();
+    static bool IsActive();
+
+    static bool CanDraw( ALLEGRO_BITMAP* bitmap );
+
+    // Forgets the converted pixels of all the sub-bitmaps of a parent
+    static void Invalidate( ALLEGRO_BITMAP* parent );
+
+    static void Clear( ALLEGRO_COLOR color );
+
+    static void DrawBitmapRegion( 
+        ALLEGRO_BITMAP* bitmap, 
+        int srcX, 
+        int srcY, 
+        int width, 
+        int height, 
+        int destX, 
+        int destY, 
+        int flags );
+
+    // All the opaque pixels of the bitmap are drawn in the tint color. 
+    // This is meant for one-color art, like glyphs.
+    static void DrawTintedBitmapRegion( 
+        ALLEGRO_BITMAP* bitmap, 
+        ALLEGRO_COLOR tint, 
+        int srcX, 
+        int srcY, 
+        int width, 
+        int height, 
+        int destX, 
+        int destY, 
+        int flags );
+
+    static void DrawFilledRectangle( int x, int y, int width, int height, ALLEGRO_COLOR color );
+
+    // Draws the framebuffer to the target bitmap, at the position and 
+    // whole scale of the target's transform
+    static void Present();
+
+    // Width * Height color indexes
+    static const uint8_t* GetFramebuffer();
+};
@@ -7,12 +7,15 @@
 
 #include "Common.h"
 #include "Sound.h"
+#include "SoftMixer.h"
+#include "Config.h"
 #include <allegro5\allegro_audio.h>
 
 
 const int Streams = 4;
 const int UserStreams = 2;
 const int Songs = 24;
+const int EffectVoices = SoftMixer::Voices;
 
 
 struct LoopPoints
@@ -22,41 +25,81 @@ struct LoopPoints
     int16_t End;
 };
 
+// Each user stream is backed by a low and a high priority stream. PushTrack
+// plays a track on the high one and pauses the low one until it finishes.
+
+enum StreamState
+{
+    Stream_LoPri,
+    Stream_HiPri,
+};
+
+struct EffectSpec
+{
+    // A voice can only be stolen by an effect of the same or higher priority.
+    // Triggers of the same effect closer together than the cooldown (in frames)
+    // are coalesced into the one already playing.
+    int8_t  Priority;
+    uint8_t Cooldown;
+};
+
+struct EffectVoice
+{
+    ALLEGRO_SAMPLE_INSTANCE* Instance;
+    int EffectId;
+    int Priority;
+    int StartFrame;
+    bool Loop;
+};
+
 
 static ALLEGRO_VOICE* defaultVoice;
 static ALLEGRO_MIXER* defaultMixer;
+static ALLEGRO_EVENT_QUEUE* eventQueue;
 static ALLEGRO_AUDIO_STREAM* streams[Streams];
+static StreamState streamStates[UserStreams];
 static double savedPos[UserStreams];
-static ALLEGRO_SAMPLE_INSTANCE* defaultInstance;
+static EffectVoice effectVoices[EffectVoices];
 static ALLEGRO_SAMPLE* effectSamples[SEffect_Max];
+static int nextEffectFrame[SEffect_Max];
 static LoopPoints songLoops[Songs];
+static SoundStats soundStats;
+
+// Songs are looked up first as FLAC, then as WAV. FLAC is decoded on Allegro's
+// stream thread as it plays, the same as WAV is read from disk.
+
+static const char* songExts[] = 
+{
+    ".flac",
+    ".wav",
+};
 
 static const char* songFiles[] = 
 {
-    "01_prelude.wav",
-    "02_opening.wav",
-    "03_ending.wav",
-    "04_field.wav",
-    "05_ship.wav",
-    "06_airship.wav",
-    "07_town.wav",
-    "08_castle.wav",
-    "09_volcano.wav",
-    "10_matoya.wav",
-    "11_dungeon.wav",
-    "12_temple.wav",
-    "13_sky.wav",
-    "14_sea_shrine.wav",
-    "15_shop.wav",
-    "16_battle.wav",
-    "17_menu.wav",
-    "18_dead.wav",
-    "19_victory.wav",
-    "20_fanfare.wav",
-    "21_unknown.wav",
-    "22_save.wav",
-    "23_unknown.wav",
-    "24_chaos_rumble.wav",
+    "01_prelude",
+    "02_opening",
+    "03_ending",
+    "04_field",
+    "05_ship",
+    "06_airship",
+    "07_town",
+    "08_castle",
+    "09_volcano",
+    "10_matoya",
+    "11_dungeon",
+    "12_temple",
+    "13_sky",
+    "14_sea_shrine",
+    "15_shop",
+    "16_battle",
+    "17_menu",
+    "18_dead",
+    "19_victory",
+    "20_fanfare",
+    "21_unknown",
+    "22_save",
+    "23_unknown",
+    "24_chaos_rumble",
 };
 
 static const char* effectFiles[SEffect_Max] = 
@@ -78,12 +121,40 @@ static const char* effectFiles[SEffect_Max] =
     "ff1-sfx-lava.wav",
 };
 
+static const EffectSpec effectSpecs[SEffect_Max] = 
+{
+    { 1, 2 },   // Confirm
+    { 0, 2 },   // Cursor
+    { 2, 0 },   // Door
+    { 1, 2 },   // Error
+    { 3, 0 },   // Fight
+    { 2, 2 },   // Hurt
+    { 2, 0 },   // Magic
+    { 2, 0 },   // Potion
+    { 0, 2 },   // Step
+    { 2, 2 },   // Strike
+    { 1, 0 },   // Sea
+    { 3, 0 },   // Lift
+    { 3, 0 },   // Land
+    { 1, 0 },   // Airship
+    { 1, 2 },   // Lava
+};
+
 
 static void PlayTrackInternal( int trackId, int streamId, bool loop, bool play )
 {
     al_destroy_audio_stream( streams[streamId] );
+    streams[streamId] = nullptr;
+
+    for ( int i = 0; i < _countof( songExts ) && streams[streamId] == nullptr; i++ )
+    {
+        char filename[MAX_PATH] = "";
+
+        sprintf_s( filename, "%s%s", songFiles[trackId], songExts[i] );
+
+        streams[streamId] = al_load_audio_stream( filename, 2, 2048 );
+    }
 
-    streams[streamId] = al_load_audio_stream( songFiles[trackId], 2, 2048 );
     if ( streams[streamId] == nullptr )
         return;
 
@@ -114,10 +185,89 @@ static void PlayTrackInternal( int trackId, int streamId, bool loop, bool play )
 
     al_set_audio_stream_playmode( streams[streamId], playMode );
     al_set_audio_stream_playing( streams[streamId], play );
+
+    // Finishing is only interesting for high priority streams. Destroying
+    // the stream takes its event source out of the queue.
+
+    if ( streamId >= UserStreams )
+        al_register_event_source( eventQueue, al_get_audio_stream_event_source( streams[streamId] ) );
+}
+
+static void InitSoftMixer()
+{
+    int bufferFrames = SoftMixer::DefaultBufferFrames;
+
+    Config::GetInt( "mixerBufferFrames", bufferFrames );
+
+    for ( int i = 0; i < SEffect_Max; i++ )
+    {
+        if ( !SoftMixer::CanPlay( effectSamples[i] ) )
+            return;
+    }
+
+    // If it can't start, then effects go through Allegro's mixer as usual.
+
+    if ( !SoftMixer::Init( bufferFrames ) )
+        SoftMixer::Uninit();
+}
+
+static bool IsVoicePlaying( int index )
+{
+    if ( SoftMixer::IsActive() )
+        return SoftMixer::IsVoicePlaying( index );
+
+    return al_get_sample_instance_playing( effectVoices[index].Instance );
+}
+
+static void StartVoice( int index, int effectId, bool loop )
+{
+    if ( SoftMixer::IsActive() )
+    {
+        SoftMixer::StartVoice( index, effectSamples[effectId], loop );
+        return;
+    }
+
+    ALLEGRO_SAMPLE_INSTANCE* instance = effectVoices[index].Instance;
+
+    al_set_sample( instance, effectSamples[effectId] );
+
+    ALLEGRO_PLAYMODE playMode = ALLEGRO_PLAYMODE_ONCE;
+
+    if ( loop )
+        playMode = ALLEGRO_PLAYMODE_LOOP;
+
+    al_set_sample_instance_playmode( instance, playMode );
+    al_play_sample_instance( instance );
 }
 
-bool Sound::Init()
+static void StopVoice( int index )
 {
+    if ( SoftMixer::IsActive() )
+        SoftMixer::StopVoice( index );
+    else
+        al_stop_sample_instance( effectVoices[index].Instance );
+}
+
+static void ResumeLoPriStream( int streamId )
+{
+    int hiPriStream = UserStreams + streamId;
+
+    al_destroy_audio_stream( streams[hiPriStream] );
+    streams[hiPriStream] = nullptr;
+
+    streamStates[streamId] = Stream_LoPri;
+
+    if ( streams[streamId] != nullptr )
+    {
+        al_seek_audio_stream_secs( streams[streamId], savedPos[streamId] );
+        al_set_audio_stream_playing( streams[streamId], true ); 
+    }
+}
+
+bool Sound::Init( ALLEGRO_EVENT_QUEUE* eventQueue )
+{
+    ::eventQueue = eventQueue;
+
     defaultVoice = al_create_voice( 44100, ALLEGRO_AUDIO_DEPTH_INT16, ALLEGRO_CHANNEL_CONF_2 );
     if ( defaultVoice == nullptr )
         return false;
@@ -129,12 +279,20 @@ bool Sound::Init()
     if ( !al_attach_mixer_to_voice( defaultMixer, defaultVoice ) )
         return false;
 
-    defaultInstance = al_create_sample_instance( nullptr );
-    if ( defaultInstance == nullptr )
-        return false;
+    // All the effect voices are made up front, so that playing an effect
+    // only has to pick one and set its sample.
 
-    if ( !al_attach_sample_instance_to_mixer( defaultInstance, defaultMixer ) )
-        return false;
+    for ( int i = 0; i < EffectVoices; i++ )
+    {
+        effectVoices[i].Instance = al_create_sample_instance( nullptr );
+        if ( effectVoices[i].Instance == nullptr )
+            return false;
+
+        if ( !al_attach_sample_instance_to_mixer( effectVoices[i].Instance, defaultMixer ) )
+            return false;
+
+        effectVoices[i].EffectId = -1;
+    }
 
     for ( int i = 0; i < SEffect_Max; i++ )
     {
@@ -146,17 +304,27 @@ bool Sound::Init()
     if ( !LoadList( "loopPoints.dat", songLoops, Songs ) )
         return false;
 
+    bool softMixer = false;
+
+    if ( Config::GetBool( "softMixer", softMixer ) && softMixer )
+        InitSoftMixer();
+
     return true;
 }
 
 void Sound::Uninit()
 {
+    SoftMixer::Uninit();
+
     for ( int i = 0; i < SEffect_Max; i++ )
     {
         al_destroy_sample( effectSamples[i] );
     }
 
-    al_destroy_sample_instance( defaultInstance );
+    for ( int i = 0; i < EffectVoices; i++ )
+    {
+        al_destroy_sample_instance( effectVoices[i].Instance );
+    }
 
     for ( int i = 0; i < Streams; i++ )
     {
@@ -167,24 +335,22 @@ void Sound::Uninit()
     al_destroy_voice( defaultVoice );
 }
 
-void Sound::Update()
+void Sound::HandleEvent( const ALLEGRO_EVENT& event )
 {
-    for ( int i = UserStreams; i < Streams; i++ )
-    {
-        if ( streams[i] == nullptr
-            || al_get_audio_stream_playing( streams[i] ) )
-            continue;
+    if ( event.any.type != ALLEGRO_EVENT_AUDIO_STREAM_FINISHED )
+        return;
 
-        int loPriStream = i - UserStreams;
+    for ( int i = 0; i < UserStreams; i++ )
+    {
+        int hiPriStream = UserStreams + i;
 
-        al_destroy_audio_stream( streams[i] );
-        streams[i] = nullptr;
+        if ( streamStates[i] != Stream_HiPri
+            || streams[hiPriStream] == nullptr
+            || event.any.source != al_get_audio_stream_event_source( streams[hiPriStream] ) )
+            continue;
 
-        if ( streams[loPriStream] != nullptr )
-        {
-            al_seek_audio_stream_secs( streams[loPriStream], savedPos[loPriStream] );
-            al_set_audio_stream_playing( streams[loPriStream], true ); 
-        }
+        ResumeLoPriStream( i );
+        break;
     }
 }
 
@@ -195,14 +361,14 @@ void Sound::PlayTrack( int trackId, int streamId, bool loop )
     if ( trackId < 0 || trackId >= _countof( songFiles ) )
         return;
 
-    int hiPriStream = UserStreams + streamId;
-
-    if ( streams[hiPriStream] == nullptr || !al_get_audio_stream_playing( streams[hiPriStream] ) )
+    if ( streamStates[streamId] == Stream_LoPri )
     {
         PlayTrackInternal( trackId, streamId, loop, true );
         return;
     }
 
+    // Wait for the high priority track to finish, then start from the top.
+
     PlayTrackInternal( trackId, streamId, loop, false );
     savedPos[streamId] = 0;
 }
@@ -214,7 +380,7 @@ void Sound::PushTrack( int trackId, int streamId )
     if ( trackId < 0 || trackId >= _countof( songFiles ) )
         return;
 
-    if ( streams[streamId] != nullptr && al_get_audio_stream_playing( streams[streamId] ) )
+    if ( streamStates[streamId] == Stream_LoPri && streams[streamId] != nullptr )
     {
         savedPos[streamId] = al_get_audio_stream_position_secs( streams[streamId] );
         al_set_audio_stream_playing( streams[streamId], false );
@@ -223,6 +389,56 @@ void Sound::PushTrack( int trackId, int streamId )
     int hiPriStream = UserStreams + streamId;
 
     PlayTrackInternal( trackId, hiPriStream, false, true );
+
+    if ( streams[hiPriStream] == nullptr )
+    {
+        ResumeLoPriStream( streamId );
+        return;
+    }
+
+    streamStates[streamId] = Stream_HiPri;
+}
+
+static EffectVoice* GetEffectVoice( int id, int priority )
+{
+    EffectVoice* freeVoice = nullptr;
+    EffectVoice* victim = nullptr;
+
+    for ( int i = 0; i < EffectVoices; i++ )
+    {
+        EffectVoice* voice = &effectVoices[i];
+
+        if ( !IsVoicePlaying( i ) )
+        {
+            if ( freeVoice == nullptr )
+                freeVoice = voice;
+            continue;
+        }
+
+        // Reuse the voice of an effect that's still playing instead of 
+        // layering it. A second looping voice could never be stopped.
+
+        if ( voice->EffectId == id )
+            return voice;
+
+        // Looping effects are stopped explicitly; they're never stolen.
+
+        if ( voice->Loop || voice->Priority > priority )
+            continue;
+
+        if ( victim == nullptr
+            || voice->Priority < victim->Priority
+            || (voice->Priority == victim->Priority && voice->StartFrame < victim->StartFrame) )
+            victim = voice;
+    }
+
+    if ( freeVoice != nullptr )
+        return freeVoice;
+
+    if ( victim != nullptr )
+        soundStats.EffectSteals++;
+
+    return victim;
 }
 
 void Sound::PlayEffect( int id, bool loop )
@@ -230,18 +446,60 @@ void Sound::PlayEffect( int id, bool loop )
     if ( id < 0 || id >= _countof( effectSamples ) )
         return;
 
-    al_set_sample( defaultInstance, effectSamples[id] );
+    int frame = GetFrameCounter();
 
-    ALLEGRO_PLAYMODE playMode = ALLEGRO_PLAYMODE_ONCE;
+    if ( frame < nextEffectFrame[id] )
+    {
+        soundStats.EffectsCoalesced++;
+        return;
+    }
 
-    if ( loop )
-        playMode = ALLEGRO_PLAYMODE_LOOP;
+    nextEffectFrame[id] = frame + effectSpecs[id].Cooldown;
+
+    EffectVoice* voice = GetEffectVoice( id, effectSpecs[id].Priority );
+    if ( voice == nullptr )
+    {
+        soundStats.EffectsDropped++;
+        return;
+    }
+
+    int index = voice - effectVoices;
+
+    // A loop that's already going keeps going, instead of starting over
+
+    if ( loop && voice->Loop && voice->EffectId == id && IsVoicePlaying( index ) )
+        return;
 
-    al_set_sample_instance_playmode( defaultInstance, playMode );
-    al_play_sample_instance( defaultInstance );
+    voice->EffectId = id;
+    voice->Priority = effectSpecs[id].Priority;
+    voice->StartFrame = frame;
+    voice->Loop = loop;
+
+    StartVoice( index, id, loop );
+
+    int inUse = 0;
+
+    for ( int i = 0; i < EffectVoices; i++ )
+    {
+        if ( IsVoicePlaying( i ) )
+            inUse++;
+    }
+
+    if ( inUse > soundStats.MostEffectVoicesInUse )
+        soundStats.MostEffectVoicesInUse = inUse;
 }
 
 void Sound::StopEffect()
 {
-    al_stop_sample_instance( defaultInstance );
+    for ( int i = 0; i < EffectVoices; i++ )
+    {
+        StopVoice( i );
+    }
+}
+
+void Sound::GetStats( SoundStats& stats )
+{
+    stats = soundStats;
+
+    SoftMixer::GetCounters( stats.MixerUnderruns, stats.MixerOverruns );
 }
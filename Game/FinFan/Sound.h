@@ -58,17 +58,31 @@ enum SEffectId
 };
 
 
+struct SoundStats
+{
+    // The most effect voices that have played at once
+    int MostEffectVoicesInUse;
+    int EffectSteals;
+    int EffectsCoalesced;
+    int EffectsDropped;
+    int MixerUnderruns;
+    int MixerOverruns;
+};
+
+
 class Sound
 {
 public:
-    static bool Init();
+    static bool Init( ALLEGRO_EVENT_QUEUE* eventQueue );
     static void Uninit();
 
-    static void Update();
+    static void HandleEvent( const ALLEGRO_EVENT& event );
 
     static void PlayTrack( int id, int stream, bool loop );
     static void PushTrack( int id, int stream );
 
     static void PlayEffect( int id, bool loop = false );
     static void StopEffect();
+
+    static void GetStats( SoundStats& stats );
 };
@@ -7,6 +7,7 @@
 
 #include "Common.h"
 #include "Sprite.h"
+#include "DrawList.h"
 
 
 const int DefaultTimer = 8;
@@ -112,7 +113,7 @@ void Sprite::DrawAt( int screenX, int screenY )
     if ( flash && frameTime < 4 )
         return;
 
-    al_draw_bitmap_region(
+    DrawList::DrawBitmapRegion(
         bmp,
         frames[frame].X,
         frames[frame].Y,
@@ -72,6 +72,9 @@ void IntroScene::Draw()
         Text::DrawDialogString( lines[i], LinesX, LinesY + i * 16, "" );
     }
 
+    // Only the line that's coming in fades, not the whole view, so it's
+    // drawn tinted instead of being shaded by the Presenter.
+
     if ( visibleLines < TextLines )
     {
         int j = visibleLines;
@@ -176,6 +179,9 @@ void StoryBox::Draw()
     int alpha = 255;
     ALLEGRO_COLOR color;
 
+    // The text fades in over the picture behind it, so it's drawn tinted
+    // instead of being shaded by the Presenter, which shades the whole view
+
     if ( timer > PageFrames - LineFrames )
     {
         int value = (PageFrames - timer);
@@ -259,8 +265,11 @@ TheEndAnim::TheEndAnim()
         x( TheEndStartX ),
         y( TheEndStartY ),
         xfill( 0 ),
-        progPtr( theEndProg )
+        progPtr( theEndProg ),
+        dirtyTop( 0 ),
+        dirtyBottom( TheEndPicSize )
 {
+    memset( pixels, 0, sizeof pixels );
 }
 
 TheEndAnim::~TheEndAnim()
@@ -280,16 +289,15 @@ void TheEndAnim::Init()
     if ( !LoadList( "theEndMask.dat", theEndMask, TheEndMaskSize ) )
         return;
 
-    theEndPic = al_create_bitmap( 80, 80 );
+    theEndPic = al_create_bitmap( TheEndPicSize, TheEndPicSize );
     if ( theEndPic == nullptr )
         return;
+
+    UploadPixels();
 }
 
 void TheEndAnim::Update()
 {
-    ALLEGRO_BITMAP* origBmp = al_get_target_bitmap();
-    al_set_target_bitmap( theEndPic );
-
     if ( state == Outline )
     {
         if ( *progPtr == 0 )
@@ -334,14 +342,14 @@ void TheEndAnim::Update()
         }
     }
 
-    al_set_target_bitmap( origBmp );
+    UploadPixels();
 }
 
 void TheEndAnim::UpdateFillLine()
 {
     xfill--;
 
-    if ( xfill < 0 || al_get_pixel( theEndPic, xfill, y ).a != 0 )
+    if ( xfill < 0 || pixels[y][xfill] != 0 )
     {
         state = Trace;
         MovePen();
@@ -354,6 +362,9 @@ void TheEndAnim::UpdateFillLine()
 
 void TheEndAnim::Draw()
 {
+    if ( theEndPic == nullptr )
+        return;
+
     al_draw_bitmap( theEndPic, 64, 40, 0 );
 }
 
@@ -376,7 +387,55 @@ void TheEndAnim::MovePen()
 
 void TheEndAnim::DrawPixel( int x, int y )
 {
-    al_put_pixel( x + 0.5, y + 0.5, Color::White() );
+    if ( x < 0 || x >= TheEndPicSize || y < 0 || y >= TheEndPicSize )
+        return;
+
+    pixels[y][x] = 1;
+
+    if ( dirtyTop >= dirtyBottom )
+    {
+        dirtyTop = y;
+        dirtyBottom = y + 1;
+    }
+    else if ( y < dirtyTop )
+    {
+        dirtyTop = y;
+    }
+    else if ( y >= dirtyBottom )
+    {
+        dirtyBottom = y + 1;
+    }
+}
+
+void TheEndAnim::UploadPixels()
+{
+    if ( theEndPic == nullptr || dirtyTop >= dirtyBottom )
+        return;
+
+    // whole rows are written, so the lock doesn't have to read anything back
+    ALLEGRO_LOCKED_REGION* region = al_lock_bitmap_region( 
+        theEndPic, 
+        0, 
+        dirtyTop, 
+        TheEndPicSize, 
+        dirtyBottom - dirtyTop, 
+        ALLEGRO_PIXEL_FORMAT_ARGB_8888, 
+        ALLEGRO_LOCK_WRITEONLY );
+    if ( region == nullptr )
+        return;
+
+    for ( int row = dirtyTop; row < dirtyBottom; row++ )
+    {
+        uint32_t* dst = (uint32_t*) ((uint8_t*) region->data + (row - dirtyTop) * region->pitch);
+
+        for ( int col = 0; col < TheEndPicSize; col++ )
+            dst[col] = pixels[row][col] != 0 ? 0xFFFFFFFF : 0;
+    }
+
+    al_unlock_bitmap( theEndPic );
+
+    dirtyTop = 0;
+    dirtyBottom = 0;
 }
 
 
@@ -89,6 +89,7 @@ class TheEndAnim
         TheEndMaskSize  = 0x50,
         TheEndStartX    = 0xC,
         TheEndStartY    = 0,
+        TheEndPicSize   = 80,
     };
 
     enum State
@@ -108,6 +109,12 @@ class TheEndAnim
     uint8_t theEndProg[TheEndProgSize];
     uint8_t theEndMask[TheEndMaskSize];
 
+    // The picture is drawn and filled here, and only the rows that changed 
+    // are copied to theEndPic, once a frame
+    uint8_t pixels[TheEndPicSize][TheEndPicSize];
+    int dirtyTop;
+    int dirtyBottom;
+
 public:
     TheEndAnim();
     ~TheEndAnim();
@@ -119,6 +126,7 @@ public:
 private:
     void MovePen();
     void DrawPixel( int x, int y );
+    void UploadPixels();
 
     void UpdateFillLine();
 };
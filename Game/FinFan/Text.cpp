@@ -7,6 +7,9 @@
 
 #include "Common.h"
 #include "Text.h"
+#include "Atlas.h"
+#include "DrawList.h"
+#include "SoftRender.h"
 #include <allegro5\allegro_primitives.h>
 
 
@@ -19,13 +22,62 @@ namespace Text
     };
 
 
+    // Single line strings are drawn into slots of a cache bitmap the first
+    // time they're seen. After that, each one is drawn with one blit from the
+    // same texture, so that a screen full of labels batches together.
+    // Tinting is applied when blitting, so it isn't part of the key.
+
+    struct GlyphRun
+    {
+        uint32_t Hash;
+        uint32_t LastUsed;
+        int FontId;
+        int Length;
+        char Chars[32];
+    };
+
+
+    // Windows are drawn once into a bitmap of their size, and blitted after
+    // that. The opening animation of a window shows the top part of the
+    // same image.
+
+    struct BoxImage
+    {
+        int Width;
+        int Height;
+        uint32_t LastUsed;
+        ALLEGRO_BITMAP* Bitmap;
+    };
+
+
     const ALLEGRO_COLOR White = al_map_rgb_f( 1, 1, 1 );
 
+    const int RunSlotWidth = 256;
+    const int RunSlotHeight = 8;
+    const int RunMaxLength = RunSlotWidth / 8;
+    const int RunCacheWidth = 512;
+    const int RunCacheHeight = 512;
+    const int RunSlotCols = RunCacheWidth / RunSlotWidth;
+    const int RunSlots = RunSlotCols * (RunCacheHeight / RunSlotHeight);
+    const int BoxImages = 16;
+
 
     ALLEGRO_BITMAP* font;
     ALLEGRO_BITMAP* fontB;
     Point fontChars[128];
 
+    ALLEGRO_BITMAP* runCache;
+    GlyphRun runs[RunSlots];
+    uint32_t runClock;
+
+    BoxImage boxImages[BoxImages];
+    uint32_t boxClock;
+    bool cachesEnabled = true;
+
+#if defined( TEXT_BENCHMARK )
+    int drawCallCount;
+#endif
+
 
     bool LoadDataFile( const char* path, void* buffer, size_t length )
     {
@@ -48,17 +100,21 @@ namespace Text
 
     bool Init()
     {
-        font = al_load_bitmap( "font.png" );
+        font = Atlas::Load( "font.png" );
         if ( font == nullptr )
             return false;
 
-        fontB = al_load_bitmap( "fontB.png" );
+        fontB = Atlas::Load( "fontB.png" );
         if ( fontB == nullptr )
             return false;
 
         if ( !LoadDataFile( "main.mfont", fontChars, sizeof fontChars ) )
             return false;
 
+        // Without the cache, strings are drawn a glyph at a time.
+
+        runCache = al_create_bitmap( RunCacheWidth, RunCacheHeight );
+
         return true;
     }
 
@@ -75,6 +131,161 @@ namespace Text
             al_destroy_bitmap( fontB );
             fontB = nullptr;
         }
+
+        if ( runCache != nullptr )
+        {
+            al_destroy_bitmap( runCache );
+            runCache = nullptr;
+        }
+
+        for ( int i = 0; i < BoxImages; i++ )
+        {
+            if ( boxImages[i].Bitmap != nullptr )
+            {
+                al_destroy_bitmap( boxImages[i].Bitmap );
+                boxImages[i] = BoxImage();
+            }
+        }
+    }
+
+    // Only the benchmark reads the count
+    void CountDrawCalls( int count )
+    {
+#if defined( TEXT_BENCHMARK )
+        drawCallCount += count;
+#endif
+    }
+
+    ALLEGRO_BITMAP* GetFont( int fontId )
+    {
+        if ( fontId == 1 )
+            return fontB;
+        else
+            return font;
+    }
+
+    uint32_t HashRun( const char* str, int length, int fontId )
+    {
+        uint32_t hash = 2166136261U ^ fontId;
+
+        for ( int i = 0; i < length; i++ )
+        {
+            hash ^= (uint8_t) str[i];
+            hash *= 16777619U;
+        }
+
+        return hash;
+    }
+
+    void RenderRun( int slot )
+    {
+        const GlyphRun& run = runs[slot];
+        ALLEGRO_BITMAP* f = GetFont( run.FontId );
+        ALLEGRO_BITMAP* origBmp = al_get_target_bitmap();
+        bool held = al_is_bitmap_drawing_held();
+        int slotX = (slot % RunSlotCols) * RunSlotWidth;
+        int slotY = (slot / RunSlotCols) * RunSlotHeight;
+
+        al_hold_bitmap_drawing( false );
+        al_set_target_bitmap( runCache );
+
+        al_set_clipping_rectangle( slotX, slotY, RunSlotWidth, RunSlotHeight );
+        al_clear_to_color( al_map_rgba( 0, 0, 0, 0 ) );
+
+        al_hold_bitmap_drawing( true );
+
+        for ( int i = 0; i < run.Length; i++ )
+        {
+            char c = run.Chars[i];
+
+            al_draw_bitmap_region(
+                f,
+                fontChars[c].X,
+                fontChars[c].Y,
+                8,
+                8,
+                slotX + i * 8,
+                slotY,
+                0 );
+        }
+
+        al_hold_bitmap_drawing( false );
+        al_reset_clipping_rectangle();
+
+        al_set_target_bitmap( origBmp );
+        al_hold_bitmap_drawing( held );
+
+        CountDrawCalls( run.Length );
+    }
+
+    int GetRunSlot( const char* str, int length, int fontId )
+    {
+        uint32_t hash = HashRun( str, length, fontId );
+        int victim = 0;
+
+        runClock++;
+
+        for ( int i = 0; i < RunSlots; i++ )
+        {
+            GlyphRun& run = runs[i];
+
+            if ( run.Hash == hash 
+                && run.Length == length 
+                && run.FontId == fontId 
+                && memcmp( run.Chars, str, length ) == 0 )
+            {
+                run.LastUsed = runClock;
+                return i;
+            }
+
+            if ( run.LastUsed < runs[victim].LastUsed )
+                victim = i;
+        }
+
+        // Evict the least recently used run. Empty slots were never used, so
+        // they go first.
+
+        GlyphRun& run = runs[victim];
+
+        run.Hash = hash;
+        run.LastUsed = runClock;
+        run.FontId = fontId;
+        run.Length = length;
+        memcpy( run.Chars, str, length );
+
+        RenderRun( victim );
+
+        return victim;
+    }
+
+    // The run and box caches are bitmaps of their own, which SoftRender 
+    // can't draw. So, text in a list that it composes is drawn by glyph.
+
+    bool CanUseCaches()
+    {
+        return cachesEnabled && !(DrawList::IsOpen() && SoftRender::IsActive());
+    }
+
+    bool DrawCachedRun( const char* str, int length, int fontId, int x, int y, ALLEGRO_COLOR tint )
+    {
+        if ( runCache == nullptr || !CanUseCaches() || length == 0 || length > RunMaxLength )
+            return false;
+
+        int slot = GetRunSlot( str, length, fontId );
+
+        DrawList::DrawTintedBitmapRegion(
+            runCache,
+            tint,
+            (slot % RunSlotCols) * RunSlotWidth,
+            (slot / RunSlotCols) * RunSlotHeight,
+            length * 8,
+            8,
+            x,
+            y,
+            0 );
+
+        CountDrawCalls( 1 );
+        return true;
     }
 
     void DrawString( const char* str, int fontId, int x, int y, ALLEGRO_COLOR tint )
@@ -83,10 +294,14 @@ namespace Text
         const char* s = str;
         int origX = x;
 
-        if ( fontId == 1 )
-            f = fontB;
-        else
-            f = font;
+        int length = strcspn( str, "\n" );
+
+        if ( str[length] == '\0' && DrawCachedRun( str, length, fontId, x, y, tint ) )
+            return;
+
+        f = GetFont( fontId );
+
+        CountDrawCalls( strlen( str ) );
 
         al_hold_bitmap_drawing( true );
 
@@ -100,7 +315,7 @@ namespace Text
             }
             else
             {
-                al_draw_tinted_bitmap_region(
+                DrawList::DrawTintedBitmapRegion(
                     f,
                     tint,
                     fontChars[*s].X,
@@ -167,15 +382,19 @@ namespace Text
         while ( *s != '\0' )
             s++;
 
-        if ( fontId == 1 )
-            f = fontB;
-        else
-            f = font;
+        int length = s - str;
+
+        if ( DrawCachedRun( str, length, fontId, x - length * 8, y, tint ) )
+            return;
+
+        f = GetFont( fontId );
+
+        CountDrawCalls( length );
 
         for ( s--; s >= str; s-- )
         {
             x -= 8;
-            al_draw_tinted_bitmap_region(
+            DrawList::DrawTintedBitmapRegion(
                 f,
                 tint,
                 fontChars[*s].X,
@@ -204,7 +423,9 @@ namespace Text
 
     void DrawChar( char c, int x, int y, ALLEGRO_COLOR tint )
     {
-        al_draw_tinted_bitmap_region(
+        CountDrawCalls( 1 );
+
+        DrawList::DrawTintedBitmapRegion(
             font,
             tint,
             fontChars[c].X,
@@ -225,7 +446,7 @@ namespace Text
         }
     }
 
-    void DrawBox( int x, int y, int width, int height )
+    void DrawBoxGlyphs( int x, int y, int width, int height )
     {
         ALLEGRO_COLOR backColor = al_map_rgb( 0, 0, 252 );
         int middleHCount = width / 8 - 2;
@@ -233,7 +454,12 @@ namespace Text
         int lastRowY = y + height - 8;
         int lastColX = x + width - 8;
 
-        al_draw_filled_rectangle( x + 4, y + 4, x + width - 4, y + height - 4, backColor );
+        // In a list, rectangles are drawn after the bitmaps of their layer
+        DrawList::SetLayer( Layer_Window );
+        DrawList::DrawFilledRectangle( x + 4, y + 4, width - 8, height - 8, backColor );
+        CountDrawCalls( 1 );
+
+        DrawList::SetLayer( Layer_Text );
 
         al_hold_bitmap_drawing( true );
 
@@ -254,11 +480,8 @@ namespace Text
         al_hold_bitmap_drawing( false );
     }
 
-    void DrawBoxPart( int x, int y, int width, int height, int visHeight )
+    void DrawBoxPartGlyphs( int x, int y, int width, int height, int visHeight )
     {
-        if ( visHeight == 0 )
-            return;
-
         ALLEGRO_COLOR backColor = al_map_rgb( 0, 0, 252 );
         int middleHCount = width / 8 - 2;
         int middleVCount = visHeight / 8 - 1;
@@ -272,7 +495,11 @@ namespace Text
             fillHeight -= 4;
         }
 
-        al_draw_filled_rectangle( x + 4, y + 4, x + width - 4, y + 4 + fillHeight, backColor );
+        DrawList::SetLayer( Layer_Window );
+        DrawList::DrawFilledRectangle( x + 4, y + 4, width - 8, fillHeight, backColor );
+        CountDrawCalls( 1 );
+
+        DrawList::SetLayer( Layer_Text );
 
         al_hold_bitmap_drawing( true );
 
@@ -299,10 +526,270 @@ namespace Text
         al_hold_bitmap_drawing( false );
     }
 
+    ALLEGRO_BITMAP* GetBoxImage( int width, int height )
+    {
+        int victim = 0;
+
+        boxClock++;
+
+        for ( int i = 0; i < BoxImages; i++ )
+        {
+            BoxImage& image = boxImages[i];
+
+            if ( image.Bitmap != nullptr && image.Width == width && image.Height == height )
+            {
+                image.LastUsed = boxClock;
+                return image.Bitmap;
+            }
+
+            if ( image.LastUsed < boxImages[victim].LastUsed )
+                victim = i;
+        }
+
+        BoxImage& image = boxImages[victim];
+
+        if ( image.Bitmap != nullptr )
+            al_destroy_bitmap( image.Bitmap );
+
+        image = BoxImage();
+        image.Bitmap = al_create_bitmap( width, height );
+        if ( image.Bitmap == nullptr )
+            return nullptr;
+
+        image.Width = width;
+        image.Height = height;
+        image.LastUsed = boxClock;
+
+        ALLEGRO_BITMAP* origBmp = al_get_target_bitmap();
+        bool held = al_is_bitmap_drawing_held();
+
+        al_hold_bitmap_drawing( false );
+        al_set_target_bitmap( image.Bitmap );
+        al_clear_to_color( al_map_rgba( 0, 0, 0, 0 ) );
+
+        DrawBoxGlyphs( 0, 0, width, height );
+
+        al_set_target_bitmap( origBmp );
+        al_hold_bitmap_drawing( held );
+
+        return image.Bitmap;
+    }
+
+    bool DrawCachedBox( int x, int y, int width, int height, int visHeight )
+    {
+        if ( !CanUseCaches() || width < 16 || height < 16 )
+            return false;
+
+        ALLEGRO_BITMAP* bmp = GetBoxImage( width, height );
+        if ( bmp == nullptr )
+            return false;
+
+        DrawList::SetLayer( Layer_Window );
+        DrawList::DrawBitmapRegion( bmp, 0, 0, width, visHeight, x, y, 0 );
+        DrawList::SetLayer( Layer_Text );
+
+        CountDrawCalls( 1 );
+        return true;
+    }
+
+    void DrawBox( int x, int y, int width, int height )
+    {
+        if ( DrawCachedBox( x, y, width, height, height ) )
+            return;
+
+        DrawBoxGlyphs( x, y, width, height );
+    }
+
+    void DrawBoxPart( int x, int y, int width, int height, int visHeight )
+    {
+        if ( visHeight == 0 )
+            return;
+
+        // While it's opening, a window is its top rows without the bottom
+        // edge. That matches the full image when whole rows of tiles show.
+
+        if ( visHeight == height
+            || (visHeight % 8 == 0 && visHeight >= 8 && visHeight <= height - 8) )
+        {
+            if ( DrawCachedBox( x, y, width, height, visHeight ) )
+                return;
+        }
+
+        DrawBoxPartGlyphs( x, y, width, height, visHeight );
+    }
+
     void DrawCursor( int x, int y )
     {
         int sy = al_get_bitmap_height( font ) - 16;
 
-        al_draw_bitmap_region( font, 0, sy, 16, 16, x, y, 0 );
+        DrawList::DrawBitmapRegion( font, 0, sy, 16, 16, x, y, 0 );
+        CountDrawCalls( 1 );
+    }
+
+#if defined( TEXT_BENCHMARK )
+    struct BenchBox
+    {
+        int16_t X;
+        int16_t Y;
+        int16_t Width;
+        int16_t Height;
+    };
+
+    struct BenchScreen
+    {
+        const char* Name;
+        const BenchBox* Boxes;
+        int BoxCount;
+        const char* const* Lines;
+        int LineCount;
+    };
+
+    const BenchBox itemBoxes[] =
+    {
+        { 0, 0, 176, 24 },
+        { 176, 0, 80, 24 },
+        { 0, 24, 256, 176 },
+        { 0, 200, 256, 40 },
+    };
+
+    const BenchBox equipBoxes[] =
+    {
+        { 0, 0, 176, 24 },
+        { 176, 0, 80, 24 },
+        { 0, 24, 256, 96 },
+        { 0, 120, 128, 120 },
+        { 128, 120, 128, 120 },
+    };
+
+    const BenchBox mainBoxes[] =
+    {
+        { 0, 0, 80, 56 },
+        { 0, 56, 80, 96 },
+        { 0, 152, 80, 88 },
+        { 80, 0, 88, 120 },
+        { 168, 0, 88, 120 },
+        { 80, 120, 88, 120 },
+        { 168, 120, 88, 120 },
+    };
+
+    const char* const benchLines[] =
+    {
+        "ITEM",
+        "EQUIP",
+        "WEAPON",
+        "ARMOR",
+        "Cure  05",
+        "Tent  02",
+        "HP 35/ 35",
+        "G 400",
+    };
+
+    const BenchScreen benchScreens[] =
+    {
+        { "Item", itemBoxes, _countof( itemBoxes ), benchLines, _countof( benchLines ) },
+        { "Equip", equipBoxes, _countof( equipBoxes ), benchLines, 4 },
+        { "Main", mainBoxes, _countof( mainBoxes ), benchLines, _countof( benchLines ) },
+    };
+
+    void DrawBenchScreen( const BenchScreen& screen, int openRows )
+    {
+        for ( int i = 0; i < screen.BoxCount; i++ )
+        {
+            const BenchBox& box = screen.Boxes[i];
+
+            if ( openRows > 0 )
+                DrawBoxPart( box.X, box.Y, box.Width, box.Height, openRows * 8 );
+            else
+                DrawBox( box.X, box.Y, box.Width, box.Height );
+        }
+
+        for ( int i = 0; i < screen.LineCount; i++ )
+        {
+            DrawString( screen.Lines[i], 16, 8 + i * 16 );
+        }
+
+        DrawCursor( 0, 8 );
+    }
+
+    // Draws each screen the given number of times into an offscreen bitmap.
+    // Returns the CPU time taken per frame, and the draw calls of one frame.
+
+    double TimeBenchScreen( const BenchScreen& screen, int openRows, int frames, int& drawCalls )
+    {
+        ALLEGRO_BITMAP* origBmp = al_get_target_bitmap();
+        ALLEGRO_BITMAP* bmp = al_create_bitmap( 256, 240 );
+
+        if ( bmp == nullptr )
+            return 0;
+
+        al_set_target_bitmap( bmp );
+
+        double start = al_get_time();
+
+        for ( int i = 0; i < frames; i++ )
+        {
+            // A new frame resets the count
+            drawCallCount = 0;
+
+            al_clear_to_color( al_map_rgb( 0, 0, 0 ) );
+            al_hold_bitmap_drawing( true );
+            DrawBenchScreen( screen, openRows );
+            al_hold_bitmap_drawing( false );
+        }
+
+        // Wait for the GPU, so that the time covers the work that was queued
+        al_lock_bitmap( bmp, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY );
+        al_unlock_bitmap( bmp );
+
+        double end = al_get_time();
+
+        drawCalls = drawCallCount;
+
+        al_set_target_bitmap( origBmp );
+        al_destroy_bitmap( bmp );
+
+        return (end - start) / frames;
+    }
+
+    void RunBenchmark( const char* path )
+    {
+        const int Frames = 1000;
+        FILE* file = nullptr;
+
+        if ( fopen_s( &file, path, "w" ) != 0 )
+            return;
+
+        fprintf( file, "%-8s %-6s %10s %10s %10s %10s\n", 
+            "Screen", "Reveal", "Calls", "Calls", "us/frame", "us/frame" );
+        fprintf( file, "%-8s %-6s %10s %10s %10s %10s\n", 
+            "", "", "before", "after", "before", "after" );
+
+        for ( int i = 0; i < _countof( benchScreens ); i++ )
+        {
+            // 0 draws whole windows; 2 draws them partly open
+            for ( int openRows = 0; openRows <= 2; openRows += 2 )
+            {
+                int callsBefore = 0;
+                int callsAfter = 0;
+                double timeBefore;
+                double timeAfter;
+
+                cachesEnabled = false;
+                timeBefore = TimeBenchScreen( benchScreens[i], openRows, Frames, callsBefore );
+                cachesEnabled = true;
+                timeAfter = TimeBenchScreen( benchScreens[i], openRows, Frames, callsAfter );
+
+                fprintf( file, "%-8s %-6s %10d %10d %10.1f %10.1f\n", 
+                    benchScreens[i].Name, 
+                    openRows > 0 ? "part" : "full", 
+                    callsBefore, 
+                    callsAfter, 
+                    timeBefore * 1000000, 
+                    timeAfter * 1000000 );
+            }
+        }
+
+        fclose( file );
     }
+#endif
 }
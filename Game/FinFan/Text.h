@@ -31,8 +31,16 @@ namespace Text
     void DrawDialogString( const char* str, int x, int y, const char* itemName );
     void DrawDialogString( const char* str, int x, int y, const char* itemName, ALLEGRO_COLOR tint );
 
+    // A box is drawn on Layer_Window and Layer_Text of a draw list, and 
+    // leaves the list on Layer_Text
     void DrawBox( int x, int y, int width, int height );
     void DrawBoxPart( int x, int y, int width, int height, int visHeight );
 
     void DrawCursor( int x, int y );
+
+#if defined( TEXT_BENCHMARK )
+    // Compares the draw calls and time of menu screens with and without the
+    // text caches, and writes a table to the given file.
+    void RunBenchmark( const char* path );
+#endif
 }
@@ -7,6 +7,7 @@
 
 #include "Common.h"
 #include "VehicleSprites.h"
+#include "DrawList.h"
 
 
 const Bounds16 vehicleStandUpFrames[2] = 
@@ -251,7 +252,7 @@ void AirshipSprite::Update()
 
 void AirshipSprite::DrawAt( int screenX, int screenY )
 {
-    al_draw_bitmap_region( bitmap, 0, 12 * 16, 16, 16, screenX, screenY, 0 );
+    DrawList::DrawBitmapRegion( bitmap, 0, 12 * 16, 16, 16, screenX, screenY, 0 );
 
     sprite.DrawAt( screenX, screenY - liftY );
 }
@@ -0,0 +1,73 @@
+/*
+   Copyright 2016 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Stdafx.h"
+#include "FlacWriter.h"
+#include <msclr/marshal.h>
+#include "Flac_Writer.h"
+
+namespace ExtractNsf
+{
+    void CheckFlacError( const char* err )
+    {
+        if ( err == NULL )
+            return;
+
+        String^ message = gcnew String( err );
+        throw gcnew Exception( message );
+    }
+
+    FlacWriter::FlacWriter( int sampleRate, String^ filename )
+    {
+        msclr::interop::marshal_context context;
+        const char* nativePath = context.marshal_as<const char*>( filename );
+        writer = new Flac_Writer();
+
+        const char* err = writer->open( sampleRate, nativePath );
+        if ( err != NULL )
+        {
+            delete writer;
+            writer = NULL;
+            CheckFlacError( err );
+        }
+    }
+
+    FlacWriter::~FlacWriter()
+    {
+        this->!FlacWriter();
+    }
+
+    FlacWriter::!FlacWriter()
+    {
+        delete writer;
+        writer = NULL;
+    }
+
+    void FlacWriter::EnableStereo()
+    {
+        writer->enable_stereo();
+    }
+
+    void FlacWriter::Write( array<short>^ buffer, int count, int skip )
+    {
+        if ( count > buffer->Length )
+            throw gcnew Exception( "buffer is smaller than count" );
+
+        pin_ptr<short> pinnedBuf = &buffer[0];
+        CheckFlacError( writer->write( pinnedBuf, count, skip ) );
+    }
+
+    int FlacWriter::SampleCount::get()
+    {
+        return writer->sample_count();
+    }
+
+    void FlacWriter::Close()
+    {
+        CheckFlacError( writer->close() );
+    }
+}
@@ -0,0 +1,38 @@
+/*
+   Copyright 2016 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+class Flac_Writer;
+
+namespace ExtractNsf
+{
+    using namespace System;
+
+    // Takes the place of WaveWriter to get smaller music files. Samples are
+    // compressed and written out a block at a time as they come in.
+
+    public ref class FlacWriter
+    {
+        Flac_Writer* writer;
+
+    public:
+        FlacWriter( int sampleRate, String^ filename );
+        ~FlacWriter();
+
+        void EnableStereo();
+        void Write( array<short>^ buffer, int count, int skip );
+        property int SampleCount
+        {
+            int get();
+        }
+        void Close();
+
+    protected:
+        !FlacWriter();
+    };
+}
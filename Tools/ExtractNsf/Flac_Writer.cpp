@@ -0,0 +1,631 @@
+/*
+   Copyright 2016 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "Flac_Writer.h"
+#include <assert.h>
+#include <string.h>
+
+
+static const int StreamInfoSize = 34;
+static const int StreamHeaderSize = 4 + 4 + StreamInfoSize;
+
+
+static uint8_t Crc8( const uint8_t* data, uint32_t length )
+{
+    uint32_t crc = 0;
+
+    for ( uint32_t i = 0; i < length; i++ )
+    {
+        crc ^= data[i];
+
+        for ( int j = 0; j < 8; j++ )
+            crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+    }
+
+    return (uint8_t) crc;
+}
+
+static uint16_t Crc16( const uint8_t* data, uint32_t length )
+{
+    uint32_t crc = 0;
+
+    for ( uint32_t i = 0; i < length; i++ )
+    {
+        crc ^= data[i] << 8;
+
+        for ( int j = 0; j < 8; j++ )
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x8005) : (crc << 1);
+    }
+
+    return (uint16_t) crc;
+}
+
+static uint32_t ZigZag( int32_t value )
+{
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+static int GetSampleRateCode( long rate )
+{
+    switch ( rate )
+    {
+    case 8000:  return 4;
+    case 16000: return 5;
+    case 22050: return 6;
+    case 24000: return 7;
+    case 32000: return 8;
+    case 44100: return 9;
+    case 48000: return 10;
+    case 96000: return 11;
+    default:    return 0;   // take it from STREAMINFO
+    }
+}
+
+
+//----------------------------------------------------------------------------
+//  BitWriter
+//----------------------------------------------------------------------------
+
+void Flac_Writer::BitWriter::Reset( uint8_t* buffer )
+{
+    buf = buffer;
+    pos = 0;
+    acc = 0;
+    accBits = 0;
+}
+
+void Flac_Writer::BitWriter::Put( uint32_t value, int bits )
+{
+    assert( bits <= 32 );
+
+    if ( bits == 0 )
+        return;
+
+    acc = (acc << bits) | (value & (0xFFFFFFFFU >> (32 - bits)));
+    accBits += bits;
+
+    while ( accBits >= 8 )
+    {
+        accBits -= 8;
+        buf[pos++] = (uint8_t) (acc >> accBits);
+    }
+}
+
+void Flac_Writer::BitWriter::PutSigned( int32_t value, int bits )
+{
+    Put( (uint32_t) value, bits );
+}
+
+void Flac_Writer::BitWriter::PutUnary( uint32_t zeros )
+{
+    for ( ; zeros >= 32; zeros -= 32 )
+        Put( 0, 32 );
+
+    Put( 1, zeros + 1 );
+}
+
+void Flac_Writer::BitWriter::PutRice( int32_t value, int param )
+{
+    uint32_t u = ZigZag( value );
+
+    PutUnary( u >> param );
+    Put( u, param );
+}
+
+void Flac_Writer::BitWriter::AlignToByte()
+{
+    if ( accBits > 0 )
+        Put( 0, 8 - accBits );
+}
+
+uint32_t Flac_Writer::BitWriter::GetByteCount() const
+{
+    return pos;
+}
+
+
+//----------------------------------------------------------------------------
+//  Flac_Writer
+//----------------------------------------------------------------------------
+
+Flac_Writer::Flac_Writer()
+    :   file( NULL ),
+        rate( 0 ),
+        chanCount( 1 ),
+        sampleCount( 0 ),
+        frameNumber( 0 ),
+        minFrameSize( 0 ),
+        maxFrameSize( 0 ),
+        blockFill( 0 ),
+        nextChan( 0 )
+{
+}
+
+Flac_Writer::~Flac_Writer()
+{
+    close();
+}
+
+Flac_Writer::error_t Flac_Writer::open( long sampleRate, const char* filename )
+{
+    rate = sampleRate;
+
+    file = fopen( filename, "wb" );
+    if ( file == NULL )
+        return "Couldn't open FLAC file for writing";
+
+    setvbuf( file, NULL, _IOFBF, 32 * 1024L );
+
+    // Reserve room for the header. It's written for real when closing,
+    // once the sample count and frame sizes are known.
+
+    return WriteStreamInfo();
+}
+
+Flac_Writer::error_t Flac_Writer::write( const sample_t* in, long count, int skip )
+{
+    sampleCount += count;
+
+    for ( long i = 0; i < count; i++ )
+    {
+        block[nextChan][blockFill] = *in;
+        in += skip;
+
+        nextChan++;
+        if ( nextChan < chanCount )
+            continue;
+
+        nextChan = 0;
+        blockFill++;
+
+        if ( blockFill == BlockSize )
+        {
+            error_t err = FlushBlock();
+            if ( err != NULL )
+                return err;
+        }
+    }
+
+    return NULL;
+}
+
+Flac_Writer::error_t Flac_Writer::close()
+{
+    if ( file == NULL )
+        return NULL;
+
+    error_t err = NULL;
+
+    // A trailing half of a stereo pair can't be stored, so it's dropped.
+
+    if ( blockFill > 0 )
+        err = FlushBlock();
+
+    if ( err == NULL )
+    {
+        fseek( file, 0, SEEK_SET );
+        err = WriteStreamInfo();
+    }
+
+    fclose( file );
+    file = NULL;
+
+    return err;
+}
+
+Flac_Writer::error_t Flac_Writer::WriteStreamInfo()
+{
+    uint8_t header[StreamHeaderSize];
+    uint64_t totalFrames = sampleCount / chanCount;
+
+    memcpy( header, "fLaC", 4 );
+
+    bits.Reset( header + 4 );
+    bits.Put( 1, 1 );                       // last metadata block
+    bits.Put( 0, 7 );                       // STREAMINFO
+    bits.Put( StreamInfoSize, 24 );
+    bits.Put( BlockSize, 16 );              // min block size
+    bits.Put( BlockSize, 16 );              // max block size
+    bits.Put( minFrameSize, 24 );
+    bits.Put( maxFrameSize, 24 );
+    bits.Put( rate, 20 );
+    bits.Put( chanCount - 1, 3 );
+    bits.Put( BitsPerSample - 1, 5 );
+    bits.Put( (uint32_t) (totalFrames >> 32), 4 );
+    bits.Put( (uint32_t) totalFrames, 32 );
+
+    // An MD5 signature of all zeros means that it wasn't computed.
+
+    for ( int i = 0; i < 4; i++ )
+        bits.Put( 0, 32 );
+
+    assert( bits.GetByteCount() == StreamHeaderSize - 4 );
+
+    if ( fwrite( header, sizeof header, 1, file ) != 1 )
+        return "Couldn't write FLAC header";
+
+    return NULL;
+}
+
+Flac_Writer::error_t Flac_Writer::FlushBlock()
+{
+    const int count = blockFill;
+    Subframe subframes[4];
+    ChannelAssignment chanAssign = Chan_Independent;
+
+    bits.Reset( frameBuf );
+
+    if ( chanCount == 1 )
+    {
+        AnalyzeSubframe( block[0], count, BitsPerSample, subframes[0] );
+        WriteFrameHeader( count, chanAssign );
+        WriteSubframe( block[0], count, BitsPerSample, subframes[0] );
+    }
+    else
+    {
+        // Try each way of storing the two channels, and keep the smallest.
+        // Side needs an extra bit, because it's a difference.
+
+        for ( int i = 0; i < count; i++ )
+        {
+            mid[i] = (block[0][i] + block[1][i]) >> 1;
+            side[i] = block[0][i] - block[1][i];
+        }
+
+        AnalyzeSubframe( block[0], count, BitsPerSample, subframes[0] );
+        AnalyzeSubframe( block[1], count, BitsPerSample, subframes[1] );
+        AnalyzeSubframe( mid, count, BitsPerSample, subframes[2] );
+        AnalyzeSubframe( side, count, BitsPerSample + 1, subframes[3] );
+
+        uint32_t leftBits = subframes[0].Bits;
+        uint32_t rightBits = subframes[1].Bits;
+        uint32_t midBits = subframes[2].Bits;
+        uint32_t sideBits = subframes[3].Bits;
+        uint32_t bestBits = leftBits + rightBits;
+
+        if ( leftBits + sideBits < bestBits )
+        {
+            chanAssign = Chan_LeftSide;
+            bestBits = leftBits + sideBits;
+        }
+        if ( rightBits + sideBits < bestBits )
+        {
+            chanAssign = Chan_RightSide;
+            bestBits = rightBits + sideBits;
+        }
+        if ( midBits + sideBits < bestBits )
+        {
+            chanAssign = Chan_MidSide;
+            bestBits = midBits + sideBits;
+        }
+
+        WriteFrameHeader( count, chanAssign );
+
+        switch ( chanAssign )
+        {
+        case Chan_Independent:
+            WriteSubframe( block[0], count, BitsPerSample, subframes[0] );
+            WriteSubframe( block[1], count, BitsPerSample, subframes[1] );
+            break;
+
+        case Chan_LeftSide:
+            WriteSubframe( block[0], count, BitsPerSample, subframes[0] );
+            WriteSubframe( side, count, BitsPerSample + 1, subframes[3] );
+            break;
+
+        case Chan_RightSide:
+            WriteSubframe( side, count, BitsPerSample + 1, subframes[3] );
+            WriteSubframe( block[1], count, BitsPerSample, subframes[1] );
+            break;
+
+        case Chan_MidSide:
+            WriteSubframe( mid, count, BitsPerSample, subframes[2] );
+            WriteSubframe( side, count, BitsPerSample + 1, subframes[3] );
+            break;
+        }
+    }
+
+    bits.AlignToByte();
+
+    uint16_t crc = Crc16( frameBuf, bits.GetByteCount() );
+    bits.Put( crc, 16 );
+
+    uint32_t frameSize = bits.GetByteCount();
+
+    assert( frameSize <= MaxFrameBytes );
+
+    if ( minFrameSize == 0 || frameSize < minFrameSize )
+        minFrameSize = frameSize;
+    if ( frameSize > maxFrameSize )
+        maxFrameSize = frameSize;
+
+    blockFill = 0;
+    frameNumber++;
+
+    if ( fwrite( frameBuf, frameSize, 1, file ) != 1 )
+        return "Couldn't write FLAC data";
+
+    return NULL;
+}
+
+void Flac_Writer::WriteFrameHeader( int count, ChannelAssignment chanAssign )
+{
+    int blockSizeCode = (count == BlockSize) ? 12 : 7;
+    int sampleRateCode = GetSampleRateCode( rate );
+
+    if ( chanAssign == Chan_Independent )
+        chanAssign = (ChannelAssignment) (chanCount - 1);
+
+    bits.Put( 0x3FFE, 14 );                 // sync code
+    bits.Put( 0, 1 );
+    bits.Put( 0, 1 );                       // fixed block size
+    bits.Put( blockSizeCode, 4 );
+    bits.Put( sampleRateCode, 4 );
+    bits.Put( chanAssign, 4 );
+    bits.Put( 4, 3 );                       // 16 bits a sample
+    bits.Put( 0, 1 );
+
+    // The frame number is stored the same way that UTF-8 stores code points.
+
+    if ( frameNumber < 0x80 )
+    {
+        bits.Put( frameNumber, 8 );
+    }
+    else
+    {
+        int extraBytes = 1;
+
+        while ( extraBytes < 5 && frameNumber >= (1U << (5 * extraBytes + 6)) )
+            extraBytes++;
+
+        uint32_t lead = (0xFF00 >> (extraBytes + 1)) & 0xFF;
+
+        bits.Put( lead | (frameNumber >> (6 * extraBytes)), 8 );
+
+        for ( int i = extraBytes - 1; i >= 0; i-- )
+            bits.Put( 0x80 | ((frameNumber >> (6 * i)) & 0x3F), 8 );
+    }
+
+    if ( blockSizeCode == 7 )
+        bits.Put( count - 1, 16 );
+
+    uint8_t crc = Crc8( frameBuf, bits.GetByteCount() );
+    bits.Put( crc, 8 );
+}
+
+void Flac_Writer::AnalyzeSubframe( const int32_t* samples, int count, int sampleBits, Subframe& subframe )
+{
+    bool constant = true;
+
+    for ( int i = 1; i < count; i++ )
+    {
+        if ( samples[i] != samples[0] )
+        {
+            constant = false;
+            break;
+        }
+    }
+
+    if ( constant )
+    {
+        subframe.Order = -2;
+        subframe.Bits = 8 + sampleBits;
+        return;
+    }
+
+    subframe.Order = -1;
+    subframe.Bits = 8 + count * sampleBits;
+
+    // Pick the order by estimating the size of each. Then measure the chosen
+    // one exactly, so that verbatim wins if the estimate was too optimistic.
+
+    Subframe trial;
+    Subframe best;
+
+    best.Order = -1;
+    best.Bits = subframe.Bits;
+
+    for ( int order = 0; order <= MaxFixedOrder && order < count; order++ )
+    {
+        ComputeResidual( samples, count, order, residual );
+        AnalyzeResidual( count, order, trial );
+
+        trial.Order = order;
+        trial.Bits += 8 + 2 + 4 + order * sampleBits;
+
+        if ( trial.Bits < best.Bits )
+            best = trial;
+    }
+
+    if ( best.Order < 0 )
+        return;
+
+    ComputeResidual( samples, count, best.Order, residual );
+    best.Bits = 8 + 2 + 4 + best.Order * sampleBits + MeasureResidual( count, best.Order, best );
+
+    if ( best.Bits < subframe.Bits )
+        subframe = best;
+}
+
+void Flac_Writer::AnalyzeResidual( int count, int order, Subframe& subframe )
+{
+    // Partitions have to split the block evenly, and the first one has to be
+    // longer than the warm-up samples that it doesn't hold.
+
+    int maxPartOrder = 0;
+
+    while ( maxPartOrder < MaxPartitionOrder
+        && (count & ((2 << maxPartOrder) - 1)) == 0
+        && (count >> (maxPartOrder + 1)) > order )
+    {
+        maxPartOrder++;
+    }
+
+    int partCount = 1 << maxPartOrder;
+    int partLen = count >> maxPartOrder;
+    const int32_t* r = residual;
+
+    for ( int p = 0; p < partCount; p++ )
+    {
+        int n = (p == 0) ? partLen - order : partLen;
+        uint64_t sum = 0;
+
+        for ( int i = 0; i < n; i++ )
+            sum += ZigZag( *r++ );
+
+        partitionSums[p] = sum;
+    }
+
+    // Work up from the finest partitioning, merging pairs of partitions.
+
+    subframe.Bits = 0xFFFFFFFF;
+
+    for ( int partOrder = maxPartOrder; partOrder >= 0; partOrder-- )
+    {
+        int params[1 << MaxPartitionOrder];
+        uint32_t totalBits = 0;
+
+        partCount = 1 << partOrder;
+        partLen = count >> partOrder;
+
+        for ( int p = 0; p < partCount; p++ )
+        {
+            uint32_t n = (p == 0) ? partLen - order : partLen;
+            uint64_t bestBits = UINT64_MAX;
+            int bestParam = 0;
+
+            for ( int k = 0; k <= MaxRiceParam; k++ )
+            {
+                uint64_t estBits = (uint64_t) n * (k + 1) + (partitionSums[p] >> k);
+
+                if ( estBits < bestBits )
+                {
+                    bestBits = estBits;
+                    bestParam = k;
+                }
+            }
+
+            params[p] = bestParam;
+            totalBits += 4 + (uint32_t) bestBits;
+        }
+
+        if ( totalBits < subframe.Bits )
+        {
+            subframe.Bits = totalBits;
+            subframe.PartitionOrder = partOrder;
+            memcpy( subframe.RiceParams, params, partCount * sizeof params[0] );
+        }
+
+        for ( int p = 0; p < partCount / 2; p++ )
+            partitionSums[p] = partitionSums[2 * p] + partitionSums[2 * p + 1];
+    }
+}
+
+uint32_t Flac_Writer::MeasureResidual( int count, int order, const Subframe& subframe )
+{
+    int partCount = 1 << subframe.PartitionOrder;
+    int partLen = count >> subframe.PartitionOrder;
+    const int32_t* r = residual;
+    uint32_t totalBits = 0;
+
+    for ( int p = 0; p < partCount; p++ )
+    {
+        int n = (p == 0) ? partLen - order : partLen;
+        int k = subframe.RiceParams[p];
+
+        totalBits += 4 + n * (k + 1);
+
+        for ( int i = 0; i < n; i++ )
+            totalBits += ZigZag( *r++ ) >> k;
+    }
+
+    return totalBits;
+}
+
+void Flac_Writer::WriteSubframe( const int32_t* samples, int count, int sampleBits, const Subframe& subframe )
+{
+    bits.Put( 0, 1 );
+
+    if ( subframe.Order == -2 )
+    {
+        bits.Put( 0, 6 );
+        bits.Put( 0, 1 );
+        bits.PutSigned( samples[0], sampleBits );
+        return;
+    }
+
+    if ( subframe.Order == -1 )
+    {
+        bits.Put( 1, 6 );
+        bits.Put( 0, 1 );
+
+        for ( int i = 0; i < count; i++ )
+            bits.PutSigned( samples[i], sampleBits );
+        return;
+    }
+
+    int order = subframe.Order;
+
+    bits.Put( 8 | order, 6 );
+    bits.Put( 0, 1 );
+
+    for ( int i = 0; i < order; i++ )
+        bits.PutSigned( samples[i], sampleBits );
+
+    ComputeResidual( samples, count, order, residual );
+
+    int partCount = 1 << subframe.PartitionOrder;
+    int partLen = count >> subframe.PartitionOrder;
+    const int32_t* r = residual;
+
+    bits.Put( 0, 2 );                       // Rice coding with 4-bit parameters
+    bits.Put( subframe.PartitionOrder, 4 );
+
+    for ( int p = 0; p < partCount; p++ )
+    {
+        int n = (p == 0) ? partLen - order : partLen;
+        int k = subframe.RiceParams[p];
+
+        bits.Put( k, 4 );
+
+        for ( int i = 0; i < n; i++ )
+            bits.PutRice( *r++, k );
+    }
+}
+
+void Flac_Writer::ComputeResidual( const int32_t* samples, int count, int order, int32_t* residual )
+{
+    const int32_t* s = samples;
+
+    switch ( order )
+    {
+    case 0:
+        for ( int i = 0; i < count; i++ )
+            *residual++ = s[i];
+        break;
+
+    case 1:
+        for ( int i = 1; i < count; i++ )
+            *residual++ = s[i] - s[i-1];
+        break;
+
+    case 2:
+        for ( int i = 2; i < count; i++ )
+            *residual++ = s[i] - 2 * s[i-1] + s[i-2];
+        break;
+
+    case 3:
+        for ( int i = 3; i < count; i++ )
+            *residual++ = s[i] - 3 * s[i-1] + 3 * s[i-2] - s[i-3];
+        break;
+
+    case 4:
+        for ( int i = 4; i < count; i++ )
+            *residual++ = s[i] - 4 * s[i-1] + 6 * s[i-2] - 4 * s[i-3] + s[i-4];
+        break;
+    }
+}
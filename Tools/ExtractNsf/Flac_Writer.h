@@ -0,0 +1,123 @@
+/*
+   Copyright 2016 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+
+// Writes 16-bit samples to a FLAC file. It has the same shape as Wave_Writer,
+// so that it can stand in for it. Samples are encoded one block at a time as
+// they're written; only a block's worth of samples is ever held in memory.
+//
+// The encoder only uses the fixed predictors and Rice coded residuals. For
+// the square and triangle waves of NES music, that's most of the gain that
+// LPC would give, at a fraction of the cost.
+
+class Flac_Writer
+{
+public:
+    typedef short sample_t;
+    typedef const char* error_t;
+
+    Flac_Writer();
+    ~Flac_Writer();
+
+    error_t open( long sampleRate, const char* filename );
+
+    // Must be called before the first write.
+    void enable_stereo();
+
+    // Append 'count' samples. Use every 'skip'th source sample; allows one
+    // channel of stereo sample pairs to be written by specifying a skip of 2.
+    error_t write( const sample_t* in, long count, int skip = 1 );
+
+    // Number of samples written so far
+    long sample_count() const;
+
+    error_t close();
+
+private:
+    enum
+    {
+        BlockSize = 4096,
+        MaxChannels = 2,
+        MaxFixedOrder = 4,
+        MaxPartitionOrder = 8,
+        MaxRiceParam = 14,
+        BitsPerSample = 16,
+        MaxFrameBytes = 32 + MaxChannels * (BlockSize * (BitsPerSample + 1) / 8 + 8),
+    };
+
+    enum ChannelAssignment
+    {
+        Chan_Independent,
+        Chan_LeftSide   = 8,
+        Chan_RightSide  = 9,
+        Chan_MidSide    = 10,
+    };
+
+    struct Subframe
+    {
+        int Order;                      // -2: constant; -1: verbatim; 0 to 4: fixed
+        int PartitionOrder;
+        int RiceParams[1 << MaxPartitionOrder];
+        uint32_t Bits;
+    };
+
+    class BitWriter
+    {
+        uint8_t* buf;
+        uint32_t pos;
+        uint64_t acc;
+        int accBits;
+
+    public:
+        void Reset( uint8_t* buffer );
+        void Put( uint32_t value, int bits );
+        void PutSigned( int32_t value, int bits );
+        void PutUnary( uint32_t zeros );
+        void PutRice( int32_t value, int param );
+        void AlignToByte();
+        uint32_t GetByteCount() const;
+    };
+
+    FILE* file;
+    long rate;
+    int chanCount;
+    long sampleCount;
+    uint32_t frameNumber;
+    uint32_t minFrameSize;
+    uint32_t maxFrameSize;
+
+    int blockFill;
+    int nextChan;
+    int32_t block[MaxChannels][BlockSize];
+    int32_t mid[BlockSize];
+    int32_t side[BlockSize];
+    int32_t residual[BlockSize];
+    uint64_t partitionSums[1 << MaxPartitionOrder];
+
+    uint8_t frameBuf[MaxFrameBytes];
+    BitWriter bits;
+
+    error_t WriteStreamInfo();
+    error_t FlushBlock();
+
+    void AnalyzeSubframe( const int32_t* samples, int count, int sampleBits, Subframe& subframe );
+    void AnalyzeResidual( int count, int order, Subframe& subframe );
+    uint32_t MeasureResidual( int count, int order, const Subframe& subframe );
+    void WriteSubframe( const int32_t* samples, int count, int sampleBits, const Subframe& subframe );
+    void WriteFrameHeader( int count, ChannelAssignment chanAssign );
+
+    static void ComputeResidual( const int32_t* samples, int count, int order, int32_t* residual );
+};
+
+inline void Flac_Writer::enable_stereo() { chanCount = 2; }
+
+inline long Flac_Writer::sample_count() const { return sampleCount; }
@@ -0,0 +1,85 @@
+// Renders NSF music and prints a hash of the samples, to check that a change
+// to the NES CPU core doesn't change what it plays. Build it twice, once
+// with the switch core and once with threaded dispatch, and compare:
+//
+//	g++ -O2 -I. -Igme demo/cpu_compare.cpp gme/*.cpp -o cpu_switch
+//	g++ -O2 -I. -Igme -DNES_CPU_THREADED_DISPATCH=1 demo/cpu_compare.cpp gme/*.cpp -o cpu_threaded
+//	./cpu_switch 60 test.nsf > switch.txt
+//	./cpu_threaded 60 test.nsf > threaded.txt
+//	diff switch.txt threaded.txt
+//
+// Arguments: seconds to play each track, then the NSF files. Every track
+// of each file is played, and one hash is printed per file. test.nsf only
+// has a few tracks; the more music is compared, the better.
+
+#include "gme/Nsf_Emu.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+typedef unsigned long long hash_t;
+
+static hash_t const hash_start = 1469598103934665603ULL;
+
+static void mix( hash_t& hash, unsigned v )
+{
+	hash = (hash ^ v) * 1099511628211ULL;
+}
+
+static const char* play_all( Nsf_Emu& emu, int seconds, hash_t& hash )
+{
+	int const buf_size = 4096;
+	static short buf [buf_size];
+
+	for ( int track = 0; track < emu.track_count(); track++ )
+	{
+		if ( const char* err = emu.start_track( track ) )
+			return err;
+
+		for ( long n = 0; n < 44100L * 2 * seconds; n += buf_size )
+		{
+			if ( const char* err = emu.play( buf_size, buf ) )
+				return err;
+			for ( int i = 0; i < buf_size; i++ )
+				mix( hash, (unsigned short) buf [i] );
+		}
+		mix( hash, emu.tell() * 31 + emu.track_ended() );
+	}
+	return 0;
+}
+
+int main( int argc, char** argv )
+{
+	if ( argc < 3 )
+	{
+		fprintf( stderr, "usage: cpu_compare seconds file.nsf [file.nsf ...]\n" );
+		return 1;
+	}
+
+	int seconds = atoi( argv [1] );
+	int failures = 0;
+
+	for ( int i = 2; i < argc; i++ )
+	{
+		Nsf_Emu emu;
+		hash_t hash = hash_start;
+		emu.ignore_silence();
+		emu.set_sample_rate( 44100 );
+
+		const char* err = emu.load_file( argv [i] );
+		if ( !err )
+			err = play_all( emu, seconds, hash );
+
+		if ( err )
+		{
+			printf( "%s error %s\n", argv [i], err );
+			failures++;
+		}
+		else
+		{
+			printf( "%s %016llx\n", argv [i], hash );
+		}
+	}
+
+	return failures ? 1 : 0;
+}
@@ -48,6 +48,27 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 	#define PAGE_OFFSET( addr ) ((addr) & (page_size - 1))
 #endif
 
+// Threaded dispatch needs the labels-as-values extension (GCC, Clang). Other
+// compilers always get the switch-based interpreter.
+#if NES_CPU_THREADED_DISPATCH && !defined (__GNUC__)
+	#undef NES_CPU_THREADED_DISPATCH
+#endif
+
+// Opcode handlers are written once and become either switch cases or labels
+// reached through the dispatch table in run(). CASE( 0xB5 ) names label op_0xB5,
+// so opcodes must be spelled as two upper-case hex digits.
+#if NES_CPU_THREADED_DISPATCH
+	#define CASE( n )                   op_##n
+	#define DEFAULT_CASE                op_default
+	#define ARITH_CASE( op, n, mode )   mode##op
+	#define SWITCH_OPCODE( n )          goto *dispatch [n];
+#else
+	#define CASE( n )                   case n
+	#define DEFAULT_CASE                default
+	#define ARITH_CASE( op, n, mode )   case op + n
+	#define SWITCH_OPCODE( n )          switch ( n )
+#endif
+
 inline void Nes_Cpu::set_code_page( int i, void const* p )
 {
 	state->code_map [i] = (uint8_t const*) p - PAGE_OFFSET( i * page_size );
@@ -206,6 +227,76 @@ loop:
 		3,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7 // F
 	}; // 0x00 was 7 and 0xF2 was 2
 	
+#if NES_CPU_THREADED_DISPATCH
+	static void* const dispatch [256] =
+	{
+		&&op_0x00, &&ind_x_0x05, &&op_0x02, &&op_default, // 00
+		&&op_0x04, &&zp_0x05, &&op_0x06, &&op_default, // 04
+		&&op_0x08, &&imm_0x05, &&op_0x0A, &&op_default, // 08
+		&&op_0x0C, &&abs_0x05, &&op_0x0E, &&op_default, // 0C
+		&&op_0x10, &&ind_y_0x05, &&op_0x12, &&op_default, // 10
+		&&op_0x14, &&zp_x_0x05, &&op_0x16, &&op_default, // 14
+		&&op_0x18, &&abs_y_0x05, &&op_0x1A, &&op_default, // 18
+		&&op_0x1C, &&abs_x_0x05, &&op_0x1E, &&op_default, // 1C
+		&&op_0x20, &&ind_x_0x25, &&op_0x22, &&op_default, // 20
+		&&op_0x24, &&zp_0x25, &&op_0x26, &&op_default, // 24
+		&&op_0x28, &&imm_0x25, &&op_0x2A, &&op_default, // 28
+		&&op_0x2C, &&abs_0x25, &&op_0x2E, &&op_default, // 2C
+		&&op_0x30, &&ind_y_0x25, &&op_0x32, &&op_default, // 30
+		&&op_0x34, &&zp_x_0x25, &&op_0x36, &&op_default, // 34
+		&&op_0x38, &&abs_y_0x25, &&op_0x3A, &&op_default, // 38
+		&&op_0x3C, &&abs_x_0x25, &&op_0x3E, &&op_default, // 3C
+		&&op_0x40, &&ind_x_0x45, &&op_0x42, &&op_default, // 40
+		&&op_0x44, &&zp_0x45, &&op_0x46, &&op_default, // 44
+		&&op_0x48, &&imm_0x45, &&op_0x4A, &&op_default, // 48
+		&&op_0x4C, &&abs_0x45, &&op_0x4E, &&op_default, // 4C
+		&&op_0x50, &&ind_y_0x45, &&op_0x52, &&op_default, // 50
+		&&op_0x54, &&zp_x_0x45, &&op_0x56, &&op_default, // 54
+		&&op_0x58, &&abs_y_0x45, &&op_0x5A, &&op_default, // 58
+		&&op_0x5C, &&abs_x_0x45, &&op_0x5E, &&op_default, // 5C
+		&&op_0x60, &&ind_x_0x65, &&op_0x62, &&op_default, // 60
+		&&op_0x64, &&zp_0x65, &&op_0x66, &&op_default, // 64
+		&&op_0x68, &&imm_0x65, &&op_0x6A, &&op_default, // 68
+		&&op_0x6C, &&abs_0x65, &&op_0x6E, &&op_default, // 6C
+		&&op_0x70, &&ind_y_0x65, &&op_0x72, &&op_default, // 70
+		&&op_0x74, &&zp_x_0x65, &&op_0x76, &&op_default, // 74
+		&&op_0x78, &&abs_y_0x65, &&op_0x7A, &&op_default, // 78
+		&&op_0x7C, &&abs_x_0x65, &&op_0x7E, &&op_default, // 7C
+		&&op_0x80, &&op_0x81, &&op_0x82, &&op_default, // 80
+		&&op_0x84, &&op_0x85, &&op_0x86, &&op_default, // 84
+		&&op_0x88, &&op_0x89, &&op_0x8A, &&op_default, // 88
+		&&op_0x8C, &&op_0x8D, &&op_0x8E, &&op_default, // 8C
+		&&op_0x90, &&op_0x91, &&op_0x92, &&op_default, // 90
+		&&op_0x94, &&op_0x95, &&op_0x96, &&op_default, // 94
+		&&op_0x98, &&op_0x99, &&op_0x9A, &&op_default, // 98
+		&&op_default, &&op_0x9D, &&op_default, &&op_default, // 9C
+		&&op_0xA0, &&op_0xA1, &&op_0xA2, &&op_default, // A0
+		&&op_0xA4, &&op_0xA5, &&op_0xA6, &&op_default, // A4
+		&&op_0xA8, &&op_0xA9, &&op_0xAA, &&op_default, // A8
+		&&op_0xAC, &&op_0xAD, &&op_0xAE, &&op_default, // AC
+		&&op_0xB0, &&op_0xB1, &&op_0xB2, &&op_default, // B0
+		&&op_0xB4, &&op_0xB5, &&op_0xB6, &&op_default, // B4
+		&&op_0xB8, &&op_0xB9, &&op_0xBA, &&op_default, // B8
+		&&op_0xBC, &&op_0xBD, &&op_0xBE, &&op_default, // BC
+		&&op_0xC0, &&ind_x_0xC5, &&op_0xC2, &&op_default, // C0
+		&&op_0xC4, &&zp_0xC5, &&op_0xC6, &&op_default, // C4
+		&&op_0xC8, &&imm_0xC5, &&op_0xCA, &&op_default, // C8
+		&&op_0xCC, &&abs_0xC5, &&op_0xCE, &&op_default, // CC
+		&&op_0xD0, &&ind_y_0xC5, &&op_0xD2, &&op_default, // D0
+		&&op_0xD4, &&zp_x_0xC5, &&op_0xD6, &&op_default, // D4
+		&&op_0xD8, &&abs_y_0xC5, &&op_0xDA, &&op_default, // D8
+		&&op_0xDC, &&abs_x_0xC5, &&op_0xDE, &&op_default, // DC
+		&&op_0xE0, &&ind_x_0xE5, &&op_0xE2, &&op_default, // E0
+		&&op_0xE4, &&zp_0xE5, &&op_0xE6, &&op_default, // E4
+		&&op_0xE8, &&imm_0xE5, &&op_0xEA, &&op_0xEB, // E8
+		&&op_0xEC, &&abs_0xE5, &&op_0xEE, &&op_default, // EC
+		&&op_0xF0, &&ind_y_0xE5, &&op_0xF2, &&op_default, // F0
+		&&op_0xF4, &&zp_x_0xE5, &&op_0xF6, &&op_default, // F4
+		&&op_0xF8, &&abs_y_0xE5, &&op_0xFA, &&op_default, // F8
+		&&op_0xFC, &&abs_x_0xE5, &&op_0xFE, &&op_0xFF // FC
+	};
+#endif
+	
 	fuint16 data;
 	
 #if !BLARGG_CPU_X86
@@ -215,7 +306,7 @@ loop:
 	
 	data = *instr;
 	
-	switch ( opcode )
+	SWITCH_OPCODE( opcode )
 	{
 #else
 
@@ -226,7 +317,7 @@ almost_out_of_time:
 	
 	data = *instr;
 	
-	switch ( opcode )
+	SWITCH_OPCODE( opcode )
 	{
 possibly_out_of_time:
 		if ( s_time < (int) data )
@@ -244,7 +335,36 @@ possibly_out_of_time:
 #define NO_PAGE_CROSSING( lsb )
 #define HANDLE_PAGE_CROSSING( lsb ) s_time += (lsb) >> 8;
 
-#define INC_DEC_XY( reg, n ) reg = uint8_t (nz = reg + n); goto loop;
+// Ends a frequently executed handler. With threaded dispatch, each such handler
+// fetches and jumps to the next one itself, giving the indirect branch its own
+// prediction history instead of sharing the one at loop.
+#if !NES_CPU_THREADED_DISPATCH
+	#define NEXT_OP() goto loop
+#elif !BLARGG_CPU_X86
+	#define NEXT_OP() {\
+		instr = s.code_map [pc >> page_bits] + PAGE_OFFSET( pc );\
+		opcode = *instr++;\
+		pc++;\
+		if ( s_time >= 0 )\
+			goto out_of_time;\
+		s_time += clock_table [opcode];\
+		data = *instr;\
+		goto *dispatch [opcode];\
+	}
+#else
+	#define NEXT_OP() {\
+		instr = s.code_map [pc >> page_bits] + PAGE_OFFSET( pc );\
+		opcode = *instr++;\
+		pc++;\
+		data = clock_table [opcode];\
+		if ( (s_time += data) >= 0 )\
+			goto possibly_out_of_time;\
+		data = *instr;\
+		goto *dispatch [opcode];\
+	}
+#endif
+
+#define INC_DEC_XY( reg, n ) reg = uint8_t (nz = reg + n); NEXT_OP();
 
 #define IND_Y( cross, out ) {\
 		fuint16 temp = READ_LOW( data ) + y;\
@@ -258,31 +378,31 @@ possibly_out_of_time:
 	}
 	
 #define ARITH_ADDR_MODES( op )\
-case op - 0x04: /* (ind,x) */\
+ARITH_CASE( op, -0x04, ind_x_ ): /* (ind,x) */\
 	IND_X( data )\
 	goto ptr##op;\
-case op + 0x0C: /* (ind),y */\
+ARITH_CASE( op, 0x0C, ind_y_ ): /* (ind),y */\
 	IND_Y( HANDLE_PAGE_CROSSING, data )\
 	goto ptr##op;\
-case op + 0x10: /* zp,X */\
+ARITH_CASE( op, 0x10, zp_x_ ): /* zp,X */\
 	data = uint8_t (data + x);\
-case op + 0x00: /* zp */\
+ARITH_CASE( op, 0x00, zp_ ): /* zp */\
 	data = READ_LOW( data );\
 	goto imm##op;\
-case op + 0x14: /* abs,Y */\
+ARITH_CASE( op, 0x14, abs_y_ ): /* abs,Y */\
 	data += y;\
 	goto ind##op;\
-case op + 0x18: /* abs,X */\
+ARITH_CASE( op, 0x18, abs_x_ ): /* abs,X */\
 	data += x;\
 ind##op:\
 	HANDLE_PAGE_CROSSING( data );\
-case op + 0x08: /* abs */\
+ARITH_CASE( op, 0x08, abs_ ): /* abs */\
 	ADD_PAGE();\
 ptr##op:\
 	FLUSH_TIME();\
 	data = READ( data );\
 	CACHE_TIME();\
-case op + 0x04: /* imm */\
+ARITH_CASE( op, 0x04, imm_ ): /* imm */\
 imm##op:
 
 // TODO: more efficient way to handle negative branch that wraps PC around
@@ -293,41 +413,41 @@ imm##op:
 	if ( !(cond) ) goto dec_clock_loop;\
 	pc = BOOST::uint16_t (pc + offset);\
 	s_time += extra_clock >> 8 & 1;\
-	goto loop;\
+	NEXT_OP();\
 }
 
 // Often-Used
 
-	case 0xB5: // LDA zp,x
+	CASE( 0xB5 ): // LDA zp,x
 		a = nz = READ_LOW( uint8_t (data + x) );
 		pc++;
-		goto loop;
+		NEXT_OP();
 	
-	case 0xA5: // LDA zp
+	CASE( 0xA5 ): // LDA zp
 		a = nz = READ_LOW( data );
 		pc++;
-		goto loop;
+		NEXT_OP();
 	
-	case 0xD0: // BNE
+	CASE( 0xD0 ): // BNE
 		BRANCH( (uint8_t) nz );
 	
-	case 0x20: { // JSR
+	CASE( 0x20 ): { // JSR
 		fuint16 temp = pc + 1;
 		pc = GET_ADDR();
 		WRITE_LOW( 0x100 | (sp - 1), temp >> 8 );
 		sp = (sp - 2) | 0x100;
 		WRITE_LOW( sp, temp );
-		goto loop;
+		NEXT_OP();
 	}
 	
-	case 0x4C: // JMP abs
+	CASE( 0x4C ): // JMP abs
 		pc = GET_ADDR();
-		goto loop;
+		NEXT_OP();
 	
-	case 0xE8: // INX
+	CASE( 0xE8 ): // INX
 		INC_DEC_XY( x, 1 )
 	
-	case 0x10: // BPL
+	CASE( 0x10 ): // BPL
 		BRANCH( !IS_NEG )
 	
 	ARITH_ADDR_MODES( 0xC5 ) // CMP
@@ -335,200 +455,200 @@ imm##op:
 		pc++;
 		c = ~nz;
 		nz &= 0xFF;
-		goto loop;
+		NEXT_OP();
 	
-	case 0x30: // BMI
+	CASE( 0x30 ): // BMI
 		BRANCH( IS_NEG )
 	
-	case 0xF0: // BEQ
+	CASE( 0xF0 ): // BEQ
 		BRANCH( !(uint8_t) nz );
 	
-	case 0x95: // STA zp,x
+	CASE( 0x95 ): // STA zp,x
 		data = uint8_t (data + x);
-	case 0x85: // STA zp
+	CASE( 0x85 ): // STA zp
 		pc++;
 		WRITE_LOW( data, a );
-		goto loop;
+		NEXT_OP();
 	
-	case 0xC8: // INY
+	CASE( 0xC8 ): // INY
 		INC_DEC_XY( y, 1 )
 
-	case 0xA8: // TAY
+	CASE( 0xA8 ): // TAY
 		y  = a;
 		nz = a;
-		goto loop;
+		NEXT_OP();
 	
-	case 0x98: // TYA
+	CASE( 0x98 ): // TYA
 		a  = y;
 		nz = y;
-		goto loop;
+		NEXT_OP();
 	
-	case 0xAD:{// LDA abs
+	CASE( 0xAD ):{// LDA abs
 		unsigned addr = GET_ADDR();
 		pc += 2;
 		READ_LIKELY_PPU( addr, nz );
 		a = nz;
-		goto loop;
+		NEXT_OP();
 	}
 	
-	case 0x60: // RTS
+	CASE( 0x60 ): // RTS
 		pc = 1 + READ_LOW( sp );
 		pc += 0x100 * READ_LOW( 0x100 | (sp - 0xFF) );
 		sp = (sp - 0xFE) | 0x100;
-		goto loop;
+		NEXT_OP();
 	
 	{
 		fuint16 addr;
 		
-	case 0x99: // STA abs,Y
+	CASE( 0x99 ): // STA abs,Y
 		addr = y + GET_ADDR();
 		pc += 2;
 		if ( addr <= 0x7FF )
 		{
 			WRITE_LOW( addr, a );
-			goto loop;
+			NEXT_OP();
 		}
 		goto sta_ptr;
 	
-	case 0x8D: // STA abs
+	CASE( 0x8D ): // STA abs
 		addr = GET_ADDR();
 		pc += 2;
 		if ( addr <= 0x7FF )
 		{
 			WRITE_LOW( addr, a );
-			goto loop;
+			NEXT_OP();
 		}
 		goto sta_ptr;
 	
-	case 0x9D: // STA abs,X (slightly more common than STA abs)
+	CASE( 0x9D ): // STA abs,X (slightly more common than STA abs)
 		addr = x + GET_ADDR();
 		pc += 2;
 		if ( addr <= 0x7FF )
 		{
 			WRITE_LOW( addr, a );
-			goto loop;
+			NEXT_OP();
 		}
 	sta_ptr:
 		FLUSH_TIME();
 		WRITE( addr, a );
 		CACHE_TIME();
-		goto loop;
+		NEXT_OP();
 		
-	case 0x91: // STA (ind),Y
+	CASE( 0x91 ): // STA (ind),Y
 		IND_Y( NO_PAGE_CROSSING, addr )
 		pc++;
 		goto sta_ptr;
 	
-	case 0x81: // STA (ind,X)
+	CASE( 0x81 ): // STA (ind,X)
 		IND_X( addr )
 		pc++;
 		goto sta_ptr;
 	
 	}
 	
-	case 0xA9: // LDA #imm
+	CASE( 0xA9 ): // LDA #imm
 		pc++;
 		a  = data;
 		nz = data;
-		goto loop;
+		NEXT_OP();
 
 	// common read instructions
 	{
 		fuint16 addr;
 		
-	case 0xA1: // LDA (ind,X)
+	CASE( 0xA1 ): // LDA (ind,X)
 		IND_X( addr )
 		pc++;
 		goto a_nz_read_addr;
 	
-	case 0xB1:// LDA (ind),Y
+	CASE( 0xB1 ):// LDA (ind),Y
 		addr = READ_LOW( data ) + y;
 		HANDLE_PAGE_CROSSING( addr );
 		addr += 0x100 * READ_LOW( (uint8_t) (data + 1) );
 		pc++;
 		a = nz = READ_PROG( addr );
 		if ( (addr ^ 0x8000) <= 0x9FFF )
-			goto loop;
+			NEXT_OP();
 		goto a_nz_read_addr;
 	
-	case 0xB9: // LDA abs,Y
+	CASE( 0xB9 ): // LDA abs,Y
 		HANDLE_PAGE_CROSSING( data + y );
 		addr = GET_ADDR() + y;
 		pc += 2;
 		a = nz = READ_PROG( addr );
 		if ( (addr ^ 0x8000) <= 0x9FFF )
-			goto loop;
+			NEXT_OP();
 		goto a_nz_read_addr;
 	
-	case 0xBD: // LDA abs,X
+	CASE( 0xBD ): // LDA abs,X
 		HANDLE_PAGE_CROSSING( data + x );
 		addr = GET_ADDR() + x;
 		pc += 2;
 		a = nz = READ_PROG( addr );
 		if ( (addr ^ 0x8000) <= 0x9FFF )
-			goto loop;
+			NEXT_OP();
 	a_nz_read_addr:
 		FLUSH_TIME();
 		a = nz = READ( addr );
 		CACHE_TIME();
-		goto loop;
+		NEXT_OP();
 	
 	}
 
 // Branch
 
-	case 0x50: // BVC
+	CASE( 0x50 ): // BVC
 		BRANCH( !(status & st_v) )
 	
-	case 0x70: // BVS
+	CASE( 0x70 ): // BVS
 		BRANCH( status & st_v )
 	
-	case 0xB0: // BCS
+	CASE( 0xB0 ): // BCS
 		BRANCH( c & 0x100 )
 	
-	case 0x90: // BCC
+	CASE( 0x90 ): // BCC
 		BRANCH( !(c & 0x100) )
 	
 // Load/store
 	
-	case 0x94: // STY zp,x
+	CASE( 0x94 ): // STY zp,x
 		data = uint8_t (data + x);
-	case 0x84: // STY zp
+	CASE( 0x84 ): // STY zp
 		pc++;
 		WRITE_LOW( data, y );
 		goto loop;
 	
-	case 0x96: // STX zp,y
+	CASE( 0x96 ): // STX zp,y
 		data = uint8_t (data + y);
-	case 0x86: // STX zp
+	CASE( 0x86 ): // STX zp
 		pc++;
 		WRITE_LOW( data, x );
 		goto loop;
 	
-	case 0xB6: // LDX zp,y
+	CASE( 0xB6 ): // LDX zp,y
 		data = uint8_t (data + y);
-	case 0xA6: // LDX zp
+	CASE( 0xA6 ): // LDX zp
 		data = READ_LOW( data );
-	case 0xA2: // LDX #imm
+	CASE( 0xA2 ): // LDX #imm
 		pc++;
 		x = data;
 		nz = data;
 		goto loop;
 	
-	case 0xB4: // LDY zp,x
+	CASE( 0xB4 ): // LDY zp,x
 		data = uint8_t (data + x);
-	case 0xA4: // LDY zp
+	CASE( 0xA4 ): // LDY zp
 		data = READ_LOW( data );
-	case 0xA0: // LDY #imm
+	CASE( 0xA0 ): // LDY #imm
 		pc++;
 		y = data;
 		nz = data;
 		goto loop;
 	
-	case 0xBC: // LDY abs,X
+	CASE( 0xBC ): // LDY abs,X
 		data += x;
 		HANDLE_PAGE_CROSSING( data );
-	case 0xAC:{// LDY abs
+	CASE( 0xAC ):{// LDY abs
 		unsigned addr = data + 0x100 * GET_MSB();
 		pc += 2;
 		FLUSH_TIME();
@@ -537,10 +657,10 @@ imm##op:
 		goto loop;
 	}
 	
-	case 0xBE: // LDX abs,y
+	CASE( 0xBE ): // LDX abs,y
 		data += y;
 		HANDLE_PAGE_CROSSING( data );
-	case 0xAE:{// LDX abs
+	CASE( 0xAE ):{// LDX abs
 		unsigned addr = data + 0x100 * GET_MSB();
 		pc += 2;
 		FLUSH_TIME();
@@ -551,11 +671,11 @@ imm##op:
 	
 	{
 		fuint8 temp;
-	case 0x8C: // STY abs
+	CASE( 0x8C ): // STY abs
 		temp = y;
 		goto store_abs;
 	
-	case 0x8E: // STX abs
+	CASE( 0x8E ): // STX abs
 		temp = x;
 	store_abs:
 		unsigned addr = GET_ADDR();
@@ -573,7 +693,7 @@ imm##op:
 
 // Compare
 
-	case 0xEC:{// CPX abs
+	CASE( 0xEC ):{// CPX abs
 		unsigned addr = GET_ADDR();
 		pc++;
 		FLUSH_TIME();
@@ -582,9 +702,9 @@ imm##op:
 		goto cpx_data;
 	}
 	
-	case 0xE4: // CPX zp
+	CASE( 0xE4 ): // CPX zp
 		data = READ_LOW( data );
-	case 0xE0: // CPX #imm
+	CASE( 0xE0 ): // CPX #imm
 	cpx_data:
 		nz = x - data;
 		pc++;
@@ -592,7 +712,7 @@ imm##op:
 		nz &= 0xFF;
 		goto loop;
 	
-	case 0xCC:{// CPY abs
+	CASE( 0xCC ):{// CPY abs
 		unsigned addr = GET_ADDR();
 		pc++;
 		FLUSH_TIME();
@@ -601,9 +721,9 @@ imm##op:
 		goto cpy_data;
 	}
 	
-	case 0xC4: // CPY zp
+	CASE( 0xC4 ): // CPY zp
 		data = READ_LOW( data );
-	case 0xC0: // CPY #imm
+	CASE( 0xC0 ): // CPY #imm
 	cpy_data:
 		nz = y - data;
 		pc++;
@@ -628,7 +748,7 @@ imm##op:
 		pc++;
 		goto loop;
 	
-	case 0x2C:{// BIT abs
+	CASE( 0x2C ):{// BIT abs
 		unsigned addr = GET_ADDR();
 		pc += 2;
 		status &= ~st_v;
@@ -640,7 +760,7 @@ imm##op:
 		goto loop;
 	}
 	
-	case 0x24: // BIT zp
+	CASE( 0x24 ): // BIT zp
 		nz = READ_LOW( data );
 		pc++;
 		status &= ~st_v;
@@ -653,7 +773,7 @@ imm##op:
 // Add/subtract
 
 	ARITH_ADDR_MODES( 0xE5 ) // SBC
-	case 0xEB: // unofficial equivalent
+	CASE( 0xEB ): // unofficial equivalent
 		data ^= 0xFF;
 		goto adc_imm;
 	
@@ -671,22 +791,22 @@ imm##op:
 	
 // Shift/rotate
 
-	case 0x4A: // LSR A
+	CASE( 0x4A ): // LSR A
 		c = 0;
-	case 0x6A: // ROR A
+	CASE( 0x6A ): // ROR A
 		nz = c >> 1 & 0x80;
 		c = a << 8;
 		nz |= a >> 1;
 		a = nz;
 		goto loop;
 
-	case 0x0A: // ASL A
+	CASE( 0x0A ): // ASL A
 		nz = a << 1;
 		c = nz;
 		a = (uint8_t) nz;
 		goto loop;
 
-	case 0x2A: { // ROL A
+	CASE( 0x2A ): { // ROL A
 		nz = a << 1;
 		fint16 temp = c >> 8 & 1;
 		c = nz;
@@ -695,11 +815,11 @@ imm##op:
 		goto loop;
 	}
 	
-	case 0x5E: // LSR abs,X
+	CASE( 0x5E ): // LSR abs,X
 		data += x;
-	case 0x4E: // LSR abs
+	CASE( 0x4E ): // LSR abs
 		c = 0;
-	case 0x6E: // ROR abs
+	CASE( 0x6E ): // ROR abs
 	ror_abs: {
 		ADD_PAGE();
 		FLUSH_TIME();
@@ -709,15 +829,15 @@ imm##op:
 		goto rotate_common;
 	}
 	
-	case 0x3E: // ROL abs,X
+	CASE( 0x3E ): // ROL abs,X
 		data += x;
 		goto rol_abs;
 	
-	case 0x1E: // ASL abs,X
+	CASE( 0x1E ): // ASL abs,X
 		data += x;
-	case 0x0E: // ASL abs
+	CASE( 0x0E ): // ASL abs
 		c = 0;
-	case 0x2E: // ROL abs
+	CASE( 0x2E ): // ROL abs
 	rol_abs:
 		ADD_PAGE();
 		nz = c >> 8 & 1;
@@ -729,19 +849,19 @@ imm##op:
 		CACHE_TIME();
 		goto loop;
 	
-	case 0x7E: // ROR abs,X
+	CASE( 0x7E ): // ROR abs,X
 		data += x;
 		goto ror_abs;
 	
-	case 0x76: // ROR zp,x
+	CASE( 0x76 ): // ROR zp,x
 		data = uint8_t (data + x);
 		goto ror_zp;
 	
-	case 0x56: // LSR zp,x
+	CASE( 0x56 ): // LSR zp,x
 		data = uint8_t (data + x);
-	case 0x46: // LSR zp
+	CASE( 0x46 ): // LSR zp
 		c = 0;
-	case 0x66: // ROR zp
+	CASE( 0x66 ): // ROR zp
 	ror_zp: {
 		int temp = READ_LOW( data );
 		nz = (c >> 1 & 0x80) | (temp >> 1);
@@ -749,15 +869,15 @@ imm##op:
 		goto write_nz_zp;
 	}
 	
-	case 0x36: // ROL zp,x
+	CASE( 0x36 ): // ROL zp,x
 		data = uint8_t (data + x);
 		goto rol_zp;
 	
-	case 0x16: // ASL zp,x
+	CASE( 0x16 ): // ASL zp,x
 		data = uint8_t (data + x);
-	case 0x06: // ASL zp
+	CASE( 0x06 ): // ASL zp
 		c = 0;
-	case 0x26: // ROL zp
+	CASE( 0x26 ): // ROL zp
 	rol_zp:
 		nz = c >> 8 & 1;
 		nz |= (c = READ_LOW( data ) << 1);
@@ -765,21 +885,21 @@ imm##op:
 	
 // Increment/decrement
 
-	case 0xCA: // DEX
+	CASE( 0xCA ): // DEX
 		INC_DEC_XY( x, -1 )
 	
-	case 0x88: // DEY
+	CASE( 0x88 ): // DEY
 		INC_DEC_XY( y, -1 )
 	
-	case 0xF6: // INC zp,x
+	CASE( 0xF6 ): // INC zp,x
 		data = uint8_t (data + x);
-	case 0xE6: // INC zp
+	CASE( 0xE6 ): // INC zp
 		nz = 1;
 		goto add_nz_zp;
 	
-	case 0xD6: // DEC zp,x
+	CASE( 0xD6 ): // DEC zp,x
 		data = uint8_t (data + x);
-	case 0xC6: // DEC zp
+	CASE( 0xC6 ): // DEC zp
 		nz = (unsigned) -1;
 	add_nz_zp:
 		nz += READ_LOW( data );
@@ -788,21 +908,21 @@ imm##op:
 		WRITE_LOW( data, nz );
 		goto loop;
 	
-	case 0xFE: // INC abs,x
+	CASE( 0xFE ): // INC abs,x
 		data = x + GET_ADDR();
 		goto inc_ptr;
 	
-	case 0xEE: // INC abs
+	CASE( 0xEE ): // INC abs
 		data = GET_ADDR();
 	inc_ptr:
 		nz = 1;
 		goto inc_common;
 	
-	case 0xDE: // DEC abs,x
+	CASE( 0xDE ): // DEC abs,x
 		data = x + GET_ADDR();
 		goto dec_ptr;
 	
-	case 0xCE: // DEC abs
+	CASE( 0xCE ): // DEC abs
 		data = GET_ADDR();
 	dec_ptr:
 		nz = (unsigned) -1;
@@ -816,36 +936,36 @@ imm##op:
 		
 // Transfer
 
-	case 0xAA: // TAX
+	CASE( 0xAA ): // TAX
 		x  = a;
 		nz = a;
 		goto loop;
 		
-	case 0x8A: // TXA
+	CASE( 0x8A ): // TXA
 		a  = x;
 		nz = x;
 		goto loop;
 
-	case 0x9A: // TXS
+	CASE( 0x9A ): // TXS
 		SET_SP( x ); // verified (no flag change)
 		goto loop;
 	
-	case 0xBA: // TSX
+	CASE( 0xBA ): // TSX
 		x = nz = GET_SP();
 		goto loop;
 	
 // Stack
 	
-	case 0x48: // PHA
+	CASE( 0x48 ): // PHA
 		PUSH( a ); // verified
 		goto loop;
 		
-	case 0x68: // PLA
+	CASE( 0x68 ): // PLA
 		a = nz = READ_LOW( sp );
 		sp = (sp - 0xFF) | 0x100;
 		goto loop;
 		
-	case 0x40:{// RTI
+	CASE( 0x40 ):{// RTI
 		fuint8 temp = READ_LOW( sp );
 		pc  = READ_LOW( 0x100 | (sp - 0xFF) );
 		pc |= READ_LOW( 0x100 | (sp - 0xFE) ) * 0x100;
@@ -862,7 +982,7 @@ imm##op:
 		goto loop;
 	}
 	
-	case 0x28:{// PLP
+	CASE( 0x28 ):{// PLP
 		fuint8 temp = READ_LOW( sp );
 		sp = (sp - 0xFF) | 0x100;
 		fuint8 changed = status ^ temp;
@@ -874,14 +994,14 @@ imm##op:
 		goto handle_cli;
 	}
 	
-	case 0x08: { // PHP
+	CASE( 0x08 ): { // PHP
 		fuint8 temp;
 		CALC_STATUS( temp );
 		PUSH( temp | (st_b | st_r) );
 		goto loop;
 	}
 	
-	case 0x6C:{// JMP (ind)
+	CASE( 0x6C ):{// JMP (ind)
 		data = GET_ADDR();
 		check( unsigned (data - 0x2000) >= 0x4000 ); // ensure it's outside I/O space
 		uint8_t const* page = s.code_map [data >> page_bits];
@@ -891,32 +1011,32 @@ imm##op:
 		goto loop;
 	}
 	
-	case 0x00: // BRK
+	CASE( 0x00 ): // BRK
 		goto handle_brk;
 	
 // Flags
 
-	case 0x38: // SEC
+	CASE( 0x38 ): // SEC
 		c = (unsigned) ~0;
 		goto loop;
 	
-	case 0x18: // CLC
+	CASE( 0x18 ): // CLC
 		c = 0;
 		goto loop;
 		
-	case 0xB8: // CLV
+	CASE( 0xB8 ): // CLV
 		status &= ~st_v;
 		goto loop;
 	
-	case 0xD8: // CLD
+	CASE( 0xD8 ): // CLD
 		status &= ~st_d;
 		goto loop;
 	
-	case 0xF8: // SED
+	CASE( 0xF8 ): // SED
 		status |= st_d;
 		goto loop;
 	
-	case 0x58: // CLI
+	CASE( 0x58 ): // CLI
 		if ( !(status & st_i) )
 			goto loop;
 		status &= ~st_i;
@@ -948,7 +1068,7 @@ imm##op:
 		goto loop;
 	}
 	
-	case 0x78: // SEI
+	CASE( 0x78 ): // SEI
 		if ( status & st_i )
 			goto loop;
 		status |= st_i;
@@ -967,21 +1087,21 @@ imm##op:
 // Unofficial
 	
 	// SKW - Skip word
-	case 0x1C: case 0x3C: case 0x5C: case 0x7C: case 0xDC: case 0xFC:
+	CASE( 0x1C ): CASE( 0x3C ): CASE( 0x5C ): CASE( 0x7C ): CASE( 0xDC ): CASE( 0xFC ):
 		HANDLE_PAGE_CROSSING( data + x );
-	case 0x0C:
+	CASE( 0x0C ):
 		pc++;
 	// SKB - Skip byte
-	case 0x74: case 0x04: case 0x14: case 0x34: case 0x44: case 0x54: case 0x64:
-	case 0x80: case 0x82: case 0x89: case 0xC2: case 0xD4: case 0xE2: case 0xF4:
+	CASE( 0x74 ): CASE( 0x04 ): CASE( 0x14 ): CASE( 0x34 ): CASE( 0x44 ): CASE( 0x54 ): CASE( 0x64 ):
+	CASE( 0x80 ): CASE( 0x82 ): CASE( 0x89 ): CASE( 0xC2 ): CASE( 0xD4 ): CASE( 0xE2 ): CASE( 0xF4 ):
 		pc++;
 		goto loop;
 	
 	// NOP
-	case 0xEA: case 0x1A: case 0x3A: case 0x5A: case 0x7A: case 0xDA: case 0xFA:
+	CASE( 0xEA ): CASE( 0x1A ): CASE( 0x3A ): CASE( 0x5A ): CASE( 0x7A ): CASE( 0xDA ): CASE( 0xFA ):
 		goto loop;
 
-	case bad_opcode: // HLT
+	CASE( 0xF2 ): // HLT (bad_opcode)
 		pc--;
 		if ( pc > 0xFFFF )
 		{
@@ -989,15 +1109,15 @@ imm##op:
 			pc &= 0xFFFF;
 			goto loop;
 		}
-	case 0x02: case 0x12: case 0x22: case 0x32: case 0x42: case 0x52:
-	case 0x62: case 0x72: case 0x92: case 0xB2: case 0xD2:
+	CASE( 0x02 ): CASE( 0x12 ): CASE( 0x22 ): CASE( 0x32 ): CASE( 0x42 ): CASE( 0x52 ):
+	CASE( 0x62 ): CASE( 0x72 ): CASE( 0x92 ): CASE( 0xB2 ): CASE( 0xD2 ):
 		goto stop;
 	
 // Unimplemented
 	
-	case 0xFF: // force 256-entry jump table for optimization purposes
+	CASE( 0xFF ): // force 256-entry jump table for optimization purposes
 		c |= 1;
-	default:
+	DEFAULT_CASE:
 		check( (unsigned) opcode <= 0xFF );
 		// skip over proper number of bytes
 		static unsigned char const illop_lens [8] = {
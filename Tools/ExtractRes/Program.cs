@@ -1094,35 +1094,39 @@ namespace ExtractRes
             public string Filename;
         }
 
+        const short PotionTrack = 22;
+
+        delegate void WriteSamples( short[] buffer, int count );
+
         private static void ExtractSongs( Options options )
         {
             byte[] nsfImage = BuildMemoryNsf( options, "NsfSong.csv" );
 
             string[] songFilenames = 
             {
-                "01_prelude.wav",
-                "02_opening.wav",
-                "03_ending.wav",
-                "04_field.wav",
-                "05_ship.wav",
-                "06_airship.wav",
-                "07_town.wav",
-                "08_castle.wav",
-                "09_volcano.wav",
-                "10_matoya.wav",
-                "11_dungeon.wav",
-                "12_temple.wav",
-                "13_sky.wav",
-                "14_sea_shrine.wav",
-                "15_shop.wav",
-                "16_battle.wav",
-                "17_menu.wav",
-                "18_dead.wav",
-                "19_victory.wav",
-                "20_fanfare.wav",
-                "21_unknown.wav",
-                "22_save.wav",
-                "23_unknown.wav"
+                "01_prelude.flac",
+                "02_opening.flac",
+                "03_ending.flac",
+                "04_field.flac",
+                "05_ship.flac",
+                "06_airship.flac",
+                "07_town.flac",
+                "08_castle.flac",
+                "09_volcano.flac",
+                "10_matoya.flac",
+                "11_dungeon.flac",
+                "12_temple.flac",
+                "13_sky.flac",
+                "14_sea_shrine.flac",
+                "15_shop.flac",
+                "16_battle.flac",
+                "17_menu.flac",
+                "18_dead.flac",
+                "19_victory.flac",
+                "20_fanfare.flac",
+                "21_unknown.flac",
+                "22_save.flac",
+                "23_unknown.flac"
             };
 
             LoopPoints[] loopPoints = ExtractLoopPoints( options );
@@ -1140,10 +1144,14 @@ namespace ExtractRes
                 ExtractSoundFile( nsfImage, options, item );
             }
 
-            File.Copy( 
-                options.MakeOutPath( "23_unknown.wav" ), 
-                options.MakeOutPath( "ff1-sfx-potion.wav" ), 
-                true );
+            // The potion effect is the last song, but effects are loaded 
+            // whole by the game, so they're kept as WAV
+            SoundItem potion = new SoundItem();
+            potion.Track = PotionTrack;
+            potion.Filename = "ff1-sfx-potion.wav";
+            potion.Begin = (short) loopPoints[PotionTrack].Begin;
+            potion.End = (short) loopPoints[PotionTrack].End;
+            ExtractSoundFile( nsfImage, options, potion );
         }
 
         struct SfxFileDesc
@@ -1206,31 +1214,55 @@ namespace ExtractRes
         private static void ExtractSoundFile( byte[] nsfImage, Options options, SoundItem item )
         {
             const int SampleRate = 44100;
-            const double SampleRateMs = SampleRate / 1000.0;
-            const double MillisecondsAFrame = 1000.0 / 60.0;
 
             string outPath = options.MakeOutPath( item.Filename );
+
+            // Songs are streamed by the game, so they're written as FLAC.
+            // Effects are loaded whole with al_load_sample, so they stay WAV.
+
+            if ( Path.GetExtension( outPath ).Equals( ".flac", StringComparison.OrdinalIgnoreCase ) )
+            {
+                using ( ExtractNsf.FlacWriter flacWriter = new ExtractNsf.FlacWriter( SampleRate, outPath ) )
+                {
+                    flacWriter.EnableStereo();
+                    RenderSoundFile( nsfImage, SampleRate, item, 
+                        delegate ( short[] buffer, int count ) { flacWriter.Write( buffer, count, 1 ); } );
+                }
+            }
+            else
+            {
+                using ( ExtractNsf.WaveWriter waveWriter = new ExtractNsf.WaveWriter( SampleRate, outPath ) )
+                {
+                    waveWriter.EnableStereo();
+                    RenderSoundFile( nsfImage, SampleRate, item, 
+                        delegate ( short[] buffer, int count ) { waveWriter.Write( buffer, count, 1 ); } );
+                }
+            }
+        }
+
+        private static void RenderSoundFile( byte[] nsfImage, int sampleRate, SoundItem item, WriteSamples write )
+        {
+            double sampleRateMs = sampleRate / 1000.0;
+            const double MillisecondsAFrame = 1000.0 / 60.0;
+
             using ( ExtractNsf.NsfEmu emu = new ExtractNsf.NsfEmu() )
-            using ( ExtractNsf.WaveWriter waveWriter = new ExtractNsf.WaveWriter( SampleRate, outPath ) )
             {
-                emu.SampleRate = SampleRate;
+                emu.SampleRate = sampleRate;
                 emu.LoadMem( nsfImage, nsfImage.Length );
                 emu.StartTrack( item.Track );
 
-                waveWriter.EnableStereo();
-
                 short[] buffer = new short[1024];
                 int limit = (int) (item.End * MillisecondsAFrame);
                 while ( emu.Tell < limit )
                 {
                     int count = buffer.Length;
-                    int samplesRem = (int) (SampleRateMs * (limit - emu.Tell));
+                    int samplesRem = (int) (sampleRateMs * (limit - emu.Tell));
                     if ( samplesRem < count )
                     {
                         count = (int) ((samplesRem + 1) & 0xFFFFFFFE);
                     }
                     emu.Play( count, buffer );
-                    waveWriter.Write( buffer, count, 1 );
+                    write( buffer, count );
                 }
             }
         }
@@ -1577,6 +1609,130 @@ namespace ExtractRes
 
                     writer.Write( rowData );
                 }
+
+                // The game streams the map in chunks from this file, if it's there
+
+                byte[] cells = new byte[256 * 256];
+
+                for ( int i = 0; i < rowPtrs.Length; i++ )
+                {
+                    DecompressMapCells( rowData, rowPtrs[i] - rowPtrs[0], cells, i * 256 );
+                }
+
+                WriteChunkMap( options.MakeOutPath( @"owMap.chk" ), cells, 256, 256 );
+            }
+        }
+
+        private static void DecompressMapCells( byte[] compressed, int pos, byte[] cells, int cellPos )
+        {
+            for ( ; compressed[pos] != 0xff; pos++ )
+            {
+                if ( (compressed[pos] & 0x80) != 0 )
+                {
+                    byte tileRef = (byte) (compressed[pos++] & 0x7f);
+                    int count = compressed[pos];
+
+                    if ( count == 0 )
+                        count = 256;
+
+                    for ( int i = 0; i < count; i++ )
+                    {
+                        cells[cellPos++] = tileRef;
+                    }
+                }
+                else
+                {
+                    cells[cellPos++] = compressed[pos];
+                }
+            }
+        }
+
+        private static void CompressMapCells( byte[] cells, int[] cellIndexes, List<byte> compressed )
+        {
+            // Same format as the map rows in the ROM: a tile ref with the top bit 
+            // set is followed by a run length, where 0 means 256.
+
+            for ( int i = 0; i < cellIndexes.Length; )
+            {
+                byte tileRef = cells[cellIndexes[i]];
+                int count = 1;
+
+                while ( i + count < cellIndexes.Length 
+                    && count < 256 
+                    && cells[cellIndexes[i + count]] == tileRef )
+                {
+                    count++;
+                }
+
+                if ( tileRef == 0x7f )
+                {
+                    // A run of this one would read as the end marker
+                    for ( int j = 0; j < count; j++ )
+                    {
+                        compressed.Add( tileRef );
+                    }
+                }
+                else if ( count == 1 )
+                {
+                    compressed.Add( tileRef );
+                }
+                else
+                {
+                    compressed.Add( (byte) (tileRef | 0x80) );
+                    compressed.Add( (byte) (count & 0xff) );
+                }
+
+                i += count;
+            }
+
+            compressed.Add( 0xff );
+        }
+
+        private static void WriteChunkMap( string path, byte[] cells, int cols, int rows )
+        {
+            const int ChunkSize = 32;
+
+            int chunkCols = cols / ChunkSize;
+            int chunkRows = rows / ChunkSize;
+            uint[] offsets = new uint[chunkCols * chunkRows + 1];
+            List<byte> chunkData = new List<byte>();
+            int[] cellIndexes = new int[ChunkSize * ChunkSize];
+
+            for ( int chunkRow = 0; chunkRow < chunkRows; chunkRow++ )
+            {
+                for ( int chunkCol = 0; chunkCol < chunkCols; chunkCol++ )
+                {
+                    for ( int r = 0; r < ChunkSize; r++ )
+                    {
+                        for ( int c = 0; c < ChunkSize; c++ )
+                        {
+                            int row = chunkRow * ChunkSize + r;
+                            int col = chunkCol * ChunkSize + c;
+                            cellIndexes[r * ChunkSize + c] = row * cols + col;
+                        }
+                    }
+
+                    offsets[chunkRow * chunkCols + chunkCol] = (uint) chunkData.Count;
+                    CompressMapCells( cells, cellIndexes, chunkData );
+                }
+            }
+
+            offsets[offsets.Length - 1] = (uint) chunkData.Count;
+
+            using ( BinaryWriter writer = new BinaryWriter( Utility.TruncateFile( path ) ) )
+            {
+                writer.Write( Encoding.ASCII.GetBytes( "FFCM" ) );
+                writer.Write( (ushort) cols );
+                writer.Write( (ushort) rows );
+                writer.Write( (ushort) ChunkSize );
+                writer.Write( (ushort) 0 );
+
+                foreach ( uint offset in offsets )
+                {
+                    writer.Write( offset );
+                }
+
+                writer.Write( chunkData.ToArray() );
             }
         }
 
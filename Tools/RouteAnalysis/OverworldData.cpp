@@ -0,0 +1,198 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "stdafx.h"
+#include "OverworldData.h"
+#include "OWTile.h"
+
+
+// Battle domains of the water, after the 64 domains of land
+const int NorthRiverDomain = 0x40;
+const int SouthRiverDomain = 0x41;
+const int SeaDomain = 0x42;
+const int RiverHalfRow = 128;
+
+const int LandBattleRate = 10;
+const int SeaBattleRate = 3;
+
+
+template <typename T>
+static bool LoadList( const char* folder, const char* filename, T* list, size_t length )
+{
+    char path[260];
+    FILE* file = nullptr;
+
+    sprintf_s( path, "%s\\%s", folder, filename );
+
+    errno_t err = fopen_s( &file, path, "rb" );
+    if ( err != 0 )
+    {
+        fprintf( stderr, "Couldn't open %s\n", path );
+        return false;
+    }
+
+    size_t read = fread( list, sizeof( T ), length, file );
+    fclose( file );
+
+    if ( read != length )
+    {
+        fprintf( stderr, "%s is too short\n", path );
+        return false;
+    }
+
+    return true;
+}
+
+// Decodes a map row the same way as DecompressMap in the game
+
+static const uint8_t* DecompressRow( const uint8_t* compressedCells, const uint8_t* end, uint8_t* rowRefs )
+{
+    int col = 0;
+
+    for ( ; compressedCells < end && *compressedCells != 0xff; compressedCells++ )
+    {
+        int tileRef = *compressedCells;
+        int count = 1;
+
+        if ( (int8_t) *compressedCells < 0 )
+        {
+            if ( compressedCells + 1 >= end )
+                return nullptr;
+
+            tileRef &= 0x7f;
+            count = *++compressedCells;
+
+            if ( count == 0 )
+                count = 256;
+        }
+
+        if ( col + count > OverworldData::Cols )
+            return nullptr;
+
+        memset( rowRefs + col, tileRef, count );
+        col += count;
+    }
+
+    if ( col != OverworldData::Cols )
+        return nullptr;
+
+    return compressedCells;
+}
+
+
+bool OverworldData::Load( const char* folder )
+{
+    char path[260];
+
+    sprintf_s( path, "%s\\%s", folder, "owMap.tab" );
+
+    if ( !LoadMap( path ) )
+        return false;
+
+    if ( !LoadList( folder, "owTileAttr.dat", tileAttr, TileTypes ) )
+        return false;
+
+    if ( !LoadList( folder, "enterTeleports.dat", enterTeleports, EnterTeleports ) )
+        return false;
+
+    if ( !LoadList( folder, "exitTeleports.dat", exitTeleports, ExitTeleports ) )
+        return false;
+
+    if ( !LoadList( folder, "domains.dat", domains, Domains ) )
+        return false;
+
+    if ( !LoadList( folder, "formationWeights.dat", formationWeights, FormationWeights ) )
+        return false;
+
+    return true;
+}
+
+// The map is a table of rows: the offset of each row from the end of the
+// offsets, and then the compressed rows.
+
+bool OverworldData::LoadMap( const char* path )
+{
+    FILE* file = nullptr;
+
+    errno_t err = fopen_s( &file, path, "rb" );
+    if ( err != 0 )
+    {
+        fprintf( stderr, "Couldn't open %s\n", path );
+        return false;
+    }
+
+    fseek( file, 0, SEEK_END );
+    long fileSize = ftell( file );
+    fseek( file, 0, SEEK_SET );
+
+    uint16_t offsets[Rows];
+    long heapSize = fileSize - (long) sizeof offsets;
+
+    if ( heapSize <= 0 )
+    {
+        fclose( file );
+        fprintf( stderr, "%s is too short\n", path );
+        return false;
+    }
+
+    std::vector<uint8_t> heap( heapSize );
+
+    fread( offsets, 1, sizeof offsets, file );
+    fread( heap.data(), 1, heapSize, file );
+    fclose( file );
+
+    const uint8_t* end = heap.data() + heapSize;
+
+    for ( int row = 0; row < Rows; row++ )
+    {
+        if ( offsets[row] >= heapSize
+            || DecompressRow( heap.data() + offsets[row], end, tileRefs[row] ) == nullptr )
+        {
+            fprintf( stderr, "Row %d of %s is bad\n", row, path );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int OverworldData::GetFightDomain( uint16_t attrs, int col, int row )
+{
+    if ( !OWTile::CanFight( attrs ) )
+        return NoDomain;
+
+    if ( (col == BridgeCol && row == BridgeRow)
+        || (col == IsmusCol && row == IsmusRow) )
+        return NoDomain;
+
+    int generalDomain = OWTile::GetFightDomain( attrs );
+
+    if ( generalDomain == OWTile::Sea )
+        return SeaDomain;
+
+    if ( generalDomain == OWTile::River )
+    {
+        if ( row < RiverHalfRow )
+            return NorthRiverDomain;
+        else
+            return SouthRiverDomain;
+    }
+
+    // Land is split into 8x8 areas
+    int domainCol = col / 32;
+    int domainRow = row / 32;
+
+    return domainCol | (domainRow << 3);
+}
+
+int OverworldData::GetDomainBattleRate( int domain )
+{
+    if ( domain == NoDomain )
+        return 0;
+
+    return (domain == SeaDomain) ? SeaBattleRate : LandBattleRate;
+}
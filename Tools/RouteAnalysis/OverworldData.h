@@ -0,0 +1,67 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+
+// Laid out like LTeleport and OWTeleport in the game
+
+struct EnterTeleport
+{
+    uint8_t Col;
+    uint8_t Row;
+    uint8_t MapId;
+    uint8_t Reserved;
+};
+
+struct ExitTeleport
+{
+    uint8_t Col;
+    uint8_t Row;
+};
+
+
+// The parts of the extracted game data that decide where the party can go
+// on the overworld, and what it fights there.
+
+class OverworldData
+{
+public:
+    static const int Cols = 256;
+    static const int Rows = 256;
+    static const int TileTypes = 128;
+    static const int EnterTeleports = 32;
+    static const int ExitTeleports = 16;
+    static const int Domains = 128;
+    static const int DomainFormations = 8;
+    static const int FormationWeights = 64;
+
+    static const int NoDomain = 0xff;
+    static const int MaxRate = 256;
+
+    uint8_t tileRefs[Rows][Cols];
+    uint16_t tileAttr[TileTypes];
+    EnterTeleport enterTeleports[EnterTeleports];
+    ExitTeleport exitTeleports[ExitTeleports];
+    uint8_t domains[Domains][DomainFormations];
+    uint8_t formationWeights[FormationWeights];
+
+    // Reads the files that ExtractRes writes from a folder
+    bool Load( const char* folder );
+
+    // The same as Overworld::GetFightDomain and GetDomainBattleRate
+    static int GetFightDomain( uint16_t attrs, int col, int row );
+    static int GetDomainBattleRate( int domain );
+
+    static const int BridgeCol = 152;
+    static const int BridgeRow = 152;
+    static const int IsmusCol = 102;
+    static const int IsmusRow = 164;
+
+private:
+    bool LoadMap( const char* path );
+};
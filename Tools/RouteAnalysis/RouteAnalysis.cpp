@@ -0,0 +1,389 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+// Finds the routes with the fewest expected battles between every pair of
+// landmarks on the overworld, and writes out how risky and how long they
+// are.
+
+#include "stdafx.h"
+#include "OverworldData.h"
+#include "RouteFinder.h"
+#include "OWTile.h"
+
+
+struct Landmark
+{
+    char Name[32];
+    std::vector<int> Tiles;
+};
+
+struct RouteResult
+{
+    bool Reachable;
+    uint32_t RateSum;
+    uint32_t Steps;
+    int Target;
+    uint32_t DomainRates[OverworldData::Domains];
+};
+
+struct FormationCount
+{
+    int FormationId;
+    double Battles;
+};
+
+
+static OverworldData data;
+static RouteMap routeMap;
+
+
+static void ShowUsage()
+{
+    printf( "Usage: RouteAnalysis [options] <data folder> <output folder>\n" );
+    printf( "\n" );
+    printf( "Options:\n" );
+    printf( "  -canoe       the party has the canoe\n" );
+    printf( "  -chime       the party has the chime\n" );
+    printf( "  -nobridge    the bridge hasn't been built\n" );
+    printf( "  -canal       the canal has been dug, so the isthmus can't be walked\n" );
+    printf( "  -threads N   the number of threads to use; all cores by default\n" );
+}
+
+// Every teleport on the map is a landmark, made of all the tiles that lead
+// to it. So are the places where the party comes out of a level.
+
+static void FindLandmarks( std::vector<Landmark>& landmarks )
+{
+    std::vector<int> enterTiles[OverworldData::EnterTeleports];
+
+    for ( int row = 0; row < OverworldData::Rows; row++ )
+    {
+        for ( int col = 0; col < OverworldData::Cols; col++ )
+        {
+            uint16_t attrs = data.tileAttr[data.tileRefs[row][col] % OverworldData::TileTypes];
+
+            if ( OWTile::IsTeleport( attrs ) )
+                enterTiles[OWTile::GetTeleport( attrs )].push_back( col + row * RouteMap::Cols );
+        }
+    }
+
+    for ( int i = 0; i < OverworldData::EnterTeleports; i++ )
+    {
+        if ( enterTiles[i].empty() )
+            continue;
+
+        Landmark landmark;
+
+        sprintf_s( landmark.Name, "enter%02d-map%02d", i, data.enterTeleports[i].MapId );
+        landmark.Tiles = enterTiles[i];
+        landmarks.push_back( landmark );
+    }
+
+    for ( int i = 0; i < OverworldData::ExitTeleports; i++ )
+    {
+        ExitTeleport& teleport = data.exitTeleports[i];
+
+        if ( teleport.Col == 0 && teleport.Row == 0 )
+            continue;
+
+        Landmark landmark;
+
+        sprintf_s( landmark.Name, "exit%02d", i );
+        landmark.Tiles.push_back( teleport.Col + teleport.Row * RouteMap::Cols );
+        landmarks.push_back( landmark );
+    }
+}
+
+// Each landmark is the source of one search. Threads take the next source
+// that's left, and write to their own row of results.
+
+static void FindRoutes(
+    const std::vector<Landmark>& landmarks,
+    std::vector<RouteResult>& results,
+    int threadCount )
+{
+    size_t count = landmarks.size();
+    std::atomic<size_t> nextSource( 0 );
+
+    auto work = [&]()
+    {
+        RouteSearch search;
+
+        for ( size_t source = nextSource++; source < count; source = nextSource++ )
+        {
+            search.Run( routeMap, landmarks[source].Tiles );
+
+            for ( size_t target = 0; target < count; target++ )
+            {
+                RouteResult& result = results[source * count + target];
+
+                memset( &result, 0, sizeof result );
+                result.Target = RouteSearch::NoTile;
+
+                // The closest tile of the target is the end of the route
+
+                for ( int tile : landmarks[target].Tiles )
+                {
+                    if ( !search.IsReachable( tile ) )
+                        continue;
+
+                    if ( !result.Reachable
+                        || search.GetRateSum( tile ) < result.RateSum
+                        || (search.GetRateSum( tile ) == result.RateSum && search.GetSteps( tile ) < result.Steps) )
+                    {
+                        result.Reachable = true;
+                        result.RateSum = search.GetRateSum( tile );
+                        result.Steps = search.GetSteps( tile );
+                        result.Target = tile;
+                    }
+                }
+
+                if ( result.Reachable )
+                    search.AddDomainRates( routeMap, result.Target, result.DomainRates );
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for ( int i = 1; i < threadCount; i++ )
+        threads.push_back( std::thread( work ) );
+
+    work();
+
+    for ( std::thread& thread : threads )
+        thread.join();
+}
+
+static double GetExpectedBattles( uint32_t rateSum )
+{
+    return (double) rateSum / OverworldData::MaxRate;
+}
+
+// Spreads the battles expected in each domain over the formations that the
+// domain's weights pick, and returns the formations from most to least
+// expected.
+
+static void GetFormations( const RouteResult& result, std::vector<FormationCount>& formations )
+{
+    double battles[256] = { 0 };
+
+    for ( int domain = 0; domain < OverworldData::Domains; domain++ )
+    {
+        if ( result.DomainRates[domain] == 0 )
+            continue;
+
+        double share = GetExpectedBattles( result.DomainRates[domain] ) / OverworldData::FormationWeights;
+
+        for ( int i = 0; i < OverworldData::FormationWeights; i++ )
+        {
+            int index = data.formationWeights[i] % OverworldData::DomainFormations;
+
+            battles[data.domains[domain][index]] += share;
+        }
+    }
+
+    formations.clear();
+
+    for ( int i = 0; i < _countof( battles ); i++ )
+    {
+        if ( battles[i] > 0 )
+        {
+            FormationCount formation = { i, battles[i] };
+            formations.push_back( formation );
+        }
+    }
+
+    std::sort( formations.begin(), formations.end(),
+        []( const FormationCount& a, const FormationCount& b ) { return a.Battles > b.Battles; } );
+}
+
+static FILE* OpenOutput( const char* folder, const char* filename )
+{
+    char path[260];
+    FILE* file = nullptr;
+
+    sprintf_s( path, "%s\\%s", folder, filename );
+
+    errno_t err = fopen_s( &file, path, "w" );
+    if ( err != 0 )
+    {
+        fprintf( stderr, "Couldn't write %s\n", path );
+        return nullptr;
+    }
+
+    return file;
+}
+
+// The matrix has a row for each source and a column for each target.
+// Routes that can't be taken are left empty.
+
+static bool WriteMatrix(
+    const char* folder,
+    const char* filename,
+    const std::vector<Landmark>& landmarks,
+    const std::vector<RouteResult>& results,
+    bool steps )
+{
+    FILE* file = OpenOutput( folder, filename );
+    if ( file == nullptr )
+        return false;
+
+    size_t count = landmarks.size();
+
+    for ( size_t target = 0; target < count; target++ )
+        fprintf( file, ",%s", landmarks[target].Name );
+
+    fprintf( file, "\n" );
+
+    for ( size_t source = 0; source < count; source++ )
+    {
+        fprintf( file, "%s", landmarks[source].Name );
+
+        for ( size_t target = 0; target < count; target++ )
+        {
+            const RouteResult& result = results[source * count + target];
+
+            if ( !result.Reachable )
+                fprintf( file, "," );
+            else if ( steps )
+                fprintf( file, ",%u", result.Steps );
+            else
+                fprintf( file, ",%.3f", GetExpectedBattles( result.RateSum ) );
+        }
+
+        fprintf( file, "\n" );
+    }
+
+    fclose( file );
+    return true;
+}
+
+static bool WriteRoutes(
+    const char* folder,
+    const std::vector<Landmark>& landmarks,
+    const std::vector<RouteResult>& results )
+{
+    const int MaxFormationsShown = 3;
+
+    FILE* file = OpenOutput( folder, "routes.csv" );
+    if ( file == nullptr )
+        return false;
+
+    size_t count = landmarks.size();
+    std::vector<FormationCount> formations;
+
+    fprintf( file, "From,To,EndCol,EndRow,Steps,ExpectedBattles,LikelyFormations\n" );
+
+    for ( size_t source = 0; source < count; source++ )
+    {
+        for ( size_t target = 0; target < count; target++ )
+        {
+            const RouteResult& result = results[source * count + target];
+
+            if ( source == target || !result.Reachable )
+                continue;
+
+            fprintf( file, "%s,%s,%d,%d,%u,%.3f,",
+                landmarks[source].Name,
+                landmarks[target].Name,
+                result.Target % RouteMap::Cols,
+                result.Target / RouteMap::Cols,
+                result.Steps,
+                GetExpectedBattles( result.RateSum ) );
+
+            GetFormations( result, formations );
+
+            for ( size_t i = 0; i < formations.size() && i < MaxFormationsShown; i++ )
+            {
+                fprintf( file, "%s%02X:%.3f",
+                    (i > 0) ? " " : "",
+                    formations[i].FormationId,
+                    formations[i].Battles );
+            }
+
+            fprintf( file, "\n" );
+        }
+    }
+
+    fclose( file );
+    return true;
+}
+
+int main( int argc, char* argv[] )
+{
+    RouteOptions options = { 0 };
+    int threadCount = (int) std::thread::hardware_concurrency();
+    const char* dataFolder = nullptr;
+    const char* outFolder = nullptr;
+
+    options.Bridge = true;
+    options.CanalBlocked = true;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( strcmp( argv[i], "-canoe" ) == 0 )
+            options.Canoe = true;
+        else if ( strcmp( argv[i], "-chime" ) == 0 )
+            options.Chime = true;
+        else if ( strcmp( argv[i], "-nobridge" ) == 0 )
+            options.Bridge = false;
+        else if ( strcmp( argv[i], "-canal" ) == 0 )
+            options.CanalBlocked = false;
+        else if ( strcmp( argv[i], "-threads" ) == 0 && i + 1 < argc )
+            threadCount = atoi( argv[++i] );
+        else if ( dataFolder == nullptr )
+            dataFolder = argv[i];
+        else if ( outFolder == nullptr )
+            outFolder = argv[i];
+        else
+        {
+            ShowUsage();
+            return 1;
+        }
+    }
+
+    if ( dataFolder == nullptr || outFolder == nullptr )
+    {
+        ShowUsage();
+        return 1;
+    }
+
+    if ( threadCount < 1 )
+        threadCount = 1;
+
+    if ( !data.Load( dataFolder ) )
+        return 1;
+
+    auto start = std::chrono::steady_clock::now();
+
+    routeMap.Make( data, options );
+
+    std::vector<Landmark> landmarks;
+
+    FindLandmarks( landmarks );
+
+    std::vector<RouteResult> results( landmarks.size() * landmarks.size() );
+
+    FindRoutes( landmarks, results, threadCount );
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf( "Found routes between %d landmarks in %.3f seconds on %d threads\n",
+        (int) landmarks.size(), elapsed.count(), threadCount );
+
+    if ( !WriteMatrix( outFolder, "battles.csv", landmarks, results, false ) )
+        return 1;
+
+    if ( !WriteMatrix( outFolder, "steps.csv", landmarks, results, true ) )
+        return 1;
+
+    if ( !WriteRoutes( outFolder, landmarks, results ) )
+        return 1;
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#include "stdafx.h"
+#include "RouteFinder.h"
+#include "OverworldData.h"
+#include "OWTile.h"
+
+
+void RouteMap::Make( const OverworldData& data, const RouteOptions& options )
+{
+    for ( int row = 0; row < Rows; row++ )
+    {
+        for ( int col = 0; col < Cols; col++ )
+        {
+            int tile = col + row * Cols;
+            uint16_t attrs = data.tileAttr[data.tileRefs[row][col] % OverworldData::TileTypes];
+
+            // The same rules as the routes that the game finds, but with the
+            // bridge and canal given by the options
+
+            bool walk = OWTile::CanWalk( attrs )
+                && (OWTile::GetSpecial( attrs ) != OWTile::S_Chime || options.Chime);
+
+            if ( col == OverworldData::BridgeCol && row == OverworldData::BridgeRow && options.Bridge )
+                walk = true;
+
+            if ( col == OverworldData::IsmusCol && row == OverworldData::IsmusRow && options.CanalBlocked )
+                walk = true;
+
+            bool enter = walk || (options.Canoe && OWTile::CanCanoe( attrs ));
+
+            int domain = OverworldData::GetFightDomain( attrs, col, row );
+
+            flags[tile] = 0;
+
+            if ( enter )
+                flags[tile] |= Flag_Enter;
+
+            if ( OWTile::IsTeleport( attrs ) )
+            {
+                flags[tile] |= Flag_Teleport;
+
+                // The teleport is taken before there's a chance of a battle
+                domain = OverworldData::NoDomain;
+            }
+
+            domains[tile] = domain;
+            rates[tile] = OverworldData::GetDomainBattleRate( domain );
+        }
+    }
+}
+
+int RouteMap::GetNeighbor( int tile, int dir )
+{
+    int col = tile % Cols;
+    int row = tile / Cols;
+
+    // The map wraps around at the edges
+
+    switch ( dir )
+    {
+    case 0: col = (col + 1) % Cols; break;
+    case 1: col = (col + Cols - 1) % Cols; break;
+    case 2: row = (row + 1) % Rows; break;
+    case 3: row = (row + Rows - 1) % Rows; break;
+    }
+
+    return col + row * Cols;
+}
+
+
+RouteSearch::RouteSearch()
+    :   costs( RouteMap::Tiles ),
+        prevTiles( RouteMap::Tiles )
+{
+}
+
+void RouteSearch::Run( const RouteMap& map, const std::vector<int>& sources )
+{
+    typedef std::pair<uint64_t, int> Entry;
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    std::fill( costs.begin(), costs.end(), Unreached );
+    std::fill( prevTiles.begin(), prevTiles.end(), NoTile );
+
+    for ( int tile : sources )
+    {
+        costs[tile] = 0;
+        queue.push( Entry( 0, tile ) );
+    }
+
+    while ( !queue.empty() )
+    {
+        Entry entry = queue.top();
+        queue.pop();
+
+        int tile = entry.second;
+
+        if ( entry.first != costs[tile] )
+            continue;
+
+        // A route only leaves a teleport if it started there
+
+        if ( map.IsTeleport( tile ) && prevTiles[tile] != NoTile )
+            continue;
+
+        for ( int dir = 0; dir < 4; dir++ )
+        {
+            int next = RouteMap::GetNeighbor( tile, dir );
+
+            if ( !map.CanEnter( next ) )
+                continue;
+
+            uint64_t cost = entry.first + ((uint64_t) map.GetRate( next ) << 32) + 1;
+
+            if ( cost < costs[next] )
+            {
+                costs[next] = cost;
+                prevTiles[next] = tile;
+                queue.push( Entry( cost, next ) );
+            }
+        }
+    }
+}
+
+bool RouteSearch::IsReachable( int tile ) const
+{
+    return costs[tile] != Unreached;
+}
+
+uint32_t RouteSearch::GetRateSum( int tile ) const
+{
+    return (uint32_t) (costs[tile] >> 32);
+}
+
+uint32_t RouteSearch::GetSteps( int tile ) const
+{
+    return (uint32_t) costs[tile];
+}
+
+void RouteSearch::AddDomainRates( const RouteMap& map, int tile, uint32_t* domainRates ) const
+{
+    for ( ; prevTiles[tile] != NoTile; tile = prevTiles[tile] )
+    {
+        int domain = map.GetDomain( tile );
+
+        if ( domain != OverworldData::NoDomain )
+            domainRates[domain] += map.GetRate( tile );
+    }
+}
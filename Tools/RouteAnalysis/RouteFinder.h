@@ -0,0 +1,104 @@
+/*
+   Copyright 2012 Aldo J. Nunez
+
+   Licensed under the Apache License, Version 2.0.
+   See the LICENSE text file for details.
+*/
+
+#pragma once
+
+class OverworldData;
+
+
+struct RouteOptions
+{
+    bool Canoe;             // the party has the canoe
+    bool Chime;             // the party has the chime
+    bool Bridge;            // the bridge has been built
+    bool CanalBlocked;      // the canal hasn't been dug yet, so the isthmus can be walked
+};
+
+
+// What a step onto each tile of the overworld costs, for the same rules as
+// the routes in the game. Made once, and then shared by every search.
+
+class RouteMap
+{
+public:
+    static const int Cols = 256;
+    static const int Rows = 256;
+    static const int Tiles = Cols * Rows;
+
+    void Make( const OverworldData& data, const RouteOptions& options );
+
+    bool CanEnter( int tile ) const
+    {
+        return (flags[tile] & Flag_Enter) != 0;
+    }
+
+    // Stepping on a teleport leaves the overworld, so a route can end on one,
+    // but not go on from it.
+    bool IsTeleport( int tile ) const
+    {
+        return (flags[tile] & Flag_Teleport) != 0;
+    }
+
+    int GetRate( int tile ) const
+    {
+        return rates[tile];
+    }
+
+    int GetDomain( int tile ) const
+    {
+        return domains[tile];
+    }
+
+    static int GetNeighbor( int tile, int dir );
+
+private:
+    enum Flags
+    {
+        Flag_Enter      = 1,
+        Flag_Teleport   = 2,
+    };
+
+    uint8_t flags[Tiles];
+    uint8_t rates[Tiles];
+    uint8_t domains[Tiles];
+};
+
+
+// Finds the routes from a set of tiles to every other tile. The cheapest
+// route is the one with the fewest expected battles, and then the fewest
+// steps. A battle can only start on the tile that a step lands on, so each
+// step costs the battle rate of that tile.
+//
+// Each search has its own working memory, so that separate searches can
+// run on separate threads.
+
+class RouteSearch
+{
+public:
+    static const int NoTile = -1;
+
+    RouteSearch();
+
+    void Run( const RouteMap& map, const std::vector<int>& sources );
+
+    bool IsReachable( int tile ) const;
+
+    // The sum of the battle rates of the tiles that are stepped on. Divided
+    // by OverworldData::MaxRate, it's the number of expected battles.
+    uint32_t GetRateSum( int tile ) const;
+    uint32_t GetSteps( int tile ) const;
+
+    // Adds the rate sum of each domain along the route to a tile
+    void AddDomainRates( const RouteMap& map, int tile, uint32_t* domainRates ) const;
+
+private:
+    static const uint64_t Unreached = UINT64_MAX;
+
+    // The rate sum is in the top half, so that it's compared first
+    std::vector<uint64_t> costs;
+    std::vector<int> prevTiles;
+};